@@ -1,1398 +1,9647 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <time.h>
-#include <string.h>
-
-#define ORDER 6
-
-// Forward declarations
-typedef struct BTree BTree;
-
-// Transaction struct
-typedef struct Transaction 
-{
-    int transaction_id;
-    int buyer_id;
-    int seller_id;
-    float energy_kwh;
-    float price_per_kwh;
-    float total_price;
-    time_t timestamp;
-} Transaction;
-
-// Regular Buyer Node for Linked List
-typedef struct RegularBuyerNode 
-{
-    int buyer_id;
-    int transaction_count;
-    struct RegularBuyerNode* next;
-} RegularBuyerNode;
-
-// Seller struct
-typedef struct Seller 
-{
-    int seller_id;
-    float rate_below_300;
-    float rate_above_300;
-    RegularBuyerNode* regular_buyers; // Linked list of regular buyers
-    float total_revenue;              // Added revenue tracking
-    BTree* transaction_subtree;       // B+ tree of transactions
-} Seller;
-
-// Buyer struct
-typedef struct Buyer 
-{
-    int buyer_id;
-    float total_energy_purchased;     // Sum of all energy bought
-    BTree* transaction_subtree;       // B+ tree of transactions
-} Buyer;
-
-// Seller-Buyer Pair struct
-typedef struct SellerBuyerPair 
-{
-    int seller_id;
-    int buyer_id;
-    int number_of_transactions;
-} SellerBuyerPair;
-
-// B+ Tree Node
-typedef struct Node 
-{
-    int* keys;                    // Array of keys
-    int t;                        // Minimum degree
-    struct Node** children;       // Array of child pointers
-    int n;                        // Current number of keys
-    bool leaf;                    // True if leaf node
-    struct Node* next;            // For leaf node chaining
-    void** records;               // Array of records (void* for flexibility)
-} Node;
-
-// B+ Tree
-struct BTree 
-{
-    Node* root;
-    int t;                        // Minimum degree
-    char type;                    // 'T' for Transaction, 'S' for Seller, 'B' for Buyer, 'P' for SellerBuyerPair
-};
-
-// Create a new node
-Node* createNode(int t, bool leaf) 
-{
-    Node* newNode = (Node*)malloc(sizeof(Node));
-    if (!newNode) 
-    {
-        printf("Memory allocation failed for Node\n");
-        exit(1);
-    }
-    
-    newNode->t = t;
-    newNode->leaf = leaf;
-    
-    newNode->keys = (int*)malloc((2 * t - 1) * sizeof(int));
-    newNode->children = (Node**)malloc((2 * t) * sizeof(Node*));
-    newNode->n = 0;
-    newNode->next = NULL;
-    newNode->records = (void**)malloc((2 * t - 1) * sizeof(void*));
-    
-    return newNode;
-}
-
-// Create a new B+ Tree
-BTree* createBTree(int t, char type) 
-{
-    BTree* tree = (BTree*)malloc(sizeof(BTree));
-    if (!tree) 
-    {
-        printf("Memory allocation failed for BTree\n");
-        exit(1);
-    }
-    
-    tree->root = createNode(t, true);
-    tree->t = t;
-    tree->type = type;
-    
-    return tree;
-}
-
-// Split child node for B+ tree
-void splitChild(Node* parent, int i, Node* child) 
-{
-    int t = child->t;
-    Node* newChild = createNode(t, child->leaf);
-    newChild->n = t-1;
-    
-    // Copy the keys and records from child to newChild
-    for (int j = 0; j < t-1; j++) 
-    {
-        newChild->keys[j] = child->keys[j + t];
-        if (child->leaf) 
-        {
-            newChild->records[j] = child->records[j + t];
-        }
-    }
-    
-    // If not leaf, copy the children pointers
-    if (!child->leaf) 
-    {
-        for (int j = 0; j < t; j++) 
-        {
-            newChild->children[j] = child->children[j + t];
-        }
-    }
-    
-    // Update child's key count
-    child->n = t;
-    
-    // Shift parent's children to accommodate new child
-    for (int j = parent->n; j >= i + 1; j--) 
-    {
-        parent->children[j + 1] = parent->children[j];
-    }
-    
-    // Assign the new child to parent
-    parent->children[i + 1] = newChild;
-    
-    // Shift parent's keys to accommodate new key
-    for (int j = parent->n - 1; j >= i; j--) 
-    {
-        parent->keys[j + 1] = parent->keys[j];
-        parent->records[j + 1] = parent->records[j];
-    }
-    
-    // Place the middle key of child into parent
-    parent->keys[i] = child->keys[t - 1];
-    if (child->leaf) 
-    {
-        parent->records[i] = child->records[t - 1];
-    } 
-    else 
-    {
-        parent->records[i] = NULL; // Internal nodes don't store records in B+ tree
-    }
-    parent->n++;
-    
-    // If leaf nodes, update the leaf node chain
-    if (child->leaf) 
-    {
-        newChild->next = child->next;
-        child->next = newChild;
-    }
-}
-
-// Generic insert non-full function
-void insertNonFull(Node* node, int key, void* record) 
-{
-    int i = node->n - 1;
-    
-    if (node->leaf) 
-    {
-        // Find position to insert the new key
-        while (i >= 0 && key <node->keys[i]) 
-        {
-            node->keys[i + 1] = node->keys[i];
-            node->records[i + 1] = node->records[i];
-            i--;
-        }
-        
-        // Insert the new key and record
-        node->keys[i + 1] = key;
-        node->records[i + 1] = record;
-        node->n++;
-    }
-    else 
-    {
-        // Find the child which is going to have the new key
-        while (i >= 0 && key < node->keys[i]) i--;
-        i++;
-        
-        // See if the found child is full
-        if (node->children[i]->n == 2 * node->t - 1) 
-        {
-            // If the child is full, split it
-            splitChild(node, i, node->children[i]);
-            
-            // After split, decide which child gets the new key
-            if (key > node->keys[i]) i++;
-        }
-        
-        // Recursively insert into the appropriate child
-        insertNonFull(node->children[i], key, record);
-    }
-}
-
-// Generic insert function
-void insert(BTree* tree, int key, void* record) 
-{
-    Node* r = tree->root;
-    
-    // If root is full, create a new root
-    if (r->n == 2 * tree->t - 1) 
-    {
-        Node* s = createNode(tree->t, false);
-        s->children[0] = r;
-        tree->root = s;
-        splitChild(s, 0, r);
-        insertNonFull(s, key, record);
-    } else {
-        insertNonFull(r, key, record);
-    }
-}
-
-// Search for a record in a B+ Tree by key
-void* search(Node* node, int key) 
-{
-    int i = 0;
-    
-    // Find the first key greater than or equal to key
-    while (i < node->n && key > node->keys[i]) i++;
-    
-    // If found key equals search key, return its record
-    if (i < node->n && node->keys[i] == key) 
-    {
-        return node->records[i];
-    } 
-    // If leaf node and key not found, return NULL
-    else if (node->leaf) 
-    {
-        return NULL;
-    } 
-    // Otherwise, search the appropriate child
-    else 
-    {
-        return search(node->children[i], key);
-    }
-}
-
-// Create a new transaction
-Transaction* createTransaction(int id, int buyer_id, int seller_id, float energy_kwh, float price_per_kwh,time_t timestamp) 
-{
-    Transaction* tx = (Transaction*)malloc(sizeof(Transaction));
-    if (!tx) 
-    {
-        printf("Memory allocation failed for Transaction\n");
-        exit(1);
-    }
-    
-    tx->transaction_id = id;
-    tx->buyer_id = buyer_id;
-    tx->seller_id = seller_id;
-    tx->energy_kwh = energy_kwh;
-    tx->price_per_kwh = price_per_kwh;
-    tx->total_price = tx->energy_kwh * tx->price_per_kwh;
-    tx->timestamp = timestamp;
-    
-    return tx;
-}
-
-// Create a new seller
-Seller* createSeller(int seller_id, float rate_below_300, float rate_above_300) 
-{
-    Seller* seller = (Seller*)malloc(sizeof(Seller));
-    if (!seller) 
-    {
-        printf("Memory allocation failed for Seller\n");
-        exit(1);
-    }
-    
-    seller->seller_id = seller_id;
-    seller->rate_below_300 = rate_below_300;
-    seller->rate_above_300 = rate_above_300;
-    seller->regular_buyers = NULL;
-    seller->total_revenue = 0.0;
-    seller->transaction_subtree = createBTree(2, 'T');
-    
-    return seller;
-}
-
-// Create a new buyer
-Buyer* createBuyer(int buyer_id) 
-{
-    Buyer* buyer = (Buyer*)malloc(sizeof(Buyer));
-    if (!buyer) 
-    {
-        printf("Memory allocation failed for Buyer\n");
-        exit(1);
-    }
-    
-    buyer->buyer_id = buyer_id;
-    buyer->total_energy_purchased = 0.0;
-    buyer->transaction_subtree = createBTree(2, 'T');
-    
-    return buyer;
-}
-
-// Create a new regular buyer node for linked list
-RegularBuyerNode* createRegularBuyerNode(int buyer_id) 
-{
-    RegularBuyerNode* node = (RegularBuyerNode*)malloc(sizeof(RegularBuyerNode));
-    if (!node) 
-    {
-        printf("Memory allocation failed for RegularBuyerNode\n");
-        exit(1);
-    }
-    
-    node->buyer_id = buyer_id;
-    node->transaction_count = 1;  // Start with 1 transaction
-    node->next = NULL;
-    
-    return node;
-}
-
-// Create a new seller-buyer pair
-SellerBuyerPair* createSellerBuyerPair(int seller_id, int buyer_id) 
-{
-    SellerBuyerPair* pair = (SellerBuyerPair*)malloc(sizeof(SellerBuyerPair));
-    if (!pair) 
-    {
-        printf("Memory allocation failed for SellerBuyerPair\n");
-        return pair;
-    }
-    
-    pair->seller_id = seller_id;
-    pair->buyer_id = buyer_id;
-    pair->number_of_transactions = 1; // Start with 1 transaction
-    
-    return pair;
-}
-
-// Insert a transaction
-void insertTransaction(BTree* tree, Transaction* tx) 
-{
-    insert(tree, tx->transaction_id, tx);
-}
-
-// Insert a seller
-void insertSeller(BTree* tree, Seller* seller) 
-{
-    insert(tree, seller->seller_id, seller);
-}
-
-// Insert a buyer
-void insertBuyer(BTree* tree, Buyer* buyer) 
-{
-    insert(tree, buyer->buyer_id, buyer);
-}
-
-// Create a key for SellerBuyerPair (combine seller_id and buyer_id)
-int createPairKey(int seller_id, int buyer_id)
-{
-    // Simple hash: shift seller_id left by 16 bits and OR with buyer_id
-    return (seller_id << 16) | (buyer_id & 0xFFFF);
-}
-
-// Insert a seller-buyer pair
-void insertSellerBuyerPair(BTree* tree, SellerBuyerPair* pair) 
-{
-    int key = createPairKey(pair->seller_id, pair->buyer_id);
-    insert(tree, key, pair);
-}
-
-// Search for a transaction
-Transaction* searchTransaction(BTree* tree, int transaction_id) 
-{
-    return (Transaction*)search(tree->root, transaction_id);
-}
-
-// Search for a seller
-Seller* searchSeller(BTree* tree, int seller_id) 
-{
-    return (Seller*)search(tree->root, seller_id);
-}
-
-// Search for a buyer
-Buyer* searchBuyer(BTree* tree, int buyer_id) 
-{
-    return (Buyer*)search(tree->root, buyer_id);
-}
-
-// Search for a seller-buyer pair
-SellerBuyerPair* searchSellerBuyerPair(BTree* tree, int seller_id, int buyer_id) 
-{
-    int key = createPairKey(seller_id, buyer_id);
-    return (SellerBuyerPair*)search(tree->root, key);
-}
-
-// Add or update a regular buyer in seller's list
-void addRegularBuyer(Seller* seller, int buyer_id) 
-{
-    // Check if buyer already exists in the list
-    RegularBuyerNode* current = seller->regular_buyers;
-    RegularBuyerNode* prev = NULL;
-    
-    while (current != NULL) 
-    {
-        if (current->buyer_id == buyer_id) 
-        {
-            // Buyer exists, increment transaction count
-            current->transaction_count++;
-            return;
-        }
-        prev = current;
-        current = current->next;
-    }
-    
-    // Buyer not found, create a new node
-    RegularBuyerNode* newNode = createRegularBuyerNode(buyer_id);
-    
-    // Add to the beginning of the list if it's empty or at the end if not
-    if (seller->regular_buyers == NULL) 
-    {
-        seller->regular_buyers = newNode;
-    } 
-    else 
-    {
-        prev->next = newNode;
-    }
-}
-
-// Clean up regular buyers list to only include those with more than 5 transactions
-void cleanupRegularBuyers(Seller* seller) 
-{
-    RegularBuyerNode* current = seller->regular_buyers;
-    RegularBuyerNode* prev = NULL;
-    RegularBuyerNode* next;
-    
-    while (current != NULL) 
-    {
-        next = current->next;
-        
-        if (current->transaction_count < 5) 
-        {
-            // Remove this node
-            if (prev == NULL) 
-            {
-                // This is the head node
-                seller->regular_buyers = next;
-            } 
-            else 
-            {
-                prev->next = next;
-            }
-            free(current);
-        } 
-        else 
-        {
-            prev = current;
-        }
-        
-        current = next;
-    }
-}
-
-// Process a transaction - update related data structures
-void processTransaction(Transaction* tx, BTree* sellerTree, BTree* buyerTree, BTree* pairTree) 
-{
-    // Find or create seller
-    Seller* seller = searchSeller(sellerTree, tx->seller_id);
-    if (!seller) 
-    {
-        seller = createSeller(tx->seller_id,0,0); // Default rates
-        insertSeller(sellerTree, seller);
-    }
-
-    //Update seller's rates
-    if(tx->energy_kwh<300 && seller->rate_below_300==0) seller->rate_below_300=tx->price_per_kwh;
-    else if(tx->energy_kwh>=300 && seller->rate_above_300==0) seller->rate_above_300=tx->price_per_kwh;
-    
-    // Update seller's revenue
-    seller->total_revenue += tx->total_price;
-    
-    // Add transaction to seller's transaction subtree
-    insertTransaction(seller->transaction_subtree, tx);
-    
-    // Find or create buyer
-    Buyer* buyer = searchBuyer(buyerTree, tx->buyer_id);
-    if (!buyer) 
-    {
-        buyer = createBuyer(tx->buyer_id);
-        insertBuyer(buyerTree, buyer);
-    }
-    
-    // Update buyer's total energy purchased
-    buyer->total_energy_purchased += tx->energy_kwh;
-    
-    // Add transaction to buyer's transaction subtree
-    insertTransaction(buyer->transaction_subtree, tx);
-    
-    // Update regular buyers list
-    addRegularBuyer(seller, tx->buyer_id);
-    
-    // Clean up regular buyers list (only keep those with 5+ transactions)
-    cleanupRegularBuyers(seller);
-    
-    // Update or create seller-buyer pair
-    SellerBuyerPair* pair = searchSellerBuyerPair(pairTree, tx->seller_id, tx->buyer_id);
-    
-    if (pair) 
-    {
-        // Pair exists, increment transaction count
-        pair->number_of_transactions++;
-    } 
-    else 
-    {
-        // Create new pair
-        pair = createSellerBuyerPair(tx->seller_id, tx->buyer_id);
-        insertSellerBuyerPair(pairTree, pair);
-    }
-}
-
-// Function to traverse and display all transactions in the B+ tree
-void displayAllTransactions(BTree* tree) 
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Transaction tree is empty.\n");
-        return;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Traverse all leaf nodes using the 'next' pointers
-    printf("\n===== TRANSACTION LIST =====\n");
-    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
-           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
-    printf("--------------------------------------------------------------------------------------\n");
-    
-    int count = 0;
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            Transaction* tx = (Transaction*)current->records[i];
-            char time_str[30];
-            strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&tx->timestamp));
-            
-            printf("%-6d | %-8d | %-8d | %-15.2f | %-15.2f | %-15.2f | %-20s\n", 
-                   tx->transaction_id, tx->buyer_id, tx->seller_id, 
-                   tx->energy_kwh, tx->price_per_kwh, tx->total_price, time_str);
-            count++;
-        }
-        current = current->next;
-    }
-    
-    printf("--------------------------------------------------------------------------------------\n");
-    printf("Total transactions: %d\n\n", count);
-}
-
-// Process and display a seller record
-void displaySellerRecord(void* record) 
-{
-    Seller* seller = (Seller*)record;
-    printf("%-8d | %-15.4f | %-15.4f | %-12.2f | ", 
-           seller->seller_id, 
-           seller->rate_below_300, 
-           seller->rate_above_300,
-           seller->total_revenue);
-    
-    // Display regular buyers
-    printf("Regular buyers: ");
-    int buyerCount = 0;
-    RegularBuyerNode* current = seller->regular_buyers;
-    while (current != NULL) {
-        if (buyerCount > 0) printf(", ");
-        printf("%d(%d tx)", current->buyer_id, current->transaction_count);
-        buyerCount++;
-        current = current->next;
-    }
-    if (buyerCount == 0) printf("None");
-    printf("\n");
-}
-
-// Display all sellers
-void displayAllSellers(BTree* tree) 
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Seller tree is empty.\n");
-        return;
-    }
-    
-    printf("\n===== SELLER LIST =====\n");
-    printf("%-8s | %-15s | %-15s | %-12s | %-s\n", 
-           "SELLER ID", "RATE <300kWh", "RATE >300kWh", "REVENUE", "REGULAR BUYERS");
-    printf("--------------------------------------------------------------------------------------\n");
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Traverse all leaf nodes using the 'next' pointers
-    int count = 0;
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            displaySellerRecord(current->records[i]);
-            count++;
-        }
-        current = current->next;
-    }
-    
-    printf("--------------------------------------------------------------------------------------\n");
-    printf("Total sellers: %d\n\n", count);
-}
-
-// Process and display a buyer record
-void displayBuyerRecord(void* record) 
-{
-    Buyer* buyer = (Buyer*)record;
-    printf("%-8d | %-20.2f\n", 
-           buyer->buyer_id, 
-           buyer->total_energy_purchased);
-}
-
-// Display all buyers
-void displayAllBuyers(BTree* tree) 
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Buyer tree is empty.\n");
-        return;
-    }
-    
-    printf("\n===== BUYER LIST =====\n");
-    printf("%-8s | %-20s\n", "BUYER ID", "TOTAL ENERGY (kWh)");
-    printf("---------------------------------\n");
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Traverse all leaf nodes using the 'next' pointers
-    int count = 0;
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            displayBuyerRecord(current->records[i]);
-            count++;
-        }
-        current = current->next;
-    }
-    
-    printf("---------------------------------\n");
-    printf("Total buyers: %d\n\n", count);
-}
-
-/**
- * Display transactions within a specific time range
- */
-void displayTransactionsInTimeRange(BTree* tree, time_t start_time, time_t end_time) 
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Transaction tree is empty.\n");
-        return;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Format time strings for display
-    char start_str[30], end_str[30];
-    strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", localtime(&start_time));
-    strftime(end_str, sizeof(end_str), "%Y-%m-%d %H:%M:%S", localtime(&end_time));
-    
-    // Traverse all leaf nodes using the 'next' pointers
-    printf("\n===== TRANSACTIONS FROM %s TO %s =====\n", start_str, end_str);
-    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
-           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
-    printf("--------------------------------------------------------------------------------------\n");
-    
-    int count = 0;
-    float total_energy = 0.0;
-    float total_revenue = 0.0;
-    
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            Transaction* tx = current->records[i];
-            
-            // Check if transaction is within the specified time range
-            if (tx->timestamp >= start_time && tx->timestamp <= end_time) 
-            {
-                char time_str[30];
-                strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&tx->timestamp));
-                
-                printf("%-6d | %-8d | %-8d | %-15.2f | %-15.2f | %-15.2f | %-20s\n", 
-                       tx->transaction_id, tx->buyer_id, tx->seller_id, 
-                       tx->energy_kwh, tx->price_per_kwh, tx->total_price, time_str);
-                
-                count++;
-                total_energy += tx->energy_kwh;
-                total_revenue += tx->total_price;
-            }
-        }
-        current = current->next;
-    }
-    
-    printf("--------------------------------------------------------------------------------------\n");
-    printf("Total transactions: %d | Total energy: %.2f kWh | Total revenue: $%.2f\n\n", 
-           count, total_energy, total_revenue);
-}
-
-//Calculate total revenue for a specific seller
- float calculateSellerRevenue(BTree* tree, int seller_id) 
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Transaction tree is empty.\n");
-        return 0.0;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Traverse all leaf nodes and sum up revenue for the specified seller
-    float total_revenue = 0.0;
-    int transaction_count = 0;
-    float total_energy_sold = 0.0;
-    
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            Transaction* tx = current->records[i];
-            
-            // Check if this transaction involves the seller we're looking for
-            if (tx->seller_id == seller_id) 
-            {
-                total_revenue += tx->total_price;
-                total_energy_sold += tx->energy_kwh;
-                transaction_count++;
-            }
-        }
-        current = current->next;
-    }
-    
-    printf("\n===== REVENUE SUMMARY FOR SELLER ID: %d =====\n", seller_id);
-    printf("Total transactions: %d\n", transaction_count);
-    printf("Total energy sold: %.2f kWh\n", total_energy_sold);
-    printf("Total revenue: $%.2f\n\n", total_revenue);
-    
-    return total_revenue;
-}
-
-
- // Find and display transactions in ascending order by energy amount within a range
-void displayTransactionsByEnergyRange(BTree* tree, float min_energy, float max_energy)
-{
-    if (!tree || !tree->root) 
-    {
-        printf("Transaction tree is empty.\n");
-        return;
-    }
-    
-    // Step 1: Traverse tree and collect transactions in the energy range
-    Transaction** transactions = NULL;
-    int count = 0;
-    int capacity = 10;  // Initial capacity
-    
-    // Allocate initial array
-    transactions = (Transaction**)malloc(capacity * sizeof(Transaction*));
-    if (!transactions) {
-        printf("Memory allocation failed.\n");
-        return;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Collect transactions in range
-    while (current != NULL) {
-        for (int i = 0; i < current->n; i++) 
-        {
-            Transaction* tx = (Transaction*)current->records[i];
-            
-            if (tx->energy_kwh >= min_energy && tx->energy_kwh <= max_energy) 
-            {
-                // Resize array if needed
-                if (count >= capacity) 
-                {
-                    capacity *= 2;
-                    transactions = (Transaction**)realloc(transactions, capacity * sizeof(Transaction*));
-                    if (!transactions) 
-                    {
-                        printf("Memory reallocation failed.\n");
-                        return;
-                    }
-                }
-                
-                transactions[count++] = tx;
-            }
-        }
-        current = current->next;
-    }
-    
-    // Step 2: Sort transactions by energy (Insertion Sort)
-    for (int i = 1; i < count; i++) 
-    {
-        Transaction* key = transactions[i];
-        int j = i - 1;
-        
-        while (j >= 0 && transactions[j]->energy_kwh > key->energy_kwh) 
-        {
-            transactions[j + 1] = transactions[j];
-            j--;
-        }
-        
-        transactions[j + 1] = key;
-    }
-    
-    // Step 3: Display sorted transactions
-    printf("\n===== TRANSACTIONS BY ENERGY RANGE (%.2f - %.2f kWh) =====\n", min_energy, max_energy);
-    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
-           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
-    printf("--------------------------------------------------------------------------------------\n");
-    
-    for (int i = 0; i < count; i++) 
-    {
-        Transaction* tx = transactions[i];
-        char time_str[30];
-        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&tx->timestamp));
-        
-        printf("%-6d | %-8d | %-8d | %-15.2f | %-15.2f | %-15.2f | %-20s\n", 
-               tx->transaction_id, tx->buyer_id, tx->seller_id, 
-               tx->energy_kwh, tx->price_per_kwh, tx->total_price, time_str);
-    }
-    
-    printf("--------------------------------------------------------------------------------------\n");
-    printf("Total transactions in range: %d\n\n", count);
-    
-    // Free the auxiliary array
-    free(transactions);
-}
-
-
- //Display buyers in ascending order based on energy bought
-void displayBuyersByEnergyBought(BTree* buyerTree) 
-{
-    if (!buyerTree || !buyerTree->root) 
-    {
-        printf("Buyer tree is empty.\n");
-        return;
-    }
-    
-    // Step 1: Traverse tree and collect buyers
-    Buyer** buyers = NULL;
-    int count = 0;
-    int capacity = 10;  // Initial capacity
-    
-    // Allocate initial array
-    buyers = (Buyer**)malloc(capacity * sizeof(Buyer*));
-    if (!buyers) 
-    {
-        printf("Memory allocation failed.\n");
-        return;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = buyerTree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Collect buyers
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) {
-            Buyer* buyer = (Buyer*)current->records[i];
-            
-            // Resize array if needed
-            if (count >= capacity) 
-            {
-                capacity *= 2;
-                buyers = (Buyer**)realloc(buyers, capacity * sizeof(Buyer*));
-                if (!buyers) 
-                {
-                    printf("Memory reallocation failed.\n");
-                    return;
-                }
-            }
-            
-            buyers[count++] = buyer;
-        }
-        current = current->next;
-    }
-    
-    // Step 2: Sort buyers by energy purchased (Insertion Sort)
-    for (int i = 1; i < count; i++) 
-    {
-        Buyer* key = buyers[i];
-        int j = i - 1;
-        
-        while (j >= 0 && buyers[j]->total_energy_purchased > key->total_energy_purchased) 
-        {
-            buyers[j + 1] = buyers[j];
-            j--;
-        }
-        
-        buyers[j + 1] = key;
-    }
-    
-    // Step 3: Display sorted buyers
-    printf("\n===== BUYERS BY ENERGY PURCHASED (ASCENDING) =====\n");
-    printf("%-8s | %-20s\n", "BUYER ID", "TOTAL ENERGY (kWh)");
-    printf("---------------------------------\n");
-    
-    for (int i = 0; i < count; i++) 
-    {
-        printf("%-8d | %-20.2f\n", 
-               buyers[i]->buyer_id, 
-               buyers[i]->total_energy_purchased);
-    }
-    
-    printf("---------------------------------\n");
-    printf("Total buyers: %d\n\n", count);
-    
-    // Free the auxiliary array
-    free(buyers);
-}
-
-
-// Display seller-buyer pairs in ascending order based on number of transactions
-void displayPairsByTransactionCount(BTree* pairTree) 
-{
-    if (!pairTree || !pairTree->root) 
-    {
-        printf("Seller-Buyer pair tree is empty.\n");
-        return;
-    }
-    
-    // Step 1: Traverse tree and collect pairs
-    SellerBuyerPair** pairs = NULL;
-    int count = 0;
-    int capacity = 10;  // Initial capacity
-    
-    // Allocate initial array
-    pairs = (SellerBuyerPair**)malloc(capacity * sizeof(SellerBuyerPair*));
-    if (!pairs) 
-    {
-        printf("Memory allocation failed.\n");
-        return;
-    }
-    
-    // Find the leftmost leaf node
-    Node* current = pairTree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Collect pairs
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) {
-            SellerBuyerPair* pair = (SellerBuyerPair*)current->records[i];
-            
-            // Resize array if needed
-            if (count >= capacity) 
-            {
-                capacity *= 2;
-                pairs = (SellerBuyerPair**)realloc(pairs, capacity * sizeof(SellerBuyerPair*));
-                if (!pairs) 
-                {
-                    printf("Memory reallocation failed.\n");
-                    return;
-                }
-            }
-            
-            pairs[count++] = pair;
-        }
-        current = current->next;
-    }
-    
-    // Step 2: Sort pairs by transaction count (Insertion Sort)
-    for (int i = 1; i < count; i++) 
-    {
-        SellerBuyerPair* key = pairs[i];
-        int j = i - 1;
-        
-        while (j >= 0 && pairs[j]->number_of_transactions > key->number_of_transactions) 
-        {
-            pairs[j + 1] = pairs[j];
-            j--;
-        }
-        
-        pairs[j + 1] = key;
-    }
-    
-    // Step 3: Display sorted pairs
-    printf("\n===== SELLER-BUYER PAIRS BY TRANSACTION COUNT (ASCENDING) =====\n");
-    printf("%-8s | %-8s | %-20s\n", "SELLER ID", "BUYER ID", "TRANSACTION COUNT");
-    printf("------------------------------------------\n");
-    
-    for (int i = 0; i < count; i++) 
-    {
-        printf("%-8d | %-8d | %-20d\n", 
-               pairs[i]->seller_id, 
-               pairs[i]->buyer_id, 
-               pairs[i]->number_of_transactions);
-    }
-    
-    printf("------------------------------------------\n");
-    printf("Total pairs: %d\n\n", count);
-    
-    // Free the auxiliary array
-    free(pairs);
-}
-
-int my_strptime(const char *date_str, const char *format, struct tm *tm) 
-{
-    // This function handles the "%Y-%m-%d" format.
-    int year, month, day;
-    if (strcmp(format, "%Y-%m-%d") == 0) 
-    {
-        if (sscanf(date_str, "%4d-%2d-%2d", &year, &month, &day) == 3) 
-        {
-            tm->tm_year = year - 1900;  // years since 1900
-            tm->tm_mon = month - 1;     // months since January [0-11]
-            tm->tm_mday = day;
-            tm->tm_hour = 0;
-            tm->tm_min = 0;
-            tm->tm_sec = 0;
-            tm->tm_isdst = -1;
-            return 1;
-        }
-    }
-    return 0;
-}
-
-//Function to import data from transactions.txt
-void importTransactions(BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, BTree* pairTree) 
-{
-    FILE* file = fopen("transactions.txt", "r");
-    if (!file) 
-    {
-        printf("Error opening file transactions.txt for reading\n");
-        return;
-    }
-    
-    int count = 0;
-    char line[256];
-    
-    // Skip header line if present
-    if (fgets(line, sizeof(line), file) != NULL) 
-    {
-        // Check if this is a header line (contains non-numeric characters)
-        if (line[0] < '0' || line[0] > '9') 
-        {
-            // It's a header, continue to next line
-        } 
-        else 
-        {
-            // It's data, rewind to start of file
-            rewind(file);
-        }
-    }
-    
-    // Read and process each line
-    while (fgets(line, sizeof(line), file) != NULL) 
-    {
-        int transaction_id, buyer_id, seller_id;
-        float energy_kwh, price_per_kwh;
-        time_t timestamp;
-        
-        // Parse the line
-        if (sscanf(line, "%d,%d,%d,%f,%f,%ld", &transaction_id, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp) == 6)
-        {
-            
-            // Create and process the transaction
-            Transaction* tx = createTransaction(transaction_id, buyer_id, seller_id, energy_kwh, price_per_kwh, timestamp);
-            
-            // Add to transaction tree
-            insertTransaction(transactionTree, tx);
-            
-            // Update related data structures
-            processTransaction(tx, sellerTree, buyerTree, pairTree);
-            
-            count++;
-        } 
-        else 
-        {
-            printf("Warning: Skipping invalid line: %s", line);
-        }
-    }
-    
-    fclose(file);
-    printf("Successfully imported %d transactions from transactions.txt\n", count );
-}
-
-
-void exportTransactions( BTree* tree) 
-{
-    FILE* file = fopen("transactions.txt", "w");
-    if (!file) 
-    {
-        printf("Error opening file transactions.txt for writing\n");
-        return;
-    }
-    
-    // Write header
-    fprintf(file, "transaction_id,buyer_id,seller_id,energy,price,timestamp\n");
-    
-    if (!tree || !tree->root) 
-    {
-        printf("Transaction tree is empty, writing empty file.\n");
-        fclose(file);
-        return;
-    }
-    
-    int count = 0;
-    
-    // Find the leftmost leaf node
-    Node* current = tree->root;
-    while (!current->leaf) 
-    {
-        current = current->children[0];
-    }
-    
-    // Traverse all leaf nodes using the 'next' pointers
-    while (current != NULL) 
-    {
-        for (int i = 0; i < current->n; i++) 
-        {
-            Transaction* tx = (Transaction*)current->records[i];
-            
-            // Write transaction data to file
-            fprintf(file, "%d,%d,%d,%.2f,%.2f,%ld\n", 
-                   tx->transaction_id, tx->buyer_id, tx->seller_id, 
-                   tx->energy_kwh, tx->price_per_kwh, tx->timestamp);
-            
-            count++;
-        }
-        current = current->next;
-    }
-    
-    fclose(file);
-    printf("Successfully exported %d transactions to transactions.txt\n", count);
-}
-
-
-// Main function to demonstrate usage
-int main() 
-{
-    // Create B+ trees for different entity types
-    BTree* transactionTree = createBTree(ORDER/2, 'T');
-    BTree* sellerTree = createBTree(ORDER/2, 'S');
-    BTree* buyerTree = createBTree(ORDER/2, 'B');
-    BTree* pairTree = createBTree(ORDER/2, 'P');
-    
-    importTransactions(transactionTree,sellerTree,buyerTree,pairTree);
-    
-    int choice = 0,flag=1;
-    
-    
-    while (flag)
-    {
-        // Display menu
-        printf("\n===== ENERGY TRADING SYSTEM =====\n");
-        printf("Operations Menu:\n");
-        printf("1. Add New Transactions\n");
-        printf("2. Display All Transactions\n");
-        printf("3. Create a set of Transactions for Every Seller\n");
-        printf("4. Create a set of Transactions for Every Buyer\n");
-        printf("5. Find all transactions in a Given Time Period\n");
-        printf("6. Calculate Total Revenue by Seller\n");
-        printf("7. Find and Display transactions with Energy Amounts in range\n");
-        printf("8. Sort the set of Buyers Based on Energy Bought\n");
-        printf("9. Sort Seller/Buyer Pairs by Number of Transactions\n");
-        printf("0. Exit\n");
-        printf("Enter your choice: ");
-        
-        if (scanf("%d", &choice) != 1) 
-        {
-            // Clear input buffer on failed read
-            while (getchar() != '\n');
-            printf("Invalid input. Please enter a number.\n");
-            continue;
-        }
-        
-        // Process choice
-        switch (choice) 
-        {
-            case 0:
-                printf("Exiting system. Goodbye!\n");
-                flag=0;
-                break;
-                
-            case 1: 
-            { // Add New Transactions
-                int txn_id,buyer_id, seller_id;
-                float energy_kwh, price_per_kwh;
-                
-                printf("\n----- Add New Transaction -----\n");
-                printf("Enter Transaction ID: ");
-                scanf("%d", &txn_id);
-                printf("Enter Buyer ID: ");
-                scanf("%d", &buyer_id);
-                printf("Enter Seller ID: ");
-                scanf("%d", &seller_id);
-                printf("Enter Energy (kWh): ");
-                scanf("%f", &energy_kwh);
-                Seller* seller = searchSeller(sellerTree, seller_id);
-                if (seller!=NULL) 
-                {
-                    if(energy_kwh<300 && seller->rate_below_300!=0) 
-                    {
-                        price_per_kwh=seller->rate_below_300;
-                        printf("Price=%f (Auto Renew)\n", price_per_kwh);
-                    }
-                    else if(energy_kwh>=300 && seller->rate_above_300!=0)
-                    {
-                        price_per_kwh=seller->rate_above_300;
-                        printf("Price=%f (Auto Renew)\n", price_per_kwh);
-                    }
-                    else 
-                    {
-                        printf("Enter Price per kWh: ");
-                        scanf("%f", &price_per_kwh);
-                    }
-                    
-                } 
-                else 
-                {
-                    printf("Enter Price per kWh: ");
-                    scanf("%f", &price_per_kwh);
-                }
-                
-                Transaction* tx = createTransaction(txn_id, buyer_id, seller_id, energy_kwh, price_per_kwh,time(NULL));
-                processTransaction(tx, sellerTree, buyerTree, pairTree);
-                insertTransaction(transactionTree, tx);
-                
-                printf("Transaction added successfully with ID: %d\n", tx->transaction_id);
-                break;
-            }
-                
-            case 2: // Display All Transactions
-                displayAllTransactions(transactionTree);
-                break;
-                
-            case 3: 
-            { 
-                displayAllSellers(sellerTree);
-                break;
-            }
-                
-            case 4: 
-            { 
-                displayAllBuyers(buyerTree);
-                break;
-            }
-                
-            case 5: 
-            { // Display transactions in a given time period
-                printf("\n----- Transactions in Time Period -----\n");
-            
-                char start_date[11], end_date[11];
-                struct tm start_tm = {0}, end_tm = {0};
-            
-                printf("Enter start date (YYYY-MM-DD): ");
-                scanf("%10s", start_date);
-            
-                printf("Enter end date (YYYY-MM-DD): ");
-                scanf("%10s", end_date);
-            
-                if (!my_strptime(start_date, "%Y-%m-%d", &start_tm)) 
-                {
-                    printf("Invalid start date format.\n");
-                    break;
-                }
-            
-                if (!my_strptime(end_date, "%Y-%m-%d", &end_tm)) 
-                {
-                    printf("Invalid end date format.\n");
-                    break;
-                }
-            
-                // Set time to cover the full range for the dates
-                start_tm.tm_hour = 0; start_tm.tm_min = 0; start_tm.tm_sec = 0;
-                end_tm.tm_hour = 23;  end_tm.tm_min = 59;  end_tm.tm_sec = 59;
-            
-                time_t start_time = mktime(&start_tm);
-                time_t end_time = mktime(&end_tm);
-            
-                if (start_time == -1 || end_time == -1) 
-                {
-                    printf("Error converting date to time.\n");
-                    break;
-                }
-            
-                displayTransactionsInTimeRange(transactionTree, start_time, end_time);
-                break;
-            }
-            
-                
-            case 6: 
-            { // Calculate Total Revenue by Seller
-                printf("\n----- Revenue by Seller -----\n");
-                printf("Enter Seller ID (0 to see all sellers first): ");
-                int seller_id;
-                scanf("%d", &seller_id);
-                
-                if (seller_id == 0) 
-                {
-                    displayAllSellers(sellerTree);
-                    printf("Enter Seller ID: ");
-                    scanf("%d", &seller_id);
-                }
-                
-                calculateSellerRevenue(transactionTree, seller_id);
-                break;
-            }
-                
-            case 7: 
-            { // Find and Display transactions with Energy Amounts in range
-                printf("\n----- Transactions by Energy Range -----\n");
-                printf("Enter minimum energy amount (kWh): ");
-                float min_energy, max_energy;
-                scanf("%f", &min_energy);
-                printf("Enter maximum energy amount (kWh): ");
-                scanf("%f", &max_energy);
-                
-                displayTransactionsByEnergyRange(transactionTree, min_energy, max_energy);
-                break;
-            }
-                
-            case 8: // Sort Buyers Based on Energy Bought
-                displayBuyersByEnergyBought(buyerTree);
-                break;
-                
-            case 9: // Sort Seller/Buyer Pairs by Number of Transactions
-                displayPairsByTransactionCount(pairTree);
-                break;
-                
-            default:
-                printf("Invalid choice. Please try again.\n");
-        }
-    }
-    exportTransactions(transactionTree);
-    return 0;
-}
-
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifndef ORDER
+#define ORDER 6
+#endif
+
+// In-node key search strategy thresholds (number of keys in the node)
+#define LINEAR_SEARCH_MAX 8       // Without SIMD, up to this many keys a plain scan is fastest
+#define SIMD_SEARCH_MAX 128       // With SSE2, up to this many keys a full SIMD compare is fastest
+
+// Forward declarations
+typedef struct BTree BTree;
+
+// Fixed-point units. Amounts are stored as integers so that sums are exact.
+#define ENERGY_SCALE 1000         // Energy in Wh (milli-kWh)
+#define PRICE_SCALE 1000000       // Money in micro-units of currency
+#define TIMESTAMP_BASE 946684800  // 2000-01-01 00:00:00 UTC, origin of the 32-bit time offsets
+#define HIGH_VOLUME_WH (300 * ENERGY_SCALE) // Tier boundary for seller rates
+
+// Transaction struct (24 bytes)
+typedef struct Transaction 
+{
+    int transaction_id;
+    int buyer_id;
+    int seller_id;
+    int32_t energy_wh;            // Energy in Wh
+    int32_t price_micro;          // Price per kWh in micro-units
+    uint32_t time_offset;         // Seconds since TIMESTAMP_BASE
+} Transaction;
+
+// Total price of a transaction in micro-units, rounded to the nearest micro-unit
+static inline int64_t txTotalMicro(const Transaction* tx)
+{
+    return ((int64_t)tx->energy_wh * tx->price_micro + ENERGY_SCALE / 2) / ENERGY_SCALE;
+}
+
+// Timestamp of a transaction
+static inline time_t txTimestamp(const Transaction* tx)
+{
+    return (time_t)TIMESTAMP_BASE + tx->time_offset;
+}
+
+// Conversions between fixed-point and decimal values
+static inline int32_t toEnergyWh(double kwh) { return (int32_t)(kwh * ENERGY_SCALE + (kwh < 0 ? -0.5 : 0.5)); }
+static inline int32_t toPriceMicro(double price) { return (int32_t)(price * PRICE_SCALE + (price < 0 ? -0.5 : 0.5)); }
+static inline double whToKwh(int64_t wh) { return wh / (double)ENERGY_SCALE; }
+static inline double microToUnits(int64_t micro) { return micro / (double)PRICE_SCALE; }
+
+// True if a timestamp fits in a 32-bit offset from TIMESTAMP_BASE
+static inline bool isValidTimestamp(time_t timestamp)
+{
+    return timestamp >= (time_t)TIMESTAMP_BASE && (int64_t)timestamp - TIMESTAMP_BASE <= (int64_t)UINT32_MAX;
+}
+
+// 32-bit offset for a timestamp, clamped to the representable range
+static inline uint32_t toTimeOffset(time_t timestamp)
+{
+    if (timestamp < (time_t)TIMESTAMP_BASE) return 0;
+    if ((int64_t)timestamp - TIMESTAMP_BASE > (int64_t)UINT32_MAX) return UINT32_MAX;
+    return (uint32_t)(timestamp - TIMESTAMP_BASE);
+}
+
+#define TXSET_INLINE_CAPACITY 4   // Transactions kept inline before a set is promoted to a B+ tree
+
+// Per-seller/per-buyer set of transactions. Most participants have only a few
+// transactions, so these are kept in a small inline array sorted by ID and only
+// promoted to a B+ tree once the set outgrows TXSET_INLINE_CAPACITY.
+typedef struct TransactionSet 
+{
+    int count;
+    bool promoted;                // True once the set lives in tree
+    union 
+    {
+        Transaction* items[TXSET_INLINE_CAPACITY];
+        BTree* tree;
+    };
+} TransactionSet;
+
+// Regular Buyer Node for Linked List
+typedef struct RegularBuyerNode 
+{
+    int buyer_id;
+    int transaction_count;
+    struct RegularBuyerNode* next;
+} RegularBuyerNode;
+
+// Seller struct
+typedef struct Seller 
+{
+    int seller_id;
+    int32_t rate_below_300;           // Price per kWh in micro-units, valid if has_rate_below_300
+    int32_t rate_above_300;
+    bool has_rate_below_300;          // Set by the first transaction of the tier (any price, even 0)
+    bool has_rate_above_300;
+    struct Tariff* tariff;            // Schedule from TARIFF_FILE, NULL to price by the rates above
+    RegularBuyerNode* regular_buyers; // Linked list of regular buyers
+    int64_t total_revenue;            // Revenue in micro-units
+    TransactionSet transactions;      // Transactions sold by this seller
+} Seller;
+
+// Buyer struct
+typedef struct Buyer 
+{
+    int buyer_id;
+    int64_t total_energy_purchased;   // Sum of all energy bought, in Wh
+    TransactionSet transactions;      // Transactions bought by this buyer
+} Buyer;
+
+// Seller-Buyer Pair struct
+typedef struct SellerBuyerPair 
+{
+    int seller_id;
+    int buyer_id;
+    int number_of_transactions;
+} SellerBuyerPair;
+
+// B+ Tree Node
+typedef struct Node 
+{
+    int* keys;                    // Array of keys
+    int t;                        // Minimum degree
+    uint32_t epoch;               // Snapshot epoch the node was created in (see takeSnapshot)
+    struct Node** children;       // Array of child pointers (internal nodes only)
+    int n;                        // Current number of keys
+    bool leaf;                    // True if leaf node
+    struct Node* next;            // For leaf node chaining
+    void** records;               // Array of records, void* for flexibility (leaves only)
+} Node;
+
+typedef struct SnapshotState SnapshotState;
+typedef struct HashIndex HashIndex;
+
+// B+ Tree
+struct BTree 
+{
+    Node* root;
+    int t;                        // Minimum degree of leaves
+    int internal_t;               // Minimum degree of internal nodes
+    char type;                    // 'T' for Transaction, 'S' for Seller, 'B' for Buyer, 'P' for SellerBuyerPair
+    SnapshotState* cow;           // Copy-on-write state, NULL unless enableSnapshots was called
+    HashIndex* index;             // Point lookups by key, NULL unless enableHashIndex was called
+};
+
+#define MAX_TREE_HEIGHT 64
+
+#ifndef INTERNAL_FANOUT_FACTOR
+#define INTERNAL_FANOUT_FACTOR 2  // Internal node degree relative to leaf degree
+#endif
+
+// Root-to-leaf path recorded during a descent
+typedef struct TreePath 
+{
+    Node* nodes[MAX_TREE_HEIGHT]; // nodes[0] is the root, nodes[depth - 1] the leaf
+    int index[MAX_TREE_HEIGHT];   // Child index taken at each internal node, key position in the leaf
+    int depth;
+} TreePath;
+
+/*
+ * Hot-path metrics
+ *
+ * Building with -DENABLE_METRICS counts calls, latency (log2 nanosecond
+ * histograms) and an operation-specific item count for the instrumented
+ * operations: levels descended for search, keys moved for splits, records
+ * visited for scans. Without the flag the macros compile to nothing.
+ */
+typedef enum MetricId 
+{
+    METRIC_INSERT,
+    METRIC_SPLIT,
+    METRIC_SEARCH,
+    METRIC_PROCESS,
+    METRIC_SCAN_ALL_TRANSACTIONS,
+    METRIC_SCAN_ALL_SELLERS,
+    METRIC_SCAN_ALL_BUYERS,
+    METRIC_SCAN_TIME_RANGE,
+    METRIC_SCAN_SELLER_REVENUE,
+    METRIC_SCAN_ENERGY_RANGE,
+    METRIC_SCAN_BUYERS_BY_ENERGY,
+    METRIC_SCAN_PAIRS_BY_COUNT,
+    METRIC_SCAN_EXPORT,
+    NUM_METRICS
+} MetricId;
+
+#ifdef ENABLE_METRICS
+
+#define LATENCY_BUCKETS 40        // Bucket b holds latencies in [2^b, 2^(b+1)) ns
+
+typedef struct Metric 
+{
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t items;
+    uint64_t buckets[LATENCY_BUCKETS];
+} Metric;
+
+static Metric metrics[NUM_METRICS];
+static uint64_t nodesAllocated, nodeBytesAllocated, leafSplits, internalSplits, rootSplits;
+
+static inline uint64_t metricNow(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Query server workers record concurrently, so every update is a
+// relaxed atomic add: counts stay exact without ordering anything else
+static inline void metricRecord(MetricId id, uint64_t start, uint64_t items) 
+{
+    uint64_t ns = metricNow() - start;
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    Metric* metric = &metrics[id];
+    __atomic_fetch_add(&metric->calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->total_ns, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->items, items, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&metric->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1], 1, __ATOMIC_RELAXED);
+}
+
+#define METRIC_START(var) uint64_t var = metricNow()
+#define METRIC_STOP(id, var, items) metricRecord((id), (var), (uint64_t)(items))
+#define METRIC_ADD(counter, amount) __atomic_fetch_add(&(counter), (uint64_t)(amount), __ATOMIC_RELAXED)
+
+#else
+
+#define METRIC_START(var) ((void)0)
+#define METRIC_STOP(id, var, items) ((void)(items))
+#define METRIC_ADD(counter, amount) ((void)0)
+
+#endif
+
+// Linear lower bound: index of the first key >= key
+static inline int linearLowerBound(const int* keys, int n, int key)
+{
+    int i = 0;
+    while (i < n && key > keys[i]) i++;
+    return i;
+}
+
+// Branchless binary lower bound: index of the first key >= key
+static inline int binaryLowerBound(const int* keys, int n, int key)
+{
+    const int* base = keys;
+    int len = n;
+    
+    while (len > 1) 
+    {
+        int half = len / 2;
+        // Conditional move instead of a data-dependent branch
+        base = (base[half - 1] < key) ? base + half : base;
+        len -= half;
+    }
+    
+    return (int)(base - keys) + (len == 1 && *base < key);
+}
+
+// SIMD lower bound: counts the keys smaller than key, which for a sorted
+// array is exactly the index of the first key >= key
+static inline int simdLowerBound(const int* keys, int n, int key)
+{
+#if defined(__SSE2__)
+    __m128i needle = _mm_set1_epi32(key);
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    
+    // Each lane of the compare is -1 where keys[i] < key, so subtracting counts them
+    for (; i + 4 <= n; i += 4) 
+    {
+        __m128i block = _mm_loadu_si128((const __m128i*)(keys + i));
+        acc = _mm_sub_epi32(acc, _mm_cmplt_epi32(block, needle));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    int count = _mm_cvtsi128_si32(acc);
+    
+    for (; i < n; i++) 
+    {
+        count += keys[i] < key;
+    }
+    
+    return count;
+#else
+    return binaryLowerBound(keys, n, key);
+#endif
+}
+
+// Find the first key >= key in a node, choosing the strategy by node size
+static inline int nodeLowerBound(const Node* node, int key)
+{
+#if defined(__SSE2__)
+    if (node->n <= SIMD_SEARCH_MAX) return simdLowerBound(node->keys, node->n, key);
+#else
+    if (node->n <= LINEAR_SEARCH_MAX) return linearLowerBound(node->keys, node->n, key);
+#endif
+    return binaryLowerBound(node->keys, node->n, key);
+}
+
+// Find the first key > key in a node
+static inline int nodeUpperBound(const Node* node, int key)
+{
+    if (key == INT_MAX) return node->n;
+    return nodeLowerBound(node, key + 1);
+}
+
+/*
+ * Node and record arenas
+ *
+ * Nodes and transaction records are small, fixed-size and numerous, and a
+ * lookup touches one node per level plus the record, scattered over the heap.
+ * With 4 KB pages a large tree spans far more pages than the TLB covers, so
+ * most descents also pay page walks. An arena carves objects of one size out
+ * of 2 MB chunks aligned to a huge-page boundary and marked MADV_HUGEPAGE, so
+ * the kernel can back each chunk with one transparent huge page. On hosts with
+ * several NUMA nodes the chunks are interleaved across the nodes (mbind), so
+ * query workers on every socket see the same average latency rather than all
+ * memory landing on the socket that loaded the data.
+ *
+ * Each feature falls back on its own: without THP a chunk keeps 4 KB pages,
+ * with a single node (or no mbind) placement is first touch, and when a chunk
+ * cannot be mapped the object comes from malloc. arenaRelease finds the arena
+ * from the chunk address and hands anything else to free, so an object may be
+ * released whichever way it was allocated. Released objects go on a free list
+ * of their arena; chunks are never returned to the system.
+ */
+
+#ifndef NODE_ARENAS
+#define NODE_ARENAS 1                 // Allocate nodes and records from arenas (0 = malloc)
+#endif
+
+#ifndef ARENA_HUGE_PAGES
+#define ARENA_HUGE_PAGES 1            // Ask for transparent huge pages (0 = opt the chunks out)
+#endif
+
+#ifndef ARENA_NUMA_INTERLEAVE
+#define ARENA_NUMA_INTERLEAVE 1       // Interleave chunks across NUMA nodes when there are several
+#endif
+
+#define ARENA_CHUNK_BYTES ((size_t)2 << 20)   // One huge page on x86-64 and arm64
+#define ARENA_MAX_CLASSES 16                  // Object sizes with an arena; others use malloc
+#define ARENA_MAX_OBJECT (ARENA_CHUNK_BYTES / 64)
+#define ARENA_MPOL_INTERLEAVE 3               // MPOL_INTERLEAVE from <linux/mempolicy.h>
+
+typedef struct ArenaSettings 
+{
+    bool enabled;
+    bool huge_pages;
+    bool numa_interleave;
+} ArenaSettings;
+
+// Read when an object or chunk is allocated, so benchmarks can switch between runs
+ArenaSettings arenaSettings = { NODE_ARENAS, ARENA_HUGE_PAGES, ARENA_NUMA_INTERLEAVE };
+
+typedef struct Arena 
+{
+    size_t object_size;
+    char* next;                   // Bump pointer into the newest chunk
+    char* end;
+    void* free_list;              // Released objects, linked through their first word
+    long live;                    // Objects handed out and not released
+} Arena;
+
+typedef struct ArenaChunk 
+{
+    uintptr_t base;
+    Arena* arena;
+} ArenaChunk;
+
+typedef struct ArenaUsage 
+{
+    long chunks;
+    long huge_chunks;             // Chunks the kernel accepted MADV_HUGEPAGE for
+    long interleaved_chunks;      // Chunks spread over NUMA nodes
+    size_t reserved;              // Bytes mapped for chunks
+    size_t used;                  // Bytes of objects handed out and not released
+} ArenaUsage;
+
+static pthread_mutex_t arenaLock = PTHREAD_MUTEX_INITIALIZER;
+static Arena arenas[ARENA_MAX_CLASSES];
+static int numArenas = 0;
+static ArenaChunk* arenaChunks = NULL;    // Sorted by base
+static long arenaChunkCapacity = 0;
+static ArenaUsage arenaTotals;
+static int numaNodeCount = -1;            // Online nodes, probed on first use
+static unsigned long numaNodeMask = 0;
+
+// Read the online NUMA nodes (a list like "0-1,3") from sysfs; nodes past 63 are ignored
+static void probeNumaNodes(void) 
+{
+    numaNodeCount = 0;
+    FILE* file = fopen("/sys/devices/system/node/online", "r");
+    if (!file) return;
+    
+    int first, last;
+    while (fscanf(file, "%d", &first) == 1) 
+    {
+        last = first;
+        int c = fgetc(file);
+        if (c == '-' && fscanf(file, "%d", &last) == 1) c = fgetc(file);
+        for (int node = first; node <= last && node < 64; node++) 
+        {
+            if (node >= 0) numaNodeMask |= 1UL << node;
+        }
+        if (c != ',') break;
+    }
+    fclose(file);
+    numaNodeCount = __builtin_popcountl(numaNodeMask);
+}
+
+// Spread a fresh chunk's pages over every online node; false if there is one node or no mbind
+static bool interleaveChunk(char* chunk) 
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if (numaNodeCount < 0) probeNumaNodes();
+    if (numaNodeCount < 2) return false;
+    unsigned long mask = numaNodeMask;
+    return syscall(SYS_mbind, chunk, ARENA_CHUNK_BYTES, ARENA_MPOL_INTERLEAVE, &mask,
+                   sizeof(mask) * CHAR_BIT + 1, 0) == 0;
+#else
+    (void)chunk;
+    return false;
+#endif
+}
+
+// Map a chunk aligned to its own size, so its pages can be huge pages; NULL if mmap fails
+static char* mapArenaChunk(void) 
+{
+    size_t span = 2 * ARENA_CHUNK_BYTES;
+    char* raw = (char*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+    
+    // Trim the unaligned head and the tail beyond one chunk
+    char* chunk = (char*)(((uintptr_t)raw + ARENA_CHUNK_BYTES - 1) & ~(uintptr_t)(ARENA_CHUNK_BYTES - 1));
+    if (chunk > raw) munmap(raw, chunk - raw);
+    if (raw + span > chunk + ARENA_CHUNK_BYTES) munmap(chunk + ARENA_CHUNK_BYTES, raw + span - (chunk + ARENA_CHUNK_BYTES));
+    
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    if (madvise(chunk, ARENA_CHUNK_BYTES, arenaSettings.huge_pages ? MADV_HUGEPAGE : MADV_NOHUGEPAGE) == 0 &&
+        arenaSettings.huge_pages) 
+    {
+        arenaTotals.huge_chunks++;
+    }
+#endif
+    if (arenaSettings.numa_interleave && interleaveChunk(chunk)) arenaTotals.interleaved_chunks++;
+    return chunk;
+}
+
+// The arena owning the chunk at base, or NULL (binary search of the sorted chunk list)
+static Arena* chunkArena(uintptr_t base) 
+{
+    long lo = 0, hi = arenaTotals.chunks;
+    while (lo < hi) 
+    {
+        long mid = (lo + hi) / 2;
+        if (arenaChunks[mid].base < base) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < arenaTotals.chunks && arenaChunks[lo].base == base) ? arenaChunks[lo].arena : NULL;
+}
+
+// Give the arena a fresh chunk to carve from; false if none could be mapped or recorded
+static bool growArena(Arena* arena) 
+{
+    if (arenaTotals.chunks == arenaChunkCapacity) 
+    {
+        long capacity = arenaChunkCapacity ? arenaChunkCapacity * 2 : 64;
+        ArenaChunk* grown = (ArenaChunk*)realloc(arenaChunks, capacity * sizeof(ArenaChunk));
+        if (!grown) return false;
+        arenaChunks = grown;
+        arenaChunkCapacity = capacity;
+    }
+    
+    char* chunk = mapArenaChunk();
+    if (!chunk) return false;
+    
+    long i = arenaTotals.chunks;
+    while (i > 0 && arenaChunks[i - 1].base > (uintptr_t)chunk) 
+    {
+        arenaChunks[i] = arenaChunks[i - 1];
+        i--;
+    }
+    arenaChunks[i].base = (uintptr_t)chunk;
+    arenaChunks[i].arena = arena;
+    arenaTotals.chunks++;
+    arenaTotals.reserved += ARENA_CHUNK_BYTES;
+    
+    arena->next = chunk;
+    arena->end = chunk + ARENA_CHUNK_BYTES;
+    return true;
+}
+
+// Allocate size bytes from the arena for that size, or from malloc when arenas are
+// disabled, the size has no arena or no chunk can be mapped. NULL only if malloc fails.
+void* arenaAllocate(size_t size) 
+{
+    size = (size + 7) & ~(size_t)7;
+    if (!arenaSettings.enabled || size > ARENA_MAX_OBJECT) return malloc(size);
+    
+    void* object = NULL;
+    pthread_mutex_lock(&arenaLock);
+    Arena* arena = NULL;
+    for (int i = 0; i < numArenas && !arena; i++) 
+    {
+        if (arenas[i].object_size == size) arena = &arenas[i];
+    }
+    if (!arena && numArenas < ARENA_MAX_CLASSES) 
+    {
+        arena = &arenas[numArenas++];
+        arena->object_size = size;
+    }
+    
+    if (arena && arena->free_list) 
+    {
+        object = arena->free_list;
+        arena->free_list = *(void**)object;
+    }
+    else if (arena && (arena->end - arena->next >= (ptrdiff_t)size || growArena(arena))) 
+    {
+        object = arena->next;
+        arena->next += size;
+    }
+    if (object) 
+    {
+        arena->live++;
+        arenaTotals.used += size;
+    }
+    pthread_mutex_unlock(&arenaLock);
+    
+    return object ? object : malloc(size);
+}
+
+// Return an object to its arena, or to free if it did not come from one
+void arenaRelease(void* object) 
+{
+    if (!object) return;
+    
+    pthread_mutex_lock(&arenaLock);
+    Arena* arena = arenaTotals.chunks ? chunkArena((uintptr_t)object & ~(uintptr_t)(ARENA_CHUNK_BYTES - 1)) : NULL;
+    if (arena) 
+    {
+        *(void**)object = arena->free_list;
+        arena->free_list = object;
+        arena->live--;
+        arenaTotals.used -= arena->object_size;
+    }
+    pthread_mutex_unlock(&arenaLock);
+    
+    if (!arena) free(object);
+}
+
+// Chunks and bytes held by all arenas
+void arenaUsage(ArenaUsage* usage) 
+{
+    pthread_mutex_lock(&arenaLock);
+    *usage = arenaTotals;
+    pthread_mutex_unlock(&arenaLock);
+}
+
+// Epoch stamped on new nodes. Taking a snapshot advances it, so every node
+// that existed at that moment has an epoch at or below the snapshot's.
+static uint32_t nodeEpoch = 1;
+
+// Create a new node. The key array and either the records (leaf) or the
+// children (internal) array live in the same allocation as the node; internal
+// nodes carry no records since all records are stored in the leaves.
+Node* createNode(int t, bool leaf) 
+{
+    // One slot of slack beyond 2t-1 keys lets a node overflow before it is split
+    size_t keyBytes = (2 * t) * sizeof(int);
+    size_t slotBytes = leaf ? (2 * t) * sizeof(void*) : (2 * t + 1) * sizeof(Node*);
+    
+    Node* newNode = (Node*)arenaAllocate(sizeof(Node) + keyBytes + slotBytes);
+    if (!newNode) 
+    {
+        printf("Memory allocation failed for Node\n");
+        exit(1);
+    }
+    METRIC_ADD(nodesAllocated, 1);
+    METRIC_ADD(nodeBytesAllocated, sizeof(Node) + keyBytes + slotBytes);
+    
+    newNode->t = t;
+    newNode->epoch = __atomic_load_n(&nodeEpoch, __ATOMIC_RELAXED);
+    newNode->leaf = leaf;
+    newNode->n = 0;
+    newNode->next = NULL;
+    
+    // 2t ints keep the pointer array that follows 8-byte aligned
+    newNode->keys = (int*)(newNode + 1);
+    newNode->children = leaf ? NULL : (Node**)(newNode->keys + 2 * t);
+    newNode->records = leaf ? (void**)(newNode->keys + 2 * t) : NULL;
+    
+    return newNode;
+}
+
+// Create a new B+ Tree with separate leaf and internal node degrees
+BTree* createBTreeWithDegrees(int t, int internal_t, char type) 
+{
+    BTree* tree = (BTree*)malloc(sizeof(BTree));
+    if (!tree) 
+    {
+        printf("Memory allocation failed for BTree\n");
+        exit(1);
+    }
+    
+    tree->root = createNode(t, true);
+    tree->t = t;
+    tree->internal_t = internal_t;
+    tree->type = type;
+    tree->cow = NULL;
+    tree->index = NULL;
+    
+    return tree;
+}
+
+// Create a new B+ Tree. Internal nodes have no records array, so they get
+// INTERNAL_FANOUT_FACTOR times the leaf degree for about the same node size.
+BTree* createBTree(int t, char type) 
+{
+    return createBTreeWithDegrees(t, t * INTERNAL_FANOUT_FACTOR, type);
+}
+
+// Descend from the root to the leaf that holds (or would hold) key.
+// Separator keys[i] is the largest key in children[i], so the child to
+// follow is the first separator >= key. If path is not NULL the visited
+// nodes and child indexes are recorded for later split propagation.
+Node* findLeaf(BTree* tree, int key, TreePath* path) 
+{
+    Node* node = tree->root;
+    int depth = 0;
+    
+    while (!node->leaf) 
+    {
+        int i = nodeLowerBound(node, key);
+        if (path) 
+        {
+            path->nodes[depth] = node;
+            path->index[depth] = i;
+        }
+        depth++;
+        node = node->children[i];
+    }
+    
+    if (path) 
+    {
+        path->nodes[depth] = node;
+        path->index[depth] = nodeLowerBound(node, key);
+        path->depth = depth + 1;
+    }
+    
+    return node;
+}
+
+// Free a node and its arrays (not its children or records)
+void freeNode(Node* node) 
+{
+    arenaRelease(node);
+}
+
+/*
+ * Hash index
+ *
+ * Looking up a seller, buyer or pair by ID is a pure equality lookup, but a
+ * descent pays a cache miss or more per level. A HashIndex maps keys to
+ * records in an open-addressing table (linear probing, power-of-two capacity,
+ * grown before it is HASH_INDEX_LOAD_PERCENT full), so a lookup is usually a
+ * single probe. The trees stay as the ordered view for scans and reports, and
+ * every update keeps the index in step, so a key missing from the index is
+ * missing from the tree. Removal moves later entries of the probe run back
+ * instead of leaving tombstones.
+ *
+ * Typed trees (DEFINE_TYPED_BTREE) store values inline, so their index maps a
+ * key to the leaf holding it. Splits, borrows and merges repoint the keys they
+ * move to another leaf; shifts within a leaf only make the recorded slot a
+ * stale hint, and the leaf is searched when the key is not at that slot.
+ */
+
+#ifndef LOOKUP_INDEX
+#define LOOKUP_INDEX 1                // Hash-index sellers, buyers and pairs (0 = descents only)
+#endif
+
+#define HASH_INDEX_MIN_CAPACITY 64
+#define HASH_INDEX_LOAD_PERCENT 70    // Probe runs lengthen quickly beyond this
+
+typedef struct HashSlot 
+{
+    uint64_t key;
+    void* record;                 // NULL marks an empty slot
+    uint32_t position;            // Typed trees: slot in the leaf where the key was last seen
+} HashSlot;
+
+struct HashIndex 
+{
+    HashSlot* slots;
+    size_t mask;                  // Capacity - 1
+    size_t count;
+};
+
+// First slot to probe for key (the murmur3 finalizer spreads sequential IDs)
+static inline size_t hashIndexHome(const HashIndex* index, uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (size_t)key & index->mask;
+}
+
+static HashSlot* allocateHashSlots(size_t capacity) 
+{
+    HashSlot* slots = (HashSlot*)calloc(capacity, sizeof(HashSlot));
+    if (!slots) 
+    {
+        printf("Memory allocation failed for HashIndex\n");
+        exit(1);
+    }
+    return slots;
+}
+
+// Create an empty index with room for about expected keys before it grows
+HashIndex* createHashIndex(size_t expected) 
+{
+    HashIndex* index = (HashIndex*)malloc(sizeof(HashIndex));
+    if (!index) 
+    {
+        printf("Memory allocation failed for HashIndex\n");
+        exit(1);
+    }
+    
+    size_t capacity = HASH_INDEX_MIN_CAPACITY;
+    while (capacity * HASH_INDEX_LOAD_PERCENT / 100 < expected) capacity *= 2;
+    index->slots = allocateHashSlots(capacity);
+    index->mask = capacity - 1;
+    index->count = 0;
+    return index;
+}
+
+void freeHashIndex(HashIndex* index) 
+{
+    if (!index) return;
+    free(index->slots);
+    free(index);
+}
+
+// The slot holding key, or NULL
+static inline HashSlot* hashIndexFind(const HashIndex* index, uint64_t key)
+{
+    for (size_t i = hashIndexHome(index, key); ; i = (i + 1) & index->mask) 
+    {
+        HashSlot* slot = &index->slots[i];
+        if (!slot->record) return NULL;
+        if (slot->key == key) return slot;
+    }
+}
+
+// Double the capacity, reinserting every entry
+static void growHashIndex(HashIndex* index) 
+{
+    HashSlot* old = index->slots;
+    size_t oldCapacity = index->mask + 1;
+    index->slots = allocateHashSlots(oldCapacity * 2);
+    index->mask = oldCapacity * 2 - 1;
+    
+    for (size_t j = 0; j < oldCapacity; j++) 
+    {
+        if (!old[j].record) continue;
+        size_t i = hashIndexHome(index, old[j].key);
+        while (index->slots[i].record) i = (i + 1) & index->mask;
+        index->slots[i] = old[j];
+    }
+    free(old);
+}
+
+// Map key to record (and, for typed trees, the value's position), replacing any earlier entry
+void hashIndexPut(HashIndex* index, uint64_t key, void* record, uint32_t position) 
+{
+    size_t i = hashIndexHome(index, key);
+    while (index->slots[i].record && index->slots[i].key != key) i = (i + 1) & index->mask;
+    
+    HashSlot* slot = &index->slots[i];
+    if (!slot->record) 
+    {
+        if ((index->count + 1) * 100 > (index->mask + 1) * HASH_INDEX_LOAD_PERCENT) 
+        {
+            growHashIndex(index);
+            hashIndexPut(index, key, record, position);
+            return;
+        }
+        slot->key = key;
+        index->count++;
+    }
+    slot->record = record;
+    slot->position = position;
+}
+
+// Drop key from the index, if present
+void hashIndexRemove(HashIndex* index, uint64_t key) 
+{
+    HashSlot* slot = hashIndexFind(index, key);
+    if (!slot) return;
+    
+    // Pull back every later entry of the run whose home is not between the hole and itself
+    size_t hole = (size_t)(slot - index->slots);
+    for (size_t i = (hole + 1) & index->mask; index->slots[i].record; i = (i + 1) & index->mask) 
+    {
+        size_t home = hashIndexHome(index, index->slots[i].key);
+        if (((i - home) & index->mask) >= ((i - hole) & index->mask)) 
+        {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].record = NULL;
+    index->count--;
+}
+
+// Index keys in the generic trees (int keys, records that never move)
+static inline uint64_t recordIndexKey(int key)
+{
+    return (uint32_t)key;
+}
+
+/*
+ * Copy-on-write snapshots
+ *
+ * A snapshot is a reference-counted, read-only root of a tree as it was at
+ * one moment (takeSnapshot). The live tree keeps changing underneath: while
+ * snapshots exist, an update first copies every node it is about to modify
+ * that a snapshot still shares (path copying), and nodes and records it drops
+ * are retired instead of freed until no snapshot can reach them. A node is
+ * shared if its epoch is at or below the newest snapshot's. Snapshot readers
+ * walk the tree structure and never follow leaf links, which the live tree
+ * keeps repairing in shared leaves, so the live leaf chain stays intact for
+ * scans. Updates to a tree with snapshots enabled hold its lock, so snapshots
+ * can be taken and released from other threads at any time.
+ */
+
+typedef struct TreeSnapshot 
+{
+    Node* root;
+    uint32_t epoch;               // Nodes with epoch <= this may be reachable from root
+    int refs;                     // Guarded by the tree's snapshot lock
+    BTree* tree;
+    struct TreeSnapshot* next;    // Live snapshots of the tree, oldest first
+} TreeSnapshot;
+
+// A node or record the live tree dropped while snapshots could still reach it
+typedef struct RetiredItem 
+{
+    void* item;                   // Nodes and records are both single allocations
+    uint32_t epoch;               // nodeEpoch when retired; older snapshots may reach it
+    struct RetiredItem* next;
+} RetiredItem;
+
+struct SnapshotState 
+{
+    pthread_mutex_t lock;         // Held for each update, and to take or release a snapshot
+    uint32_t frozen;              // Epoch of the newest live snapshot, 0 when there is none
+    TreeSnapshot* snapshots;      // Oldest first
+    RetiredItem* retired;         // Oldest first
+    RetiredItem* retiredTail;
+    long retiredItems;            // Currently waiting for snapshots to be released
+    long copiedNodes;             // Copied because a snapshot shared them, since enableSnapshots
+};
+
+static inline void beginTreeUpdate(BTree* tree) 
+{
+    if (tree->cow) pthread_mutex_lock(&tree->cow->lock);
+}
+
+static inline void endTreeUpdate(BTree* tree) 
+{
+    if (tree->cow) pthread_mutex_unlock(&tree->cow->lock);
+}
+
+// True if a snapshot may reach the node, so the live tree must copy it before changing it
+static inline bool isShared(const BTree* tree, const Node* node) 
+{
+    return tree->cow && node->epoch <= tree->cow->frozen;
+}
+
+// Keep a dropped node or record until the snapshots that may reach it are released
+static void retireItem(BTree* tree, void* item) 
+{
+    RetiredItem* retired = (RetiredItem*)malloc(sizeof(RetiredItem));
+    if (!retired) 
+    {
+        printf("Memory allocation failed for RetiredItem\n");
+        exit(1);
+    }
+    retired->item = item;
+    retired->epoch = __atomic_load_n(&nodeEpoch, __ATOMIC_RELAXED);
+    retired->next = NULL;
+    
+    SnapshotState* cow = tree->cow;
+    if (cow->retiredTail) cow->retiredTail->next = retired;
+    else cow->retired = retired;
+    cow->retiredTail = retired;
+    cow->retiredItems++;
+}
+
+// Free a node the live tree dropped, unless a snapshot may still reach it
+static void releaseNode(BTree* tree, Node* node) 
+{
+    if (isShared(tree, node)) retireItem(tree, node);
+    else freeNode(node);
+}
+
+// Private copy of a shared node for the live tree; the original is retired
+static Node* copyNode(BTree* tree, Node* node) 
+{
+    Node* copy = createNode(node->t, node->leaf);
+    copy->n = node->n;
+    copy->next = node->next;
+    memcpy(copy->keys, node->keys, node->n * sizeof(int));
+    if (node->leaf) memcpy(copy->records, node->records, node->n * sizeof(void*));
+    else memcpy(copy->children, node->children, (node->n + 1) * sizeof(Node*));
+    
+    tree->cow->copiedNodes++;
+    retireItem(tree, node);
+    return copy;
+}
+
+// The leaf before the leftmost leaf under children[c] of path->nodes[level - 1], or NULL
+static Node* leafBefore(const TreePath* path, int level, int c) 
+{
+    Node* node = NULL;
+    if (c > 0) 
+    {
+        node = path->nodes[level - 1]->children[c - 1];
+    } 
+    else 
+    {
+        for (int l = level - 2; l >= 0 && !node; l--) 
+        {
+            if (path->index[l] > 0) node = path->nodes[l]->children[path->index[l] - 1];
+        }
+    }
+    
+    while (node && !node->leaf) node = node->children[node->n];
+    return node;
+}
+
+// Make children[c] of path->nodes[level - 1] (already private) private too
+static Node* thawChild(BTree* tree, TreePath* path, int level, int c) 
+{
+    Node* parent = path->nodes[level - 1];
+    Node* node = parent->children[c];
+    if (!isShared(tree, node)) return node;
+    
+    Node* copy = copyNode(tree, node);
+    parent->children[c] = copy;
+    if (copy->leaf) 
+    {
+        // Relink the live leaf chain; snapshots don't follow it
+        Node* previous = leafBefore(path, level, c);
+        if (previous) previous->next = copy;
+    }
+    return copy;
+}
+
+// Make every node on a recorded path private to the live tree; returns the leaf
+static Node* thawPath(BTree* tree, TreePath* path) 
+{
+    if (tree->cow->frozen != 0) 
+    {
+        if (isShared(tree, path->nodes[0])) path->nodes[0] = tree->root = copyNode(tree, path->nodes[0]);
+        for (int level = 1; level < path->depth; level++) 
+        {
+            path->nodes[level] = thawChild(tree, path, level, path->index[level - 1]);
+        }
+    }
+    return path->nodes[path->depth - 1];
+}
+
+// Split an overflowing child node into two and add the separator to parent
+void splitChild(Node* parent, int i, Node* child) 
+{
+    METRIC_START(splitStart);
+    int t = child->t;
+    Node* newChild = createNode(t, child->leaf);
+    
+    if (child->leaf) 
+    {
+        // Leaves keep every key; the separator is a copy of the left half's last key
+        int leftN = (child->n + 1) / 2;
+        newChild->n = child->n - leftN;
+        memcpy(newChild->keys, &child->keys[leftN], newChild->n * sizeof(int));
+        memcpy(newChild->records, &child->records[leftN], newChild->n * sizeof(void*));
+        child->n = leftN;
+        
+        // Update the leaf node chain
+        newChild->next = child->next;
+        child->next = newChild;
+        METRIC_ADD(leafSplits, 1);
+    } 
+    else 
+    {
+        // Internal nodes move the middle key up into the parent
+        int leftN = child->n / 2;
+        newChild->n = child->n - leftN - 1;
+        memcpy(newChild->keys, &child->keys[leftN + 1], newChild->n * sizeof(int));
+        memcpy(newChild->children, &child->children[leftN + 1], (newChild->n + 1) * sizeof(Node*));
+        child->n = leftN;
+        METRIC_ADD(internalSplits, 1);
+    }
+    
+    // Shift parent's children and keys to accommodate new child
+    memmove(&parent->children[i + 2], &parent->children[i + 1], (parent->n - i) * sizeof(Node*));
+    memmove(&parent->keys[i + 1], &parent->keys[i], (parent->n - i) * sizeof(int));
+    
+    // Place the separator into parent
+    parent->children[i + 1] = newChild;
+    parent->keys[i] = child->leaf ? child->keys[child->n - 1] : child->keys[child->n];
+    parent->n++;
+    METRIC_STOP(METRIC_SPLIT, splitStart, newChild->n);
+}
+
+// Split overflowing nodes along a recorded path, from the leaf upwards
+void propagateSplits(BTree* tree, TreePath* path) 
+{
+    for (int level = path->depth - 1; level >= 0; level--) 
+    {
+        Node* node = path->nodes[level];
+        if (node->n <= 2 * node->t - 1) return;
+        
+        if (level == 0) 
+        {
+            // Root overflowed, grow the tree by one level
+            Node* s = createNode(tree->internal_t, false);
+            s->children[0] = node;
+            tree->root = s;
+            METRIC_ADD(rootSplits, 1);
+            splitChild(s, 0, node);
+        } 
+        else 
+        {
+            splitChild(path->nodes[level - 1], path->index[level - 1], node);
+        }
+    }
+}
+
+// Insert a key and record into a leaf found by findLeaf (may overflow by one)
+void insertIntoLeaf(Node* leaf, int key, void* record) 
+{
+    // Position after any keys equal to the new key
+    int i = nodeUpperBound(leaf, key);
+    
+    // Shift larger keys to make room for the new key
+    memmove(&leaf->keys[i + 1], &leaf->keys[i], (leaf->n - i) * sizeof(int));
+    memmove(&leaf->records[i + 1], &leaf->records[i], (leaf->n - i) * sizeof(void*));
+    
+    leaf->keys[i] = key;
+    leaf->records[i] = record;
+    leaf->n++;
+}
+
+// Generic insert function: one top-down pass records the path, then
+// any splits are propagated bottom-up along it
+void insert(BTree* tree, int key, void* record) 
+{
+    METRIC_START(insertStart);
+    beginTreeUpdate(tree);
+    TreePath path;
+    Node* leaf = findLeaf(tree, key, &path);
+    if (tree->cow) leaf = thawPath(tree, &path);
+    
+    insertIntoLeaf(leaf, key, record);
+    propagateSplits(tree, &path);
+    if (tree->index) hashIndexPut(tree->index, recordIndexKey(key), record, 0);
+    endTreeUpdate(tree);
+    METRIC_STOP(METRIC_INSERT, insertStart, path.depth);
+}
+
+// Move one key from the left sibling into node (children[idx] of parent)
+void borrowFromLeft(Node* parent, int idx, Node* node) 
+{
+    Node* left = parent->children[idx - 1];
+    
+    memmove(&node->keys[1], &node->keys[0], node->n * sizeof(int));
+    if (node->leaf) 
+    {
+        memmove(&node->records[1], &node->records[0], node->n * sizeof(void*));
+        node->keys[0] = left->keys[left->n - 1];
+        node->records[0] = left->records[left->n - 1];
+        left->n--;
+        parent->keys[idx - 1] = left->keys[left->n - 1];
+    } 
+    else 
+    {
+        memmove(&node->children[1], &node->children[0], (node->n + 1) * sizeof(Node*));
+        node->keys[0] = parent->keys[idx - 1];
+        node->children[0] = left->children[left->n];
+        parent->keys[idx - 1] = left->keys[left->n - 1];
+        left->n--;
+    }
+    node->n++;
+}
+
+// Move one key from the right sibling into node (children[idx] of parent)
+void borrowFromRight(Node* parent, int idx, Node* node) 
+{
+    Node* right = parent->children[idx + 1];
+    
+    if (node->leaf) 
+    {
+        node->keys[node->n] = right->keys[0];
+        node->records[node->n] = right->records[0];
+        parent->keys[idx] = right->keys[0];
+        memmove(&right->records[0], &right->records[1], (right->n - 1) * sizeof(void*));
+    } 
+    else 
+    {
+        node->keys[node->n] = parent->keys[idx];
+        node->children[node->n + 1] = right->children[0];
+        parent->keys[idx] = right->keys[0];
+        memmove(&right->children[0], &right->children[1], right->n * sizeof(Node*));
+    }
+    memmove(&right->keys[0], &right->keys[1], (right->n - 1) * sizeof(int));
+    right->n--;
+    node->n++;
+}
+
+// Merge children[idx + 1] of parent into children[idx] and drop the separator.
+// Returns the emptied right child for the caller to free.
+Node* mergeChildren(Node* parent, int idx) 
+{
+    Node* left = parent->children[idx];
+    Node* right = parent->children[idx + 1];
+    
+    if (left->leaf) 
+    {
+        memcpy(&left->keys[left->n], right->keys, right->n * sizeof(int));
+        memcpy(&left->records[left->n], right->records, right->n * sizeof(void*));
+        left->n += right->n;
+        
+        // Repair the leaf chain around the removed leaf
+        left->next = right->next;
+    } 
+    else 
+    {
+        left->keys[left->n] = parent->keys[idx];
+        memcpy(&left->keys[left->n + 1], right->keys, right->n * sizeof(int));
+        memcpy(&left->children[left->n + 1], right->children, (right->n + 1) * sizeof(Node*));
+        left->n += right->n + 1;
+    }
+    
+    // Remove the separator and the right child from the parent
+    memmove(&parent->keys[idx], &parent->keys[idx + 1], (parent->n - idx - 1) * sizeof(int));
+    memmove(&parent->children[idx + 1], &parent->children[idx + 2], (parent->n - idx - 1) * sizeof(Node*));
+    parent->n--;
+    
+    return right;
+}
+
+// Fix underflowing nodes along a recorded path, from the leaf upwards.
+// The path must be private to the live tree (thawPath); siblings are made
+// private before they are changed.
+void rebalanceAfterRemoval(BTree* tree, TreePath* path) 
+{
+    for (int level = path->depth - 1; level > 0; level--) 
+    {
+        Node* node = path->nodes[level];
+        int minKeys = node->t - 1;    // Siblings on the same level share the degree
+        if (node->n >= minKeys) break;
+        
+        Node* parent = path->nodes[level - 1];
+        int idx = path->index[level - 1];
+        
+        if (idx > 0 && parent->children[idx - 1]->n > minKeys) 
+        {
+            thawChild(tree, path, level, idx - 1);
+            borrowFromLeft(parent, idx, node);
+            break;
+        }
+        if (idx < parent->n && parent->children[idx + 1]->n > minKeys) 
+        {
+            thawChild(tree, path, level, idx + 1);
+            borrowFromRight(parent, idx, node);
+            break;
+        }
+        
+        // Neither sibling can spare a key, merge with one of them
+        int left = idx > 0 ? idx - 1 : idx;
+        thawChild(tree, path, level, left);
+        releaseNode(tree, mergeChildren(parent, left));
+    }
+    
+    // Shrink the tree when the root is left with a single child
+    Node* root = tree->root;
+    if (!root->leaf && root->n == 0) 
+    {
+        tree->root = root->children[0];
+        releaseNode(tree, root);
+    }
+}
+
+// Remove a key from the B+ tree and return its record (NULL if not found)
+void* removeKey(BTree* tree, int key) 
+{
+    beginTreeUpdate(tree);
+    TreePath path;
+    Node* leaf = findLeaf(tree, key, &path);
+    int i = path.index[path.depth - 1];
+    
+    if (i >= leaf->n || leaf->keys[i] != key) 
+    {
+        endTreeUpdate(tree);
+        return NULL;
+    }
+    if (tree->cow) leaf = thawPath(tree, &path);
+    
+    void* record = leaf->records[i];
+    memmove(&leaf->keys[i], &leaf->keys[i + 1], (leaf->n - i - 1) * sizeof(int));
+    memmove(&leaf->records[i], &leaf->records[i + 1], (leaf->n - i - 1) * sizeof(void*));
+    leaf->n--;
+    if (tree->index) hashIndexRemove(tree->index, recordIndexKey(key));
+    
+    rebalanceAfterRemoval(tree, &path);
+    endTreeUpdate(tree);
+    return record;
+}
+
+// Find key for a possible insert: returns its record, or NULL with path left at the
+// position insertAtPath adds the key at, so creating a missing record costs one descent.
+// With a hash index, keys present are found without descending.
+void* searchForInsert(BTree* tree, int key, TreePath* path) 
+{
+    if (tree->index) 
+    {
+        HashSlot* slot = hashIndexFind(tree->index, recordIndexKey(key));
+        if (slot) return slot->record;
+    }
+    
+    Node* leaf = findLeaf(tree, key, path);
+    int i = path->index[path->depth - 1];
+    return (i < leaf->n && leaf->keys[i] == key) ? leaf->records[i] : NULL;
+}
+
+// Insert an absent key at the position searchForInsert recorded. Only the
+// updating thread changes a tree, so the path is still current.
+void insertAtPath(BTree* tree, TreePath* path, int key, void* record) 
+{
+    METRIC_START(insertStart);
+    beginTreeUpdate(tree);
+    Node* leaf = tree->cow ? thawPath(tree, path) : path->nodes[path->depth - 1];
+    
+    insertIntoLeaf(leaf, key, record);
+    propagateSplits(tree, path);
+    if (tree->index) hashIndexPut(tree->index, recordIndexKey(key), record, 0);
+    endTreeUpdate(tree);
+    METRIC_STOP(METRIC_INSERT, insertStart, path->depth);
+}
+
+// Insert a key only if it is absent, detecting duplicates in the same descent.
+// Returns the record already stored under key, or NULL if the new one was inserted.
+void* insertIfAbsent(BTree* tree, int key, void* record) 
+{
+    TreePath path;
+    void* existing = searchForInsert(tree, key, &path);
+    if (!existing) insertAtPath(tree, &path, key, record);
+    return existing;
+}
+
+// Search for a record in a B+ Tree by key
+void* search(Node* node, int key) 
+{
+    METRIC_START(searchStart);
+    int levels = 1;
+    
+    // Internal keys are only separators, records live in the leaves
+    while (!node->leaf) 
+    {
+        node = node->children[nodeLowerBound(node, key)];
+        levels++;
+    }
+    
+    // Find the first key greater than or equal to key
+    int i = nodeLowerBound(node, key);
+    void* record = (i < node->n && node->keys[i] == key) ? node->records[i] : NULL;
+    
+    METRIC_STOP(METRIC_SEARCH, searchStart, levels);
+    return record;
+}
+
+// Find the record stored under key: one hash probe if the tree has an index, else a descent
+void* lookup(BTree* tree, int key) 
+{
+    if (!tree->index) return search(tree->root, key);
+    
+    METRIC_START(searchStart);
+    HashSlot* slot = hashIndexFind(tree->index, recordIndexKey(key));
+    METRIC_STOP(METRIC_SEARCH, searchStart, 0);
+    return slot ? slot->record : NULL;
+}
+
+// Index the keys of a tree by hash from now on. Call before the tree is shared between threads.
+void enableHashIndex(BTree* tree) 
+{
+    if (tree->index) return;
+    
+    Node* leaf = tree->root;
+    while (!leaf->leaf) leaf = leaf->children[0];
+    
+    size_t keys = 0;
+    for (Node* node = leaf; node != NULL; node = node->next) keys += node->n;
+    tree->index = createHashIndex(keys);
+    for (; leaf != NULL; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) hashIndexPut(tree->index, recordIndexKey(leaf->keys[i]), leaf->records[i], 0);
+    }
+}
+
+// Let snapshots be taken of a tree. Call before the tree is shared between threads.
+void enableSnapshots(BTree* tree) 
+{
+    if (tree->cow) return;
+    SnapshotState* cow = (SnapshotState*)calloc(1, sizeof(SnapshotState));
+    if (!cow) 
+    {
+        printf("Memory allocation failed for SnapshotState\n");
+        exit(1);
+    }
+    pthread_mutex_init(&cow->lock, NULL);
+    tree->cow = cow;
+}
+
+// Take a point-in-time view of a tree with snapshots enabled, O(1). The
+// snapshot stays valid and unchanged until released, whatever the tree does.
+TreeSnapshot* takeSnapshot(BTree* tree) 
+{
+    TreeSnapshot* snapshot = (TreeSnapshot*)malloc(sizeof(TreeSnapshot));
+    if (!snapshot) 
+    {
+        printf("Memory allocation failed for TreeSnapshot\n");
+        exit(1);
+    }
+    
+    SnapshotState* cow = tree->cow;
+    pthread_mutex_lock(&cow->lock);
+    snapshot->root = tree->root;
+    snapshot->epoch = __atomic_fetch_add(&nodeEpoch, 1, __ATOMIC_RELAXED);
+    snapshot->refs = 1;
+    snapshot->tree = tree;
+    snapshot->next = NULL;
+    
+    TreeSnapshot** link = &cow->snapshots;
+    while (*link) link = &(*link)->next;
+    *link = snapshot;
+    cow->frozen = snapshot->epoch;
+    pthread_mutex_unlock(&cow->lock);
+    
+    return snapshot;
+}
+
+// Add a holder to a snapshot, e.g. before handing it to another thread
+void retainSnapshot(TreeSnapshot* snapshot) 
+{
+    pthread_mutex_lock(&snapshot->tree->cow->lock);
+    snapshot->refs++;
+    pthread_mutex_unlock(&snapshot->tree->cow->lock);
+}
+
+// Drop a holder; the last one frees the snapshot and whatever only it kept alive
+void releaseSnapshot(TreeSnapshot* snapshot) 
+{
+    SnapshotState* cow = snapshot->tree->cow;
+    pthread_mutex_lock(&cow->lock);
+    if (--snapshot->refs > 0) 
+    {
+        pthread_mutex_unlock(&cow->lock);
+        return;
+    }
+    
+    TreeSnapshot** link = &cow->snapshots;
+    while (*link != snapshot) link = &(*link)->next;
+    *link = snapshot->next;
+    
+    TreeSnapshot* newest = cow->snapshots;
+    while (newest && newest->next) newest = newest->next;
+    cow->frozen = newest ? newest->epoch : 0;
+    
+    // Items retired at epoch e are reachable only from snapshots older than e
+    uint32_t oldest = cow->snapshots ? cow->snapshots->epoch : UINT32_MAX;
+    while (cow->retired && cow->retired->epoch <= oldest) 
+    {
+        RetiredItem* retired = cow->retired;
+        cow->retired = retired->next;
+        arenaRelease(retired->item);
+        free(retired);
+        cow->retiredItems--;
+    }
+    if (!cow->retired) cow->retiredTail = NULL;
+    pthread_mutex_unlock(&cow->lock);
+    
+    free(snapshot);
+}
+
+// Visit a snapshot's records in key order; returns the number visited.
+// Walks the tree structure, since leaf links may have changed since.
+long forEachInSnapshot(const TreeSnapshot* snapshot, void (*visit)(void* record, void* ctx), void* ctx) 
+{
+    Node* nodes[MAX_TREE_HEIGHT];
+    int next[MAX_TREE_HEIGHT];
+    int depth = 0;
+    long visited = 0;
+    nodes[0] = snapshot->root;
+    next[0] = 0;
+    
+    while (depth >= 0) 
+    {
+        Node* node = nodes[depth];
+        if (node->leaf) 
+        {
+            for (int i = 0; i < node->n; i++) visit(node->records[i], ctx);
+            visited += node->n;
+            depth--;
+        } 
+        else if (next[depth] > node->n) 
+        {
+            depth--;
+        } 
+        else 
+        {
+            nodes[depth + 1] = node->children[next[depth]++];
+            next[depth + 1] = 0;
+            depth++;
+        }
+    }
+    return visited;
+}
+
+// Free a record removed from the tree, or retire it while snapshots may still see it
+void releaseRecord(BTree* tree, void* record) 
+{
+    if (!tree->cow) 
+    {
+        arenaRelease(record);
+        return;
+    }
+    
+    beginTreeUpdate(tree);
+    if (tree->cow->frozen != 0) retireItem(tree, record);
+    else arenaRelease(record);
+    endTreeUpdate(tree);
+}
+
+// Store a new record under an existing key; returns the old record (NULL if key is absent)
+void* replaceRecord(BTree* tree, int key, void* record) 
+{
+    beginTreeUpdate(tree);
+    TreePath path;
+    Node* leaf = findLeaf(tree, key, &path);
+    int i = path.index[path.depth - 1];
+    
+    void* old = NULL;
+    if (i < leaf->n && leaf->keys[i] == key) 
+    {
+        if (tree->cow) leaf = thawPath(tree, &path);
+        old = leaf->records[i];
+        leaf->records[i] = record;
+        if (tree->index) hashIndexPut(tree->index, recordIndexKey(key), record, 0);
+    }
+    endTreeUpdate(tree);
+    return old;
+}
+
+// Shape of a B+ tree, or of several trees added together
+typedef struct TreeStats 
+{
+    int height;                   // Tallest tree
+    long leaf_nodes;
+    long internal_nodes;
+    long leaf_keys;
+    long internal_keys;
+    long leaf_slots;              // Key capacity (2t-1 per node)
+    long internal_slots;
+    size_t bytes;                 // Node allocations
+} TreeStats;
+
+// Add the nodes below node (at 1-based depth) to stats
+void collectNodeStats(Node* node, int depth, TreeStats* stats) 
+{
+    if (depth > stats->height) stats->height = depth;
+    stats->bytes += sizeof(Node) + (2 * node->t) * sizeof(int) + 
+                    (node->leaf ? (2 * node->t) * sizeof(void*) : (2 * node->t + 1) * sizeof(Node*));
+    if (node->leaf) 
+    {
+        stats->leaf_nodes++;
+        stats->leaf_keys += node->n;
+        stats->leaf_slots += 2 * node->t - 1;
+        return;
+    }
+    
+    stats->internal_nodes++;
+    stats->internal_keys += node->n;
+    stats->internal_slots += 2 * node->t - 1;
+    for (int i = 0; i <= node->n; i++) collectNodeStats(node->children[i], depth + 1, stats);
+}
+
+void collectTreeStats(BTree* tree, TreeStats* stats) 
+{
+    if (tree && tree->root) collectNodeStats(tree->root, 1, stats);
+}
+
+// Initialize an empty transaction set
+void initTransactionSet(TransactionSet* set) 
+{
+    set->count = 0;
+    set->promoted = false;
+    set->tree = NULL;
+}
+
+// Add a transaction to a set, promoting it to a B+ tree when the inline array is full
+void addToTransactionSet(TransactionSet* set, Transaction* tx) 
+{
+    if (!set->promoted && set->count < TXSET_INLINE_CAPACITY) 
+    {
+        int i = set->count;
+        while (i > 0 && set->items[i - 1]->transaction_id > tx->transaction_id) 
+        {
+            set->items[i] = set->items[i - 1];
+            i--;
+        }
+        set->items[i] = tx;
+        set->count++;
+        return;
+    }
+    
+    if (!set->promoted) 
+    {
+        // Move the inline transactions into a new tree
+        Transaction* items[TXSET_INLINE_CAPACITY];
+        memcpy(items, set->items, sizeof(items));
+        set->tree = createBTree(ORDER/2, 'T');
+        set->promoted = true;
+        for (int i = 0; i < set->count; i++) 
+        {
+            insert(set->tree, items[i]->transaction_id, items[i]);
+        }
+    }
+    
+    insert(set->tree, tx->transaction_id, tx);
+    set->count++;
+}
+
+// Remove a transaction from a set by ID, returning it (NULL if not present)
+Transaction* removeFromTransactionSet(TransactionSet* set, int transaction_id) 
+{
+    if (set->promoted) 
+    {
+        Transaction* tx = (Transaction*)removeKey(set->tree, transaction_id);
+        if (tx) set->count--;
+        return tx;
+    }
+    
+    for (int i = 0; i < set->count; i++) 
+    {
+        if (set->items[i]->transaction_id == transaction_id) 
+        {
+            Transaction* tx = set->items[i];
+            memmove(&set->items[i], &set->items[i + 1], (set->count - i - 1) * sizeof(Transaction*));
+            set->count--;
+            return tx;
+        }
+    }
+    return NULL;
+}
+
+// Find a transaction in a set by ID
+Transaction* searchTransactionSet(TransactionSet* set, int transaction_id) 
+{
+    if (set->promoted) return (Transaction*)search(set->tree->root, transaction_id);
+    
+    for (int i = 0; i < set->count; i++) 
+    {
+        if (set->items[i]->transaction_id == transaction_id) return set->items[i];
+    }
+    return NULL;
+}
+
+// Call visit for every transaction in a set, in ID order
+void forEachInTransactionSet(TransactionSet* set, void (*visit)(Transaction* tx, void* ctx), void* ctx) 
+{
+    if (!set->promoted) 
+    {
+        for (int i = 0; i < set->count; i++) visit(set->items[i], ctx);
+        return;
+    }
+    
+    Node* current = set->tree->root;
+    while (!current->leaf) current = current->children[0];
+    
+    for (; current != NULL; current = current->next) 
+    {
+        for (int i = 0; i < current->n; i++) visit((Transaction*)current->records[i], ctx);
+    }
+}
+
+/*
+ * Typed B+ trees
+ *
+ * DEFINE_TYPED_BTREE(Name, KeyType, ValueType, T) generates a B+ tree
+ * specialized for one key and value type with minimum degree T: the Name and
+ * Name##Node types plus Name##Create, Name##Search, Name##Insert, Name##Remove,
+ * Name##FirstLeaf and Name##CollectStats. Values are stored inline in the leaves, so there is no
+ * per-record allocation or pointer chase, and key comparisons are compiled
+ * for KeyType. Pointers returned by Search/Insert stay valid only until the
+ * next Insert or Remove on the same tree, since splits and merges move values.
+ * Keys must be comparable with < and ==; duplicate keys are not stored.
+ * After Name##EnableIndex, Search and Insert find existing keys through a
+ * HashIndex of the leaves holding them (integer keys only).
+ */
+#define DEFINE_TYPED_BTREE(Name, KeyType, ValueType, T)                                          \
+                                                                                                  \
+typedef struct Name##Node                                                                         \
+{                                                                                                 \
+    int n;                                                /* Current number of keys */            \
+    bool leaf;                                                                                    \
+    struct Name##Node* next;                              /* Leaf chain */                        \
+    KeyType keys[2 * (T)];                                /* One slot of slack for splits */      \
+    union                                                                                         \
+    {                                                                                             \
+        ValueType values[2 * (T)];                        /* Leaves */                            \
+        struct Name##Node* children[2 * (T) + 1];         /* Internal nodes */                    \
+    };                                                                                            \
+} Name##Node;                                                                                     \
+                                                                                                  \
+typedef struct Name                                                                               \
+{                                                                                                 \
+    Name##Node* root;                                                                             \
+    long count;                                                                                   \
+    HashIndex* index;                                     /* NULL unless Name##EnableIndex */     \
+} Name;                                                                                           \
+                                                                                                  \
+static inline Name##Node* Name##NewNode(bool leaf)                                                \
+{                                                                                                 \
+    Name##Node* node = (Name##Node*)arenaAllocate(sizeof(Name##Node));                            \
+    if (!node)                                                                                    \
+    {                                                                                             \
+        printf("Memory allocation failed for " #Name "Node\n");                                   \
+        exit(1);                                                                                  \
+    }                                                                                             \
+    node->n = 0;                                                                                  \
+    node->leaf = leaf;                                                                            \
+    node->next = NULL;                                                                            \
+    return node;                                                                                  \
+}                                                                                                 \
+                                                                                                  \
+static inline Name* Name##Create(void)                                                            \
+{                                                                                                 \
+    Name* tree = (Name*)malloc(sizeof(Name));                                                     \
+    if (!tree)                                                                                    \
+    {                                                                                             \
+        printf("Memory allocation failed for " #Name "\n");                                       \
+        exit(1);                                                                                  \
+    }                                                                                             \
+    tree->root = Name##NewNode(true);                                                             \
+    tree->count = 0;                                                                              \
+    tree->index = NULL;                                                                           \
+    return tree;                                                                                  \
+}                                                                                                 \
+                                                                                                  \
+/* Index of the first key >= key */                                                               \
+static inline int Name##LowerBound(const Name##Node* node, KeyType key)                          \
+{                                                                                                 \
+    int lo = 0, len = node->n;                                                                    \
+    while (len > 0)                                                                               \
+    {                                                                                             \
+        int half = len / 2;                                                                       \
+        if (node->keys[lo + half] < key)                                                          \
+        {                                                                                         \
+            lo += half + 1;                                                                       \
+            len -= half + 1;                                                                      \
+        }                                                                                         \
+        else                                                                                      \
+        {                                                                                         \
+            len = half;                                                                           \
+        }                                                                                         \
+    }                                                                                             \
+    return lo;                                                                                    \
+}                                                                                                 \
+                                                                                                  \
+/* Add the nodes below node (at 1-based depth) to stats */                                        \
+static inline void Name##CollectStats(Name##Node* node, int depth, TreeStats* stats)              \
+{                                                                                                 \
+    if (depth > stats->height) stats->height = depth;                                             \
+    stats->bytes += sizeof(Name##Node);                                                           \
+    if (node->leaf)                                                                               \
+    {                                                                                             \
+        stats->leaf_nodes++;                                                                      \
+        stats->leaf_keys += node->n;                                                              \
+        stats->leaf_slots += 2 * (T) - 1;                                                         \
+        return;                                                                                   \
+    }                                                                                             \
+    stats->internal_nodes++;                                                                      \
+    stats->internal_keys += node->n;                                                              \
+    stats->internal_slots += 2 * (T) - 1;                                                         \
+    for (int i = 0; i <= node->n; i++) Name##CollectStats(node->children[i], depth + 1, stats);  \
+}                                                                                                 \
+                                                                                                  \
+static inline Name##Node* Name##FirstLeaf(Name* tree)                                             \
+{                                                                                                 \
+    Name##Node* node = tree->root;                                                                \
+    while (!node->leaf) node = node->children[0];                                                 \
+    return node;                                                                                  \
+}                                                                                                 \
+                                                                                                  \
+/* Point the index at leaf for its keys from position start on */                                 \
+static inline void Name##IndexLeaf(Name* tree, Name##Node* leaf, int start)                       \
+{                                                                                                 \
+    for (int i = start; i < leaf->n; i++)                                                         \
+    {                                                                                             \
+        hashIndexPut(tree->index, (uint64_t)leaf->keys[i], leaf, (uint32_t)i);                    \
+    }                                                                                             \
+}                                                                                                 \
+                                                                                                  \
+/* Look up keys through a hash index from now on */                                               \
+static inline void Name##EnableIndex(Name* tree)                                                  \
+{                                                                                                 \
+    if (tree->index) return;                                                                      \
+    tree->index = createHashIndex((size_t)tree->count);                                           \
+    for (Name##Node* leaf = Name##FirstLeaf(tree); leaf != NULL; leaf = leaf->next)               \
+    {                                                                                             \
+        Name##IndexLeaf(tree, leaf, 0);                                                           \
+    }                                                                                             \
+}                                                                                                 \
+                                                                                                  \
+/* Find key in the leaf its index slot points to, trying the recorded position first */           \
+static inline ValueType* Name##IndexedValue(HashSlot* slot, KeyType key)                          \
+{                                                                                                 \
+    Name##Node* leaf = (Name##Node*)slot->record;                                                 \
+    int pos = (int)slot->position;                                                                \
+    if (pos >= leaf->n || !(leaf->keys[pos] == key)) pos = Name##LowerBound(leaf, key);           \
+    return &leaf->values[pos];                                                                    \
+}                                                                                                 \
+                                                                                                  \
+/* Find the value stored under key, or NULL */                                                    \
+static inline ValueType* Name##Search(Name* tree, KeyType key)                                    \
+{                                                                                                 \
+    if (tree->index)                                                                              \
+    {                                                                                             \
+        HashSlot* slot = hashIndexFind(tree->index, (uint64_t)key);                               \
+        return slot ? Name##IndexedValue(slot, key) : NULL;                                       \
+    }                                                                                             \
+    Name##Node* node = tree->root;                                                                \
+    while (!node->leaf) node = node->children[Name##LowerBound(node, key)];                       \
+    int i = Name##LowerBound(node, key);                                                          \
+    return (i < node->n && node->keys[i] == key) ? &node->values[i] : NULL;                       \
+}                                                                                                 \
+                                                                                                  \
+/* Insert value under key unless the key exists. Returns the stored value,                     */ \
+/* which is the existing one if *inserted is set to false.                                     */ \
+static inline ValueType* Name##Insert(Name* tree, KeyType key, ValueType value, bool* inserted)   \
+{                                                                                                 \
+    HashSlot* slot = tree->index ? hashIndexFind(tree->index, (uint64_t)key) : NULL;              \
+    if (slot)                                                                                     \
+    {                                                                                             \
+        ValueType* existing = Name##IndexedValue(slot, key);                                      \
+        slot->position = (uint32_t)(existing - ((Name##Node*)slot->record)->values);              \
+        if (inserted) *inserted = false;                                                          \
+        return existing;                                                                          \
+    }                                                                                             \
+                                                                                                  \
+    Name##Node* path[MAX_TREE_HEIGHT];                                                            \
+    int index[MAX_TREE_HEIGHT];                                                                   \
+    int depth = 0;                                                                                \
+                                                                                                  \
+    Name##Node* node = tree->root;                                                                \
+    while (!node->leaf)                                                                           \
+    {                                                                                             \
+        int i = Name##LowerBound(node, key);                                                      \
+        path[depth] = node;                                                                       \
+        index[depth] = i;                                                                         \
+        depth++;                                                                                  \
+        node = node->children[i];                                                                 \
+    }                                                                                             \
+                                                                                                  \
+    int pos = Name##LowerBound(node, key);                                                        \
+    if (pos < node->n && node->keys[pos] == key)                                                  \
+    {                                                                                             \
+        if (inserted) *inserted = false;                                                          \
+        return &node->values[pos];                                                                \
+    }                                                                                             \
+                                                                                                  \
+    memmove(&node->keys[pos + 1], &node->keys[pos], (node->n - pos) * sizeof(KeyType));           \
+    memmove(&node->values[pos + 1], &node->values[pos], (node->n - pos) * sizeof(ValueType));     \
+    node->keys[pos] = key;                                                                        \
+    node->values[pos] = value;                                                                    \
+    node->n++;                                                                                    \
+    tree->count++;                                                                                \
+    if (inserted) *inserted = true;                                                               \
+                                                                                                  \
+    /* Split overflowing nodes bottom-up, tracking where the new value ends up */                 \
+    Name##Node* holder = node;                                                                    \
+    int holderPos = pos;                                                                          \
+    while (node->n > 2 * (T) - 1)                                                                 \
+    {                                                                                             \
+        Name##Node* right = Name##NewNode(node->leaf);                                            \
+        KeyType separator;                                                                        \
+        if (node->leaf)                                                                           \
+        {                                                                                         \
+            int leftN = (node->n + 1) / 2;                                                        \
+            right->n = node->n - leftN;                                                           \
+            memcpy(right->keys, &node->keys[leftN], right->n * sizeof(KeyType));                  \
+            memcpy(right->values, &node->values[leftN], right->n * sizeof(ValueType));            \
+            node->n = leftN;                                                                      \
+            right->next = node->next;                                                             \
+            node->next = right;                                                                   \
+            separator = node->keys[leftN - 1];                                                    \
+            if (tree->index) Name##IndexLeaf(tree, right, 0);                                     \
+            if (holder == node && holderPos >= leftN)                                             \
+            {                                                                                     \
+                holder = right;                                                                   \
+                holderPos -= leftN;                                                               \
+            }                                                                                     \
+        }                                                                                         \
+        else                                                                                      \
+        {                                                                                         \
+            int leftN = node->n / 2;                                                              \
+            right->n = node->n - leftN - 1;                                                       \
+            memcpy(right->keys, &node->keys[leftN + 1], right->n * sizeof(KeyType));              \
+            memcpy(right->children, &node->children[leftN + 1], (right->n + 1) * sizeof(Name##Node*)); \
+            separator = node->keys[leftN];                                                        \
+            node->n = leftN;                                                                      \
+        }                                                                                         \
+                                                                                                  \
+        Name##Node* parent;                                                                       \
+        int i;                                                                                    \
+        if (depth == 0)                                                                           \
+        {                                                                                         \
+            parent = Name##NewNode(false);                                                        \
+            parent->children[0] = node;                                                           \
+            tree->root = parent;                                                                  \
+            i = 0;                                                                                \
+        }                                                                                         \
+        else                                                                                      \
+        {                                                                                         \
+            depth--;                                                                              \
+            parent = path[depth];                                                                 \
+            i = index[depth];                                                                     \
+        }                                                                                         \
+        memmove(&parent->children[i + 2], &parent->children[i + 1], (parent->n - i) * sizeof(Name##Node*)); \
+        memmove(&parent->keys[i + 1], &parent->keys[i], (parent->n - i) * sizeof(KeyType));      \
+        parent->keys[i] = separator;                                                              \
+        parent->children[i + 1] = right;                                                          \
+        parent->n++;                                                                              \
+        node = parent;                                                                            \
+    }                                                                                             \
+                                                                                                  \
+    if (tree->index) hashIndexPut(tree->index, (uint64_t)key, holder, holderPos);                 \
+    return &holder->values[holderPos];                                                            \
+}                                                                                                 \
+                                                                                                  \
+/* Remove key, rebalancing by borrowing from or merging with a sibling. */                        \
+/* Returns false if the key was not present.                           */                        \
+static inline bool Name##Remove(Name* tree, KeyType key)                                          \
+{                                                                                                 \
+    Name##Node* path[MAX_TREE_HEIGHT];                                                            \
+    int index[MAX_TREE_HEIGHT];                                                                   \
+    int depth = 0;                                                                                \
+                                                                                                  \
+    Name##Node* node = tree->root;                                                                \
+    while (1)                                                                                     \
+    {                                                                                             \
+        int i = Name##LowerBound(node, key);                                                      \
+        path[depth] = node;                                                                       \
+        index[depth] = i;                                                                         \
+        depth++;                                                                                  \
+        if (node->leaf) break;                                                                    \
+        node = node->children[i];                                                                 \
+    }                                                                                             \
+                                                                                                  \
+    int pos = index[depth - 1];                                                                   \
+    if (pos >= node->n || !(node->keys[pos] == key)) return false;                                \
+                                                                                                  \
+    memmove(&node->keys[pos], &node->keys[pos + 1], (node->n - pos - 1) * sizeof(KeyType));       \
+    memmove(&node->values[pos], &node->values[pos + 1], (node->n - pos - 1) * sizeof(ValueType)); \
+    node->n--;                                                                                    \
+    tree->count--;                                                                                \
+    if (tree->index) hashIndexRemove(tree->index, (uint64_t)key);                                 \
+                                                                                                  \
+    for (int level = depth - 1; level > 0 && path[level]->n < (T) - 1; level--)                   \
+    {                                                                                             \
+        node = path[level];                                                                       \
+        Name##Node* parent = path[level - 1];                                                     \
+        int idx = index[level - 1];                                                               \
+        Name##Node* left = idx > 0 ? parent->children[idx - 1] : NULL;                            \
+        Name##Node* right = idx < parent->n ? parent->children[idx + 1] : NULL;                   \
+                                                                                                  \
+        if (left && left->n > (T) - 1)                                                            \
+        {                                                                                         \
+            /* Borrow the last entry of the left sibling */                                       \
+            memmove(&node->keys[1], &node->keys[0], node->n * sizeof(KeyType));                  \
+            if (node->leaf)                                                                       \
+            {                                                                                     \
+                memmove(&node->values[1], &node->values[0], node->n * sizeof(ValueType));         \
+                node->keys[0] = left->keys[left->n - 1];                                          \
+                node->values[0] = left->values[left->n - 1];                                      \
+                if (tree->index) hashIndexPut(tree->index, (uint64_t)node->keys[0], node, 0);     \
+                left->n--;                                                                        \
+                parent->keys[idx - 1] = left->keys[left->n - 1];                                  \
+            }                                                                                     \
+            else                                                                                  \
+            {                                                                                     \
+                memmove(&node->children[1], &node->children[0], (node->n + 1) * sizeof(Name##Node*)); \
+                node->keys[0] = parent->keys[idx - 1];                                            \
+                node->children[0] = left->children[left->n];                                      \
+                parent->keys[idx - 1] = left->keys[left->n - 1];                                  \
+                left->n--;                                                                        \
+            }                                                                                     \
+            node->n++;                                                                            \
+            break;                                                                                \
+        }                                                                                         \
+                                                                                                  \
+        if (right && right->n > (T) - 1)                                                          \
+        {                                                                                         \
+            /* Borrow the first entry of the right sibling */                                     \
+            if (node->leaf)                                                                       \
+            {                                                                                     \
+                node->keys[node->n] = right->keys[0];                                             \
+                node->values[node->n] = right->values[0];                                         \
+                if (tree->index) hashIndexPut(tree->index, (uint64_t)node->keys[node->n], node, node->n);\
+                parent->keys[idx] = right->keys[0];                                               \
+                memmove(&right->values[0], &right->values[1], (right->n - 1) * sizeof(ValueType)); \
+            }                                                                                     \
+            else                                                                                  \
+            {                                                                                     \
+                node->keys[node->n] = parent->keys[idx];                                          \
+                node->children[node->n + 1] = right->children[0];                                 \
+                parent->keys[idx] = right->keys[0];                                               \
+                memmove(&right->children[0], &right->children[1], right->n * sizeof(Name##Node*)); \
+            }                                                                                     \
+            memmove(&right->keys[0], &right->keys[1], (right->n - 1) * sizeof(KeyType));          \
+            right->n--;                                                                           \
+            node->n++;                                                                            \
+            break;                                                                                \
+        }                                                                                         \
+                                                                                                  \
+        /* Merge with a sibling and drop the separator between them */                            \
+        int sep = left ? idx - 1 : idx;                                                           \
+        Name##Node* a = parent->children[sep];                                                    \
+        Name##Node* b = parent->children[sep + 1];                                                \
+        if (a->leaf)                                                                              \
+        {                                                                                         \
+            memcpy(&a->keys[a->n], b->keys, b->n * sizeof(KeyType));                              \
+            memcpy(&a->values[a->n], b->values, b->n * sizeof(ValueType));                        \
+            a->n += b->n;                                                                         \
+            a->next = b->next;                                                                    \
+            if (tree->index) Name##IndexLeaf(tree, a, a->n - b->n);                               \
+        }                                                                                         \
+        else                                                                                      \
+        {                                                                                         \
+            a->keys[a->n] = parent->keys[sep];                                                    \
+            memcpy(&a->keys[a->n + 1], b->keys, b->n * sizeof(KeyType));                          \
+            memcpy(&a->children[a->n + 1], b->children, (b->n + 1) * sizeof(Name##Node*));       \
+            a->n += b->n + 1;                                                                     \
+        }                                                                                         \
+        memmove(&parent->keys[sep], &parent->keys[sep + 1], (parent->n - sep - 1) * sizeof(KeyType)); \
+        memmove(&parent->children[sep + 1], &parent->children[sep + 2], (parent->n - sep - 1) * sizeof(Name##Node*)); \
+        parent->n--;                                                                              \
+        arenaRelease(b);                                                                          \
+    }                                                                                             \
+                                                                                                  \
+    if (!tree->root->leaf && tree->root->n == 0)                                                  \
+    {                                                                                             \
+        Name##Node* old = tree->root;                                                             \
+        tree->root = old->children[0];                                                            \
+        arenaRelease(old);                                                                        \
+    }                                                                                             \
+    return true;                                                                                  \
+}
+
+#define PAIR_TREE_DEGREE 16
+
+// Seller-buyer pairs keyed by the full (seller_id, buyer_id) pair, stored inline
+DEFINE_TYPED_BTREE(PairTree, uint64_t, SellerBuyerPair, PAIR_TREE_DEGREE)
+
+// Create a new transaction
+Transaction* createTransaction(int id, int buyer_id, int seller_id, double energy_kwh, double price_per_kwh,time_t timestamp) 
+{
+    Transaction* tx = (Transaction*)arenaAllocate(sizeof(Transaction));
+    if (!tx) 
+    {
+        printf("Memory allocation failed for Transaction\n");
+        exit(1);
+    }
+    
+    tx->transaction_id = id;
+    tx->buyer_id = buyer_id;
+    tx->seller_id = seller_id;
+    tx->energy_wh = toEnergyWh(energy_kwh);
+    tx->price_micro = toPriceMicro(price_per_kwh);
+    tx->time_offset = toTimeOffset(timestamp);
+    
+    return tx;
+}
+
+// Create a new seller, with no rates until learnSellerRate
+Seller* createSeller(int seller_id) 
+{
+    Seller* seller = (Seller*)malloc(sizeof(Seller));
+    if (!seller) 
+    {
+        printf("Memory allocation failed for Seller\n");
+        exit(1);
+    }
+    
+    seller->seller_id = seller_id;
+    seller->rate_below_300 = 0;
+    seller->rate_above_300 = 0;
+    seller->has_rate_below_300 = false;
+    seller->has_rate_above_300 = false;
+    seller->tariff = NULL;
+    seller->regular_buyers = NULL;
+    seller->total_revenue = 0;
+    initTransactionSet(&seller->transactions);
+    
+    return seller;
+}
+
+// Remember the price of a seller's first transaction in the energy's tier
+void learnSellerRate(Seller* seller, int64_t energy_wh, int32_t price_micro) 
+{
+    if (energy_wh < HIGH_VOLUME_WH && !seller->has_rate_below_300) 
+    {
+        seller->rate_below_300 = price_micro;
+        seller->has_rate_below_300 = true;
+    } 
+    else if (energy_wh >= HIGH_VOLUME_WH && !seller->has_rate_above_300) 
+    {
+        seller->rate_above_300 = price_micro;
+        seller->has_rate_above_300 = true;
+    }
+}
+
+// Create a new buyer
+Buyer* createBuyer(int buyer_id) 
+{
+    Buyer* buyer = (Buyer*)malloc(sizeof(Buyer));
+    if (!buyer) 
+    {
+        printf("Memory allocation failed for Buyer\n");
+        exit(1);
+    }
+    
+    buyer->buyer_id = buyer_id;
+    buyer->total_energy_purchased = 0;
+    initTransactionSet(&buyer->transactions);
+    
+    return buyer;
+}
+
+// Create a new regular buyer node for linked list
+RegularBuyerNode* createRegularBuyerNode(int buyer_id) 
+{
+    RegularBuyerNode* node = (RegularBuyerNode*)malloc(sizeof(RegularBuyerNode));
+    if (!node) 
+    {
+        printf("Memory allocation failed for RegularBuyerNode\n");
+        exit(1);
+    }
+    
+    node->buyer_id = buyer_id;
+    node->transaction_count = 1;  // Start with 1 transaction
+    node->next = NULL;
+    
+    return node;
+}
+
+// Create a new seller-buyer pair
+SellerBuyerPair createSellerBuyerPair(int seller_id, int buyer_id) 
+{
+    SellerBuyerPair pair;
+    pair.seller_id = seller_id;
+    pair.buyer_id = buyer_id;
+    pair.number_of_transactions = 1; // Start with 1 transaction
+    
+    return pair;
+}
+
+// Insert a transaction
+void insertTransaction(BTree* tree, Transaction* tx) 
+{
+    insert(tree, tx->transaction_id, tx);
+}
+
+// Insert a seller
+void insertSeller(BTree* tree, Seller* seller) 
+{
+    insert(tree, seller->seller_id, seller);
+}
+
+// Insert a buyer
+void insertBuyer(BTree* tree, Buyer* buyer) 
+{
+    insert(tree, buyer->buyer_id, buyer);
+}
+
+// Create a key for SellerBuyerPair (seller_id in the high half, buyer_id in the low half)
+uint64_t createPairKey(int seller_id, int buyer_id)
+{
+    return ((uint64_t)(uint32_t)seller_id << 32) | (uint32_t)buyer_id;
+}
+
+// Insert a seller-buyer pair, returning the stored copy
+SellerBuyerPair* insertSellerBuyerPair(PairTree* tree, SellerBuyerPair pair) 
+{
+    return PairTreeInsert(tree, createPairKey(pair.seller_id, pair.buyer_id), pair, NULL);
+}
+
+// Search for a transaction
+Transaction* searchTransaction(BTree* tree, int transaction_id) 
+{
+    return (Transaction*)lookup(tree, transaction_id);
+}
+
+// Search for a seller
+Seller* searchSeller(BTree* tree, int seller_id) 
+{
+    return (Seller*)lookup(tree, seller_id);
+}
+
+// Search for a buyer
+Buyer* searchBuyer(BTree* tree, int buyer_id) 
+{
+    return (Buyer*)lookup(tree, buyer_id);
+}
+
+// Search for a seller-buyer pair
+SellerBuyerPair* searchSellerBuyerPair(PairTree* tree, int seller_id, int buyer_id) 
+{
+    return PairTreeSearch(tree, createPairKey(seller_id, buyer_id));
+}
+
+// Put hash indexes in front of the seller, buyer and pair trees, unless built with -DLOOKUP_INDEX=0
+void enableLookupIndexes(BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+#if LOOKUP_INDEX
+    enableHashIndex(sellerTree);
+    enableHashIndex(buyerTree);
+    PairTreeEnableIndex(pairTree);
+#else
+    (void)sellerTree;
+    (void)buyerTree;
+    (void)pairTree;
+#endif
+}
+
+// Add or update a regular buyer in seller's list
+void addRegularBuyer(Seller* seller, int buyer_id) 
+{
+    // Check if buyer already exists in the list
+    RegularBuyerNode* current = seller->regular_buyers;
+    RegularBuyerNode* prev = NULL;
+    
+    while (current != NULL) 
+    {
+        if (current->buyer_id == buyer_id) 
+        {
+            // Buyer exists, increment transaction count
+            current->transaction_count++;
+            return;
+        }
+        prev = current;
+        current = current->next;
+    }
+    
+    // Buyer not found, create a new node
+    RegularBuyerNode* newNode = createRegularBuyerNode(buyer_id);
+    
+    // Add to the beginning of the list if it's empty or at the end if not
+    if (seller->regular_buyers == NULL) 
+    {
+        seller->regular_buyers = newNode;
+    } 
+    else 
+    {
+        prev->next = newNode;
+    }
+}
+
+// Clean up regular buyers list to only include those with more than 5 transactions
+void cleanupRegularBuyers(Seller* seller) 
+{
+    RegularBuyerNode* current = seller->regular_buyers;
+    RegularBuyerNode* prev = NULL;
+    RegularBuyerNode* next;
+    
+    while (current != NULL) 
+    {
+        next = current->next;
+        
+        if (current->transaction_count < 5) 
+        {
+            // Remove this node
+            if (prev == NULL) 
+            {
+                // This is the head node
+                seller->regular_buyers = next;
+            } 
+            else 
+            {
+                prev->next = next;
+            }
+            free(current);
+        } 
+        else 
+        {
+            prev = current;
+        }
+        
+        current = next;
+    }
+}
+
+// Update aggregates for a transaction, optionally adding it to the per-seller
+// and per-buyer subtrees (archived transactions only contribute aggregates)
+void accountTransaction(Transaction* tx, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree, bool indexSubtrees) 
+{
+    // Find or create seller, inserting a new one where the search ended
+    TreePath path;
+    Seller* seller = (Seller*)searchForInsert(sellerTree, tx->seller_id, &path);
+    if (!seller) 
+    {
+        seller = createSeller(tx->seller_id);
+        insertAtPath(sellerTree, &path, tx->seller_id, seller);
+    }
+
+    //Update seller's rates
+    learnSellerRate(seller, tx->energy_wh, tx->price_micro);
+    
+    // Update seller's revenue
+    seller->total_revenue += txTotalMicro(tx);
+    
+    // Add transaction to seller's transaction set
+    if (indexSubtrees) addToTransactionSet(&seller->transactions, tx);
+    
+    // Find or create buyer
+    Buyer* buyer = (Buyer*)searchForInsert(buyerTree, tx->buyer_id, &path);
+    if (!buyer) 
+    {
+        buyer = createBuyer(tx->buyer_id);
+        insertAtPath(buyerTree, &path, tx->buyer_id, buyer);
+    }
+    
+    // Update buyer's total energy purchased
+    buyer->total_energy_purchased += tx->energy_wh;
+    
+    // Add transaction to buyer's transaction set
+    if (indexSubtrees) addToTransactionSet(&buyer->transactions, tx);
+    
+    // Update regular buyers list
+    addRegularBuyer(seller, tx->buyer_id);
+    
+    // Clean up regular buyers list (only keep those with 5+ transactions)
+    cleanupRegularBuyers(seller);
+    
+    // Update or create seller-buyer pair in a single descent
+    bool created;
+    SellerBuyerPair* pair = PairTreeInsert(pairTree, createPairKey(tx->seller_id, tx->buyer_id),
+                                           createSellerBuyerPair(tx->seller_id, tx->buyer_id), &created);
+    if (!created) 
+    {
+        // Pair exists, increment transaction count
+        pair->number_of_transactions++;
+    }
+}
+
+// Process a transaction - update related data structures
+void processTransaction(Transaction* tx, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    METRIC_START(processStart);
+    accountTransaction(tx, sellerTree, buyerTree, pairTree, true);
+    METRIC_STOP(METRIC_PROCESS, processStart, 1);
+}
+
+// Remove one transaction of buyer_id from the seller's regular buyers list
+void removeRegularBuyer(Seller* seller, int buyer_id) 
+{
+    for (RegularBuyerNode* current = seller->regular_buyers; current != NULL; current = current->next) 
+    {
+        if (current->buyer_id == buyer_id) 
+        {
+            current->transaction_count--;
+            break;
+        }
+    }
+    
+    // Drop buyers that fell below the regular threshold
+    cleanupRegularBuyers(seller);
+}
+
+// Undo processTransaction - remove a transaction from related data structures
+void unprocessTransaction(Transaction* tx, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    Seller* seller = searchSeller(sellerTree, tx->seller_id);
+    if (seller) 
+    {
+        seller->total_revenue -= txTotalMicro(tx);
+        removeFromTransactionSet(&seller->transactions, tx->transaction_id);
+        removeRegularBuyer(seller, tx->buyer_id);
+    }
+    
+    Buyer* buyer = searchBuyer(buyerTree, tx->buyer_id);
+    if (buyer) 
+    {
+        buyer->total_energy_purchased -= tx->energy_wh;
+        removeFromTransactionSet(&buyer->transactions, tx->transaction_id);
+    }
+    
+    SellerBuyerPair* pair = searchSellerBuyerPair(pairTree, tx->seller_id, tx->buyer_id);
+    if (pair) 
+    {
+        pair->number_of_transactions--;
+        if (pair->number_of_transactions == 0) 
+        {
+            PairTreeRemove(pairTree, createPairKey(tx->seller_id, tx->buyer_id));
+        }
+    }
+}
+
+// Delete a transaction and undo its effect on sellers, buyers and pairs
+bool deleteTransaction(BTree* transactionTree, int transaction_id, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    Transaction* tx = (Transaction*)removeKey(transactionTree, transaction_id);
+    if (!tx) return false;
+    
+    unprocessTransaction(tx, sellerTree, buyerTree, pairTree);
+    releaseRecord(transactionTree, tx);
+    return true;
+}
+
+// Replace a stored transaction's fields, moving it between sellers, buyers and pairs as needed.
+// With snapshots enabled the stored record is replaced by a new one rather than changed, so
+// snapshots keep the old values. Returns the stored record.
+Transaction* rewriteTransaction(BTree* transactionTree, Transaction* tx, const Transaction* values, 
+                                BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    unprocessTransaction(tx, sellerTree, buyerTree, pairTree);
+    
+    if (transactionTree->cow) 
+    {
+        Transaction* copy = (Transaction*)arenaAllocate(sizeof(Transaction));
+        if (!copy) 
+        {
+            printf("Memory allocation failed for Transaction\n");
+            exit(1);
+        }
+        *copy = *tx;
+        replaceRecord(transactionTree, tx->transaction_id, copy);
+        releaseRecord(transactionTree, tx);
+        tx = copy;
+    }
+    
+    tx->buyer_id = values->buyer_id;
+    tx->seller_id = values->seller_id;
+    tx->energy_wh = values->energy_wh;
+    tx->price_micro = values->price_micro;
+    tx->time_offset = values->time_offset;
+    
+    processTransaction(tx, sellerTree, buyerTree, pairTree);
+    return tx;
+}
+
+// Update a transaction in place
+bool updateTransaction(BTree* transactionTree, int transaction_id, int buyer_id, int seller_id, 
+                       double energy_kwh, double price_per_kwh, time_t timestamp, 
+                       BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    Transaction* tx = searchTransaction(transactionTree, transaction_id);
+    if (!tx) return false;
+    
+    Transaction values = { transaction_id, buyer_id, seller_id, toEnergyWh(energy_kwh), 
+                           toPriceMicro(price_per_kwh), toTimeOffset(timestamp) };
+    rewriteTransaction(transactionTree, tx, &values, sellerTree, buyerTree, pairTree);
+    return true;
+}
+
+// IDs of the transactions in the archive of the open dataset, reset by openDataset and
+// filled by loadArchiveAggregates and archiveTransactionsBefore. An archived ID is never
+// accepted again: it would be counted twice in the aggregates (from the archive and live)
+// and archived twice.
+static HashIndex* archivedIds = NULL;
+static char archivedMarker;               // Record stored for every archived ID
+
+static void markArchived(int transaction_id) 
+{
+    if (!archivedIds) archivedIds = createHashIndex(0);
+    hashIndexPut(archivedIds, recordIndexKey(transaction_id), &archivedMarker, 0);
+}
+
+bool isArchivedTransaction(int transaction_id) 
+{
+    return archivedIds && hashIndexFind(archivedIds, recordIndexKey(transaction_id)) != NULL;
+}
+
+// Outcome of upsertTransaction
+typedef enum UpsertResult 
+{
+    UPSERT_INSERTED,              // New transaction ID, tx is now owned by the trees
+    UPSERT_UPDATED,               // Existing ID with different values, stored copy corrected, tx freed
+    UPSERT_UNCHANGED,             // Existing ID with identical values, nothing changed, tx freed
+    UPSERT_ARCHIVED               // ID already in the archive, nothing changed, tx freed
+} UpsertResult;
+
+// Insert a transaction, or correct the stored one if its ID already exists.
+// Replaying the same row is a no-op, so re-importing a file never doubles aggregates.
+UpsertResult upsertTransaction(BTree* transactionTree, Transaction* tx, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    if (isArchivedTransaction(tx->transaction_id)) 
+    {
+        arenaRelease(tx);
+        return UPSERT_ARCHIVED;
+    }
+    
+    Transaction* existing = (Transaction*)insertIfAbsent(transactionTree, tx->transaction_id, tx);
+    if (!existing) 
+    {
+        processTransaction(tx, sellerTree, buyerTree, pairTree);
+        return UPSERT_INSERTED;
+    }
+    
+    UpsertResult result = UPSERT_UNCHANGED;
+    if (existing->buyer_id != tx->buyer_id || existing->seller_id != tx->seller_id || 
+        existing->energy_wh != tx->energy_wh || existing->price_micro != tx->price_micro || 
+        existing->time_offset != tx->time_offset) 
+    {
+        rewriteTransaction(transactionTree, existing, tx, sellerTree, buyerTree, pairTree);
+        result = UPSERT_UPDATED;
+    }
+    
+    arenaRelease(tx);
+    return result;
+}
+
+#define ARCHIVE_SUFFIX ".archive"          // The archive of <file> is <file>.archive
+#define LEGACY_ARCHIVE_FILE "transactions.archive"   // Archive of transactions.txt before that
+
+#ifndef RETENTION_DAYS
+#define RETENTION_DAYS 0          // Archive transactions older than this many days at startup (0 = keep all)
+#endif
+
+// Archived transaction as stored on disk (24 bytes)
+typedef struct ArchiveRecord 
+{
+    int32_t transaction_id;
+    int32_t buyer_id;
+    int32_t seller_id;
+    int32_t energy_wh;
+    int32_t price_micro;
+    uint32_t time_offset;
+} ArchiveRecord;
+
+// Convert a transaction to its on-disk form
+void packTransaction(const Transaction* tx, ArchiveRecord* rec) 
+{
+    rec->transaction_id = tx->transaction_id;
+    rec->buyer_id = tx->buyer_id;
+    rec->seller_id = tx->seller_id;
+    rec->energy_wh = tx->energy_wh;
+    rec->price_micro = tx->price_micro;
+    rec->time_offset = tx->time_offset;
+}
+
+// Convert an on-disk record back to a transaction
+void unpackTransaction(const ArchiveRecord* rec, Transaction* tx) 
+{
+    tx->transaction_id = rec->transaction_id;
+    tx->buyer_id = rec->buyer_id;
+    tx->seller_id = rec->seller_id;
+    tx->energy_wh = rec->energy_wh;
+    tx->price_micro = rec->price_micro;
+    tx->time_offset = rec->time_offset;
+}
+
+// Header of an archive segment; each archival run appends one segment
+// whose records are sorted by timestamp
+typedef struct __attribute__((packed)) ArchiveSegmentHeader 
+{
+    char magic[4];                // "ETR2"
+    int32_t count;
+    int64_t min_timestamp;
+    int64_t max_timestamp;
+} ArchiveSegmentHeader;
+
+// Order transactions by timestamp, then ID
+int compareTransactionsByTime(const void* a, const void* b) 
+{
+    const Transaction* x = *(const Transaction* const*)a;
+    const Transaction* y = *(const Transaction* const*)b;
+    
+    if (x->time_offset != y->time_offset) return x->time_offset < y->time_offset ? -1 : 1;
+    return (x->transaction_id > y->transaction_id) - (x->transaction_id < y->transaction_id);
+}
+
+// Move transactions older than cutoff into a new segment of the archive file and remove them
+// from the transaction tree and the per-seller/per-buyer subtrees. Seller, buyer
+// and pair aggregates are left untouched. Returns the number archived, or -1 on error.
+int archiveTransactionsBefore(const char* archivePath, time_t cutoff, BTree* transactionTree, BTree* sellerTree, BTree* buyerTree) 
+{
+    // Collect the expired transactions from the leaf chain
+    int count = 0, capacity = 64;
+    Transaction** expired = (Transaction**)malloc(capacity * sizeof(Transaction*));
+    if (!expired) 
+    {
+        printf("Memory allocation failed.\n");
+        return -1;
+    }
+    
+    Node* current = transactionTree->root;
+    while (!current->leaf) current = current->children[0];
+    
+    for (; current != NULL; current = current->next) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            Transaction* tx = (Transaction*)current->records[i];
+            if (txTimestamp(tx) >= cutoff) continue;
+            
+            if (count >= capacity) 
+            {
+                capacity *= 2;
+                Transaction** grown = (Transaction**)realloc(expired, capacity * sizeof(Transaction*));
+                if (!grown) 
+                {
+                    printf("Memory reallocation failed.\n");
+                    free(expired);
+                    return -1;
+                }
+                expired = grown;
+            }
+            expired[count++] = tx;
+        }
+    }
+    
+    if (count == 0) 
+    {
+        free(expired);
+        return 0;
+    }
+    
+    qsort(expired, count, sizeof(Transaction*), compareTransactionsByTime);
+    
+    // Write the segment before touching the trees so a failed write loses nothing
+    FILE* file = fopen(archivePath, "ab");
+    if (!file) 
+    {
+        printf("Error opening file %s for writing\n", archivePath);
+        free(expired);
+        return -1;
+    }
+    
+    ArchiveSegmentHeader header;
+    memcpy(header.magic, "ETR2", 4);
+    header.count = count;
+    header.min_timestamp = txTimestamp(expired[0]);
+    header.max_timestamp = txTimestamp(expired[count - 1]);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    
+    for (int i = 0; i < count && ok; i++) 
+    {
+        ArchiveRecord rec;
+        packTransaction(expired[i], &rec);
+        ok = fwrite(&rec, sizeof(rec), 1, file) == 1;
+    }
+    
+    if (fclose(file) != 0 || !ok) 
+    {
+        printf("Error writing archive segment to %s\n", archivePath);
+        free(expired);
+        return -1;
+    }
+    
+    // Bulk-remove the archived transactions from all trees
+    for (int i = 0; i < count; i++) 
+    {
+        Transaction* tx = expired[i];
+        Seller* seller = searchSeller(sellerTree, tx->seller_id);
+        if (seller) removeFromTransactionSet(&seller->transactions, tx->transaction_id);
+        Buyer* buyer = searchBuyer(buyerTree, tx->buyer_id);
+        if (buyer) removeFromTransactionSet(&buyer->transactions, tx->transaction_id);
+        removeKey(transactionTree, tx->transaction_id);
+        markArchived(tx->transaction_id);
+        releaseRecord(transactionTree, tx);
+    }
+    
+    free(expired);
+    return count;
+}
+
+// Call visit for every transaction in the archive file (none if archivePath is NULL) with a
+// timestamp in [start_time, end_time]. Segments outside the range are skipped using their
+// headers. Returns the number visited.
+int forEachArchivedTransaction(const char* archivePath, time_t start_time, time_t end_time, 
+                               void (*visit)(Transaction* tx, void* ctx), void* ctx) 
+{
+    if (!archivePath) return 0;
+    FILE* file = fopen(archivePath, "rb");
+    if (!file) return 0;   // No archive yet
+    
+    int visited = 0;
+    ArchiveSegmentHeader header;
+    
+    while (fread(&header, sizeof(header), 1, file) == 1) 
+    {
+        if (memcmp(header.magic, "ETR2", 4) != 0 || header.count < 0) 
+        {
+            printf("Warning: corrupt segment in %s, ignoring the rest\n", archivePath);
+            break;
+        }
+        
+        long segmentEnd = ftell(file) + (long)header.count * (long)sizeof(ArchiveRecord);
+        if (header.max_timestamp >= start_time && header.min_timestamp <= end_time) 
+        {
+            ArchiveRecord rec;
+            for (int i = 0; i < header.count && fread(&rec, sizeof(rec), 1, file) == 1; i++) 
+            {
+                time_t timestamp = (time_t)TIMESTAMP_BASE + rec.time_offset;
+                if (timestamp > end_time) break;   // Records are sorted by time
+                if (timestamp < start_time) continue;
+                
+                Transaction tx;
+                unpackTransaction(&rec, &tx);
+                visit(&tx, ctx);
+                visited++;
+            }
+        }
+        if (fseek(file, segmentEnd, SEEK_SET) != 0) break;
+    }
+    
+    fclose(file);
+    return visited;
+}
+
+// Trees updated by accountArchivedTransaction
+typedef struct ArchiveAggregateContext 
+{
+    BTree* sellerTree;
+    BTree* buyerTree;
+    PairTree* pairTree;
+} ArchiveAggregateContext;
+
+// Visitor that adds an archived transaction to the aggregates only
+void accountArchivedTransaction(Transaction* tx, void* ctx) 
+{
+    ArchiveAggregateContext* trees = (ArchiveAggregateContext*)ctx;
+    markArchived(tx->transaction_id);
+    accountTransaction(tx, trees->sellerTree, trees->buyerTree, trees->pairTree, false);
+}
+
+// Restore seller/buyer/pair aggregates for archived transactions at startup,
+// and the set of archived IDs
+int loadArchiveAggregates(const char* archivePath, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    ArchiveAggregateContext ctx = { sellerTree, buyerTree, pairTree };
+    time_t earliest = (sizeof(time_t) == 8) ? (time_t)INT64_MIN : (time_t)INT32_MIN;
+    time_t latest = (sizeof(time_t) == 8) ? (time_t)INT64_MAX : (time_t)INT32_MAX;
+    return forEachArchivedTransaction(archivePath, earliest, latest, accountArchivedTransaction, &ctx);
+}
+
+/*
+ * Seller pricing
+ *
+ * A seller is priced either by the two rates learned from its first
+ * transactions below and above HIGH_VOLUME_WH, or by a tariff schedule from
+ * TARIFF_FILE: up to TARIFF_MAX_PERIODS time-of-day periods, each with up to
+ * TARIFF_MAX_TIERS energy tiers. A transaction pays the rate of the period its
+ * local time falls in and of the highest tier its energy reaches. Each line of
+ * the file sets one rate,
+ *
+ *   seller_id,HH:MM,min_kwh,price_per_kwh
+ *
+ * and a rate left out takes the next lower tier's in the same period. The
+ * last period of the day also covers the time before the first one starts.
+ *
+ * A PricingTable quotes prices for one seller tree through a direct-mapped
+ * cache of seller pointers, so a hot seller is priced without descending the
+ * seller tree. Sellers are never removed from the tree, so cached pointers
+ * stay valid; a slot is simply overwritten by the next seller hashing to it.
+ * A table is not thread-safe: each writer thread keeps its own.
+ */
+
+#define TARIFF_FILE "tariffs.txt"
+#define TARIFF_MAX_TIERS 4
+#define TARIFF_MAX_PERIODS 6
+#ifndef PRICING_CACHE_BITS
+#define PRICING_CACHE_BITS 10         // 1024 slots, 16 KB
+#endif
+#define PRICING_DAY_SLOTS 64          // Cached UTC offsets, by UTC day
+
+typedef struct Tariff 
+{
+    int numPeriods;
+    int numTiers;
+    int period_start[TARIFF_MAX_PERIODS];   // Minute of the local day, ascending
+    int64_t tier_start_wh[TARIFF_MAX_TIERS]; // Ascending, the first is 0
+    int32_t rates[TARIFF_MAX_PERIODS][TARIFF_MAX_TIERS]; // Micro-units per kWh
+} Tariff;
+
+typedef struct PricingSlot 
+{
+    int seller_id;
+    Seller* seller;               // NULL when the slot is empty
+} PricingSlot;
+
+typedef struct PricingTable 
+{
+    BTree* sellerTree;
+    long hits;
+    long misses;
+    PricingSlot slots[1 << PRICING_CACHE_BITS];
+    int64_t days[PRICING_DAY_SLOTS];      // UTC day of each cached offset; 0 (1970) never occurs
+    int32_t offsets[PRICING_DAY_SLOTS];   // Local time minus UTC in seconds, -1 if it changes that day
+} PricingTable;
+
+void initPricingTable(PricingTable* pricing, BTree* sellerTree) 
+{
+    memset(pricing, 0, sizeof(PricingTable));
+    pricing->sellerTree = sellerTree;
+}
+
+// Find a seller through the cache, descending the seller tree on a miss
+Seller* pricingSeller(PricingTable* pricing, int seller_id) 
+{
+    PricingSlot* slot = &pricing->slots[((uint32_t)seller_id * 2654435761u) >> (32 - PRICING_CACHE_BITS)];
+    if (slot->seller && slot->seller_id == seller_id) 
+    {
+        pricing->hits++;
+        return slot->seller;
+    }
+    
+    pricing->misses++;
+    Seller* seller = searchSeller(pricing->sellerTree, seller_id);
+    if (seller) 
+    {
+        slot->seller_id = seller_id;
+        slot->seller = seller;
+    }
+    return seller;
+}
+
+// How far local time is ahead of UTC at a timestamp, in seconds modulo a day
+static int32_t localOffset(time_t timestamp) 
+{
+    struct tm parts;
+    localtime_r(&timestamp, &parts);
+    int32_t local = parts.tm_hour * 3600 + parts.tm_min * 60 + parts.tm_sec;
+    int32_t utc = (int32_t)(timestamp % 86400);
+    return (local - utc + 86400) % 86400;
+}
+
+// Minute of the local day. The UTC offset is cached per UTC day, so localtime
+// only runs for a new day or on a day when daylight saving time changes.
+static int pricingMinute(PricingTable* pricing, time_t timestamp) 
+{
+    int64_t day = (int64_t)timestamp / 86400;
+    int slot = (int)(day & (PRICING_DAY_SLOTS - 1));
+    if (pricing->days[slot] != day) 
+    {
+        int32_t first = localOffset((time_t)(day * 86400));
+        int32_t last = localOffset((time_t)(day * 86400 + 86399));
+        pricing->days[slot] = day;
+        pricing->offsets[slot] = first == last ? first : -1;
+    }
+    
+    int32_t offset = pricing->offsets[slot];
+    if (offset < 0) offset = localOffset(timestamp);
+    return (int)((timestamp % 86400 + offset) % 86400 / 60);
+}
+
+// Rate of a schedule for an energy amount at a minute of the day
+int32_t tariffRate(const Tariff* tariff, int64_t energy_wh, int minute) 
+{
+    int period = tariff->numPeriods - 1;
+    for (int p = 0; p < tariff->numPeriods && tariff->period_start[p] <= minute; p++) period = p;
+    int tier = 0;
+    while (tier + 1 < tariff->numTiers && tariff->tier_start_wh[tier + 1] <= energy_wh) tier++;
+    return tariff->rates[period][tier];
+}
+
+// Price per kWh for a seller, energy and time; returns false if the seller has
+// no schedule and no learned rate for the energy's tier
+bool quotePrice(PricingTable* pricing, int seller_id, int64_t energy_wh, time_t timestamp, int32_t* price_micro) 
+{
+    Seller* seller = pricingSeller(pricing, seller_id);
+    if (!seller) return false;
+    
+    if (seller->tariff) 
+    {
+        *price_micro = tariffRate(seller->tariff, energy_wh, pricingMinute(pricing, timestamp));
+        return true;
+    }
+    if (energy_wh < HIGH_VOLUME_WH) 
+    {
+        *price_micro = seller->rate_below_300;
+        return seller->has_rate_below_300;
+    }
+    *price_micro = seller->rate_above_300;
+    return seller->has_rate_above_300;
+}
+
+// True if a rate for (minute, energy_wh) can be stored: its period and tier
+// exist or there is room to add them. Checked before either is added, so a
+// rejected line leaves no period or tier without rates behind.
+static bool tariffHasRoom(const Tariff* tariff, int minute, int64_t energy_wh) 
+{
+    bool periodFound = false, tierFound = false;
+    for (int p = 0; p < tariff->numPeriods; p++) periodFound |= tariff->period_start[p] == minute;
+    for (int t = 0; t < tariff->numTiers; t++) tierFound |= tariff->tier_start_wh[t] == energy_wh;
+    return (periodFound || tariff->numPeriods < TARIFF_MAX_PERIODS) && 
+           (tierFound || tariff->numTiers < TARIFF_MAX_TIERS);
+}
+
+// Index of the period starting at minute, added if new; -1 if the schedule is full
+static int tariffPeriod(Tariff* tariff, int minute) 
+{
+    int p = 0;
+    while (p < tariff->numPeriods && tariff->period_start[p] < minute) p++;
+    if (p < tariff->numPeriods && tariff->period_start[p] == minute) return p;
+    if (tariff->numPeriods == TARIFF_MAX_PERIODS) return -1;
+    
+    memmove(&tariff->period_start[p + 1], &tariff->period_start[p], (tariff->numPeriods - p) * sizeof(int));
+    memmove(&tariff->rates[p + 1], &tariff->rates[p], (tariff->numPeriods - p) * sizeof(tariff->rates[0]));
+    tariff->period_start[p] = minute;
+    for (int t = 0; t < TARIFF_MAX_TIERS; t++) tariff->rates[p][t] = -1;
+    tariff->numPeriods++;
+    return p;
+}
+
+// Index of the tier starting at energy_wh, added if new; -1 if the schedule is full
+static int tariffTier(Tariff* tariff, int64_t energy_wh) 
+{
+    int t = 0;
+    while (t < tariff->numTiers && tariff->tier_start_wh[t] < energy_wh) t++;
+    if (t < tariff->numTiers && tariff->tier_start_wh[t] == energy_wh) return t;
+    if (tariff->numTiers == TARIFF_MAX_TIERS) return -1;
+    
+    memmove(&tariff->tier_start_wh[t + 1], &tariff->tier_start_wh[t], (tariff->numTiers - t) * sizeof(int64_t));
+    for (int p = 0; p < TARIFF_MAX_PERIODS; p++) 
+    {
+        memmove(&tariff->rates[p][t + 1], &tariff->rates[p][t], (tariff->numTiers - t) * sizeof(int32_t));
+        tariff->rates[p][t] = -1;
+    }
+    tariff->tier_start_wh[t] = energy_wh;
+    tariff->numTiers++;
+    return t;
+}
+
+// Fill rates left out with the next lower tier's; false if a period has no 0 kWh rate
+static bool completeTariff(Tariff* tariff) 
+{
+    if (tariff->tier_start_wh[0] != 0) return false;
+    for (int p = 0; p < tariff->numPeriods; p++) 
+    {
+        if (tariff->rates[p][0] < 0) return false;
+        for (int t = 1; t < tariff->numTiers; t++) 
+        {
+            if (tariff->rates[p][t] < 0) tariff->rates[p][t] = tariff->rates[p][t - 1];
+        }
+    }
+    return true;
+}
+
+// Attach the schedules in a tariff file to their sellers, creating sellers
+// that have none yet. A missing file is not an error. Returns the number of
+// sellers with a schedule.
+int loadTariffs(const char* path, BTree* sellerTree) 
+{
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        int seller_id, hours, minutes;
+        double min_kwh, price_per_kwh;
+        if (line[0] < '0' || line[0] > '9') continue;      // Header or comment
+        if (sscanf(line, "%d,%d:%d,%lf,%lf", &seller_id, &hours, &minutes, &min_kwh, &price_per_kwh) != 5 || 
+            hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || min_kwh < 0 || price_per_kwh <= 0) 
+        {
+            printf("Warning: Skipping invalid tariff line: %s", line);
+            continue;
+        }
+        
+        TreePath path;
+        Seller* seller = (Seller*)searchForInsert(sellerTree, seller_id, &path);
+        if (!seller) 
+        {
+            seller = createSeller(seller_id);
+            insertAtPath(sellerTree, &path, seller_id, seller);
+        }
+        if (!seller->tariff) 
+        {
+            seller->tariff = (Tariff*)calloc(1, sizeof(Tariff));
+            if (!seller->tariff) 
+            {
+                printf("Memory allocation failed for Tariff\n");
+                exit(1);
+            }
+        }
+        
+        if (!tariffHasRoom(seller->tariff, hours * 60 + minutes, toEnergyWh(min_kwh))) 
+        {
+            printf("Warning: Tariff of seller %d has more than %d periods or %d tiers, skipping: %s", 
+                   seller_id, TARIFF_MAX_PERIODS, TARIFF_MAX_TIERS, line);
+            continue;
+        }
+        int period = tariffPeriod(seller->tariff, hours * 60 + minutes);
+        int tier = tariffTier(seller->tariff, toEnergyWh(min_kwh));
+        seller->tariff->rates[period][tier] = toPriceMicro(price_per_kwh);
+    }
+    fclose(file);
+    
+    // Validate the schedules now that all their rates are known
+    Node* leaf = sellerTree->root;
+    while (!leaf->leaf) leaf = leaf->children[0];
+    int count = 0;
+    for (; leaf != NULL; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) 
+        {
+            Seller* seller = (Seller*)leaf->records[i];
+            if (!seller->tariff) continue;
+            if (completeTariff(seller->tariff)) 
+            {
+                count++;
+                continue;
+            }
+            printf("Warning: Tariff of seller %d has no 0 kWh rate in some period, ignoring it\n", seller->seller_id);
+            free(seller->tariff);
+            seller->tariff = NULL;
+        }
+    }
+    if (count > 0) printf("Loaded tariffs for %d sellers from %s\n", count, path);
+    return count;
+}
+
+/*
+ * Parallel range scans
+ *
+ * Full scans of the transaction tree (seller revenue, energy range) split the
+ * leaf chain into key-range partitions at internal-node boundaries: the tree
+ * is expanded level by level from the root until there are enough subtrees,
+ * and partition i runs from the leftmost leaf of subtree i up to the leftmost
+ * leaf of subtree i + 1. The calling thread and the workers of a scan pool
+ * claim partitions one at a time, each scanning into its own partial result,
+ * and the caller merges the partials in key order. Several threads may run
+ * scans on the same pool at once; as with the sequential scans, the tree must
+ * not be modified while a scan runs.
+ */
+
+#define SCAN_MAX_THREADS 16
+#define SCAN_PARTITIONS_PER_THREAD 4  // Extra partitions even out subtrees of different fill
+#define SCAN_MAX_PARTITIONS 1024
+
+#ifndef SCAN_THREADS
+#define SCAN_THREADS 0                // 0 = one per online CPU, up to SCAN_MAX_THREADS
+#endif
+
+// Runs one task of a job, numbered from 0
+typedef void (*PoolTaskFn)(int task, void* ctx);
+
+// Scans one partition: the leaves from first up to, not including, end
+typedef void (*ScanRangeFn)(Node* first, Node* end, int partition, void* ctx);
+
+typedef struct ScanJob 
+{
+    int numTasks;
+    PoolTaskFn run;
+    void* ctx;
+    int claimed;                  // Tasks handed out so far
+    int finished;                 // Tasks completed so far
+    struct ScanJob* next;
+} ScanJob;
+
+typedef struct ScanPool 
+{
+    pthread_mutex_t lock;
+    pthread_cond_t workReady;
+    pthread_cond_t jobDone;
+    ScanJob* jobs;                // Jobs with unclaimed tasks, oldest first
+    bool stopping;
+    int numWorkers;               // The calling thread makes one more
+    pthread_t workers[SCAN_MAX_THREADS];
+} ScanPool;
+
+// Hand out the next task of a job; called with the pool lock held
+static int claimTask(ScanPool* pool, ScanJob* job) 
+{
+    int task = job->claimed++;
+    if (job->claimed == job->numTasks) 
+    {
+        ScanJob** link = &pool->jobs;
+        while (*link != job) link = &(*link)->next;
+        *link = job->next;
+    }
+    return task;
+}
+
+// Run a claimed task with the pool lock released; called and returns with it held
+static void runTask(ScanPool* pool, ScanJob* job, int task) 
+{
+    pthread_mutex_unlock(&pool->lock);
+    job->run(task, job->ctx);
+    pthread_mutex_lock(&pool->lock);
+    if (++job->finished == job->numTasks) pthread_cond_broadcast(&pool->jobDone);
+}
+
+static void* scanWorker(void* arg) 
+{
+    ScanPool* pool = (ScanPool*)arg;
+    pthread_mutex_lock(&pool->lock);
+    while (1) 
+    {
+        while (!pool->jobs && !pool->stopping) pthread_cond_wait(&pool->workReady, &pool->lock);
+        if (!pool->jobs) break;
+        ScanJob* job = pool->jobs;
+        runTask(pool, job, claimTask(pool, job));
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// Create a pool that runs tasks on the given number of threads, including the caller
+ScanPool* createScanPool(int threads) 
+{
+    ScanPool* pool = (ScanPool*)malloc(sizeof(ScanPool));
+    if (!pool) 
+    {
+        printf("Memory allocation failed for ScanPool\n");
+        exit(1);
+    }
+    
+    if (threads < 1) threads = 1;
+    if (threads > SCAN_MAX_THREADS) threads = SCAN_MAX_THREADS;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->workReady, NULL);
+    pthread_cond_init(&pool->jobDone, NULL);
+    pool->jobs = NULL;
+    pool->stopping = false;
+    pool->numWorkers = 0;
+    
+    // Workers start with SIGINT/SIGTERM blocked so signals reach the threads that handle them
+    sigset_t stopSignals, previousMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+    for (int i = 0; i < threads - 1; i++) 
+    {
+        if (pthread_create(&pool->workers[pool->numWorkers], NULL, scanWorker, pool) != 0) break;
+        pool->numWorkers++;
+    }
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+    
+    return pool;
+}
+
+void destroyScanPool(ScanPool* pool) 
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->numWorkers; i++) pthread_join(pool->workers[i], NULL);
+    
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->workReady);
+    pthread_cond_destroy(&pool->jobDone);
+    free(pool);
+}
+
+static ScanPool* sharedPool = NULL;
+static pthread_once_t sharedPoolOnce = PTHREAD_ONCE_INIT;
+
+static void createSharedScanPool(void) 
+{
+    long threads = SCAN_THREADS;
+    if (threads <= 0) threads = sysconf(_SC_NPROCESSORS_ONLN);
+    sharedPool = createScanPool(threads > 0 ? (int)threads : 1);
+}
+
+// The pool used by the reports, created on first use
+ScanPool* sharedScanPool(void) 
+{
+    pthread_once(&sharedPoolOnce, createSharedScanPool);
+    return sharedPool;
+}
+
+// Threads a pool runs tasks on, including the caller
+static inline int poolThreads(const ScanPool* pool) 
+{
+    return pool->numWorkers + 1;
+}
+
+// Run tasks 0..numTasks-1 on the pool and wait for all of them
+void runPoolTasks(ScanPool* pool, int numTasks, PoolTaskFn run, void* ctx) 
+{
+    if (pool->numWorkers == 0 || numTasks <= 1) 
+    {
+        for (int i = 0; i < numTasks; i++) run(i, ctx);
+        return;
+    }
+    
+    ScanJob job = { numTasks, run, ctx, 0, 0, NULL };
+    pthread_mutex_lock(&pool->lock);
+    ScanJob** link = &pool->jobs;
+    while (*link) link = &(*link)->next;
+    *link = &job;
+    pthread_cond_broadcast(&pool->workReady);
+    
+    // The caller runs its own job too, so a busy pool never stalls it
+    while (job.claimed < job.numTasks) runTask(pool, &job, claimTask(pool, &job));
+    while (job.finished < job.numTasks) pthread_cond_wait(&pool->jobDone, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Split the leaf chain into at most SCAN_MAX_PARTITIONS key-range partitions,
+// aiming for at least target. starts must hold SCAN_MAX_PARTITIONS + 1 entries.
+int partitionLeaves(BTree* tree, int target, Node** starts) 
+{
+    Node* level[SCAN_MAX_PARTITIONS];
+    int count = 1;
+    level[0] = tree->root;
+    
+    // All leaves are at the same depth, so one leaf means the whole level is leaves
+    while (count < target && !level[0]->leaf) 
+    {
+        int children = 0;
+        for (int i = 0; i < count; i++) children += level[i]->n + 1;
+        if (children > SCAN_MAX_PARTITIONS) break;
+        
+        // Expand in place from the right so unread parents are never overwritten
+        int k = children;
+        for (int i = count - 1; i >= 0; i--) 
+        {
+            Node* parent = level[i];
+            for (int c = parent->n; c >= 0; c--) level[--k] = parent->children[c];
+        }
+        count = children;
+    }
+    
+    for (int i = 0; i < count; i++) 
+    {
+        Node* node = level[i];
+        while (!node->leaf) node = node->children[0];
+        starts[i] = node;
+    }
+    starts[count] = NULL;
+    return count;
+}
+
+// Number of partitions worth splitting a tree into for a pool
+int scanPartitionTarget(const ScanPool* pool) 
+{
+    return pool->numWorkers == 0 ? 1 : poolThreads(pool) * SCAN_PARTITIONS_PER_THREAD;
+}
+
+typedef struct PartitionScan 
+{
+    Node** starts;
+    ScanRangeFn scan;
+    void* ctx;
+} PartitionScan;
+
+static void scanPartitionTask(int partition, void* ctx) 
+{
+    PartitionScan* job = (PartitionScan*)ctx;
+    job->scan(job->starts[partition], job->starts[partition + 1], partition, job->ctx);
+}
+
+// Scan every partition from partitionLeaves on the pool and wait for all of them
+void parallelScan(ScanPool* pool, Node** starts, int numPartitions, ScanRangeFn scan, void* ctx) 
+{
+    PartitionScan job = { starts, scan, ctx };
+    runPoolTasks(pool, numPartitions, scanPartitionTask, &job);
+}
+
+/*
+ * Sorting
+ *
+ * Report orderings without an index of their own (buyers by energy, pairs by
+ * transaction count, transactions by energy) sort SortEntry arrays: the
+ * numeric sort key, mapped to an unsigned integer, next to the record it
+ * orders. The sort is stable, so records collected in ID order stay in ID
+ * order among equal keys. Small inputs use insertion sort; larger ones an
+ * LSD radix sort on bytes, skipping bytes that are the same in every key.
+ * With more than one pool thread a large input is cut into one chunk per
+ * thread, the chunks are radix sorted in parallel, and sorted runs are merged
+ * pairwise, each merge split into equal output segments (merge path) so the
+ * last rounds still use every thread.
+ */
+
+#define SORT_INSERTION_MAX 32         // Up to this many entries insertion sort is fastest
+#define SORT_PARALLEL_MIN 65536       // Minimum entries per chunk worth its own thread
+
+typedef struct SortEntry 
+{
+    uint64_t key;
+    void* item;
+} SortEntry;
+
+// Sort key for a signed value: flipping the sign bit orders negatives first
+static inline uint64_t signedSortKey(int64_t value) 
+{
+    return (uint64_t)value ^ (UINT64_C(1) << 63);
+}
+
+static void insertionSortEntries(SortEntry* entries, size_t count) 
+{
+    for (size_t i = 1; i < count; i++) 
+    {
+        SortEntry entry = entries[i];
+        size_t j = i;
+        while (j > 0 && entries[j - 1].key > entry.key) 
+        {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = entry;
+    }
+}
+
+// Stable LSD radix sort, using scratch (count entries) as the second buffer
+static void radixSortEntries(SortEntry* entries, SortEntry* scratch, size_t count) 
+{
+    if (count <= SORT_INSERTION_MAX) 
+    {
+        insertionSortEntries(entries, count);
+        return;
+    }
+    
+    // Bytes where all keys agree need no pass
+    uint64_t anyBits = 0, allBits = ~UINT64_C(0);
+    for (size_t i = 0; i < count; i++) 
+    {
+        anyBits |= entries[i].key;
+        allBits &= entries[i].key;
+    }
+    uint64_t varying = anyBits ^ allBits;
+    
+    SortEntry* src = entries;
+    SortEntry* dst = scratch;
+    for (int shift = 0; shift < 64; shift += 8) 
+    {
+        if (((varying >> shift) & 0xFF) == 0) continue;
+        
+        size_t offsets[256] = { 0 };
+        for (size_t i = 0; i < count; i++) offsets[(src[i].key >> shift) & 0xFF]++;
+        size_t total = 0;
+        for (int b = 0; b < 256; b++) 
+        {
+            size_t n = offsets[b];
+            offsets[b] = total;
+            total += n;
+        }
+        for (size_t i = 0; i < count; i++) dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+        
+        SortEntry* swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != entries) memcpy(entries, src, count * sizeof(SortEntry));
+}
+
+// Entries of a's first `rank` merged outputs taken from a; ties go to a
+static size_t mergeCoRank(size_t rank, const SortEntry* a, size_t lengthA, const SortEntry* b, size_t lengthB) 
+{
+    size_t lo = rank > lengthB ? rank - lengthB : 0;
+    size_t hi = rank < lengthA ? rank : lengthA;
+    while (lo < hi) 
+    {
+        size_t i = lo + (hi - lo) / 2;
+        if (a[i].key <= b[rank - i - 1].key) lo = i + 1;
+        else hi = i;
+    }
+    return lo;
+}
+
+typedef struct ParallelSort 
+{
+    SortEntry* src;
+    SortEntry* dst;
+    size_t count;
+    size_t chunk;                 // Entries per chunk; the last may be shorter
+    size_t width;                 // Length of the runs being merged this round
+    int segments;                 // Output segments per merge
+} ParallelSort;
+
+static void sortChunkTask(int task, void* ctx) 
+{
+    ParallelSort* sort = (ParallelSort*)ctx;
+    size_t lo = (size_t)task * sort->chunk;
+    size_t hi = lo + sort->chunk < sort->count ? lo + sort->chunk : sort->count;
+    radixSortEntries(sort->src + lo, sort->dst + lo, hi - lo);
+}
+
+// Merge one output segment of one pair of runs from src into dst
+static void mergeSegmentTask(int task, void* ctx) 
+{
+    ParallelSort* sort = (ParallelSort*)ctx;
+    size_t lo = (size_t)(task / sort->segments) * 2 * sort->width;
+    size_t mid = lo + sort->width < sort->count ? lo + sort->width : sort->count;
+    size_t hi = mid + sort->width < sort->count ? mid + sort->width : sort->count;
+    const SortEntry* a = sort->src + lo;
+    const SortEntry* b = sort->src + mid;
+    size_t lengthA = mid - lo, lengthB = hi - mid;
+    
+    int segment = task % sort->segments;
+    size_t first = (hi - lo) * segment / sort->segments;
+    size_t last = (hi - lo) * (segment + 1) / sort->segments;
+    size_t i = mergeCoRank(first, a, lengthA, b, lengthB);
+    size_t j = first - i;
+    size_t endI = mergeCoRank(last, a, lengthA, b, lengthB);
+    size_t endJ = last - endI;
+    
+    SortEntry* out = sort->dst + lo + first;
+    while (i < endI && j < endJ) *out++ = a[i].key <= b[j].key ? a[i++] : b[j++];
+    while (i < endI) *out++ = a[i++];
+    while (j < endJ) *out++ = b[j++];
+}
+
+// Stable sort by key. pool may be NULL to sort on the calling thread only.
+// Returns false if the scratch buffer could not be allocated.
+bool sortEntries(SortEntry* entries, size_t count, ScanPool* pool) 
+{
+    if (count <= SORT_INSERTION_MAX) 
+    {
+        insertionSortEntries(entries, count);
+        return true;
+    }
+    
+    SortEntry* scratch = (SortEntry*)malloc(count * sizeof(SortEntry));
+    if (!scratch) return false;
+    
+    size_t chunks = pool ? (size_t)poolThreads(pool) : 1;
+    if (chunks > count / SORT_PARALLEL_MIN) chunks = count / SORT_PARALLEL_MIN;
+    if (chunks <= 1) 
+    {
+        radixSortEntries(entries, scratch, count);
+        free(scratch);
+        return true;
+    }
+    
+    ParallelSort sort = { entries, scratch, count, (count + chunks - 1) / chunks, 0, 1 };
+    runPoolTasks(pool, (int)chunks, sortChunkTask, &sort);
+    
+    // Merge rounds double the run length until one run is left
+    for (sort.width = sort.chunk; sort.width < count; sort.width *= 2) 
+    {
+        int pairs = (int)((count + 2 * sort.width - 1) / (2 * sort.width));
+        sort.segments = poolThreads(pool) / pairs > 1 ? poolThreads(pool) / pairs : 1;
+        runPoolTasks(pool, pairs * sort.segments, mergeSegmentTask, &sort);
+        SortEntry* swap = sort.src;
+        sort.src = sort.dst;
+        sort.dst = swap;
+    }
+    if (sort.src != entries) memcpy(entries, sort.src, count * sizeof(SortEntry));
+    
+    free(scratch);
+    return true;
+}
+
+// Per-partition totals of one seller's transactions
+typedef struct SellerScanPartial 
+{
+    int64_t revenue;
+    int64_t energy;
+    int count;
+    long scanned;
+} SellerScanPartial;
+
+typedef struct SellerScan 
+{
+    int seller_id;
+    SellerScanPartial* partials;
+} SellerScan;
+
+static void scanSellerRange(Node* first, Node* end, int partition, void* ctx) 
+{
+    SellerScan* scan = (SellerScan*)ctx;
+    SellerScanPartial totals = { 0, 0, 0, 0 };
+    for (Node* leaf = first; leaf != end; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) 
+        {
+            Transaction* tx = (Transaction*)leaf->records[i];
+            if (tx->seller_id == scan->seller_id) 
+            {
+                totals.revenue += txTotalMicro(tx);
+                totals.energy += tx->energy_wh;
+                totals.count++;
+            }
+        }
+        totals.scanned += leaf->n;
+    }
+    // One store per partition, so neighbouring partials don't share cache lines while scanning
+    scan->partials[partition] = totals;
+}
+
+// Sum one seller's transactions across the whole transaction tree
+SellerScanPartial sumSellerTransactions(ScanPool* pool, BTree* tree, int seller_id) 
+{
+    Node* starts[SCAN_MAX_PARTITIONS + 1];
+    SellerScanPartial partials[SCAN_MAX_PARTITIONS];
+    int numPartitions = partitionLeaves(tree, scanPartitionTarget(pool), starts);
+    SellerScan scan = { seller_id, partials };
+    parallelScan(pool, starts, numPartitions, scanSellerRange, &scan);
+    
+    SellerScanPartial totals = { 0, 0, 0, 0 };
+    for (int i = 0; i < numPartitions; i++) 
+    {
+        totals.revenue += partials[i].revenue;
+        totals.energy += partials[i].energy;
+        totals.count += partials[i].count;
+        totals.scanned += partials[i].scanned;
+    }
+    return totals;
+}
+
+// Per-partition matches of an energy range, in ID order
+typedef struct EnergyScanPartial 
+{
+    SortEntry* entries;
+    int count;
+    int capacity;
+    bool failed;                  // Ran out of memory
+    long scanned;
+} EnergyScanPartial;
+
+typedef struct EnergyScan 
+{
+    int32_t min_wh;
+    int32_t max_wh;
+    EnergyScanPartial* partials;
+} EnergyScan;
+
+static void scanEnergyRange(Node* first, Node* end, int partition, void* ctx) 
+{
+    EnergyScan* scan = (EnergyScan*)ctx;
+    EnergyScanPartial run = { NULL, 0, 0, false, 0 };
+    for (Node* leaf = first; leaf != end && !run.failed; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) 
+        {
+            Transaction* tx = (Transaction*)leaf->records[i];
+            if (tx->energy_wh < scan->min_wh || tx->energy_wh > scan->max_wh) continue;
+            if (run.count == run.capacity) 
+            {
+                run.capacity = run.capacity ? run.capacity * 2 : 64;
+                SortEntry* entries = (SortEntry*)realloc(run.entries, run.capacity * sizeof(SortEntry));
+                if (!entries) 
+                {
+                    run.failed = true;
+                    break;
+                }
+                run.entries = entries;
+            }
+            run.entries[run.count].key = signedSortKey(tx->energy_wh);
+            run.entries[run.count++].item = tx;
+        }
+        run.scanned += leaf->n;
+    }
+    scan->partials[partition] = run;
+}
+
+// Collect the transactions with energy in [min_wh, max_wh] sorted by energy,
+// then ID. Returns NULL if memory runs out; the caller frees the array.
+Transaction** collectTransactionsByEnergy(ScanPool* pool, BTree* tree, int32_t min_wh, int32_t max_wh, int* count, long* scanned) 
+{
+    Node* starts[SCAN_MAX_PARTITIONS + 1];
+    int numPartitions = partitionLeaves(tree, scanPartitionTarget(pool), starts);
+    EnergyScanPartial* runs = (EnergyScanPartial*)malloc(numPartitions * sizeof(EnergyScanPartial));
+    if (!runs) return NULL;
+    EnergyScan scan = { min_wh, max_wh, runs };
+    parallelScan(pool, starts, numPartitions, scanEnergyRange, &scan);
+    
+    bool failed = false;
+    int total = 0;
+    *scanned = 0;
+    for (int i = 0; i < numPartitions; i++) 
+    {
+        failed |= runs[i].failed;
+        total += runs[i].count;
+        *scanned += runs[i].scanned;
+    }
+    
+    // Partitions are in key order, so the concatenation is in ID order
+    SortEntry* entries = failed ? NULL : (SortEntry*)malloc((total > 0 ? total : 1) * sizeof(SortEntry));
+    if (entries) 
+    {
+        int k = 0;
+        for (int i = 0; i < numPartitions; i++) 
+        {
+            if (runs[i].count > 0) memcpy(&entries[k], runs[i].entries, runs[i].count * sizeof(SortEntry));
+            k += runs[i].count;
+        }
+    }
+    for (int i = 0; i < numPartitions; i++) free(runs[i].entries);
+    free(runs);
+    
+    Transaction** transactions = entries ? (Transaction**)malloc((total > 0 ? total : 1) * sizeof(Transaction*)) : NULL;
+    if (transactions && sortEntries(entries, total, pool)) 
+    {
+        for (int i = 0; i < total; i++) transactions[i] = (Transaction*)entries[i].item;
+    } 
+    else 
+    {
+        free(transactions);
+        transactions = NULL;
+    }
+    free(entries);
+    
+    *count = transactions ? total : 0;
+    return transactions;
+}
+
+/*
+ * Report writer
+ *
+ * Transaction listings can run to millions of rows, where a printf with
+ * several conversions plus localtime and strftime per row dominates. The
+ * report writer formats rows by hand into a large buffer and hands it to
+ * fwrite in bulk. The local-time conversion is cached per day: the date
+ * string and the local midnight are reused for every timestamp of the same
+ * day, and only the time of day is computed. Days whose length is not
+ * 24 hours (DST changes) are not cached.
+ */
+
+#define REPORT_BUFFER_SIZE (1 << 16)
+#define REPORT_ROW_MAX 256            // Flush before a row could overflow the buffer
+
+typedef struct ReportWriter 
+{
+    FILE* out;
+    size_t length;
+    time_t dayStart;                  // Local midnight of the cached day
+    time_t dayEnd;                    // Next local midnight; dayStart == dayEnd when empty
+    char date[11];                    // "YYYY-MM-DD" of the cached day
+    char buffer[REPORT_BUFFER_SIZE];
+} ReportWriter;
+
+void initReportWriter(ReportWriter* writer, FILE* out) 
+{
+    writer->out = out;
+    writer->length = 0;
+    writer->dayStart = writer->dayEnd = 0;
+}
+
+void flushReportWriter(ReportWriter* writer) 
+{
+    if (writer->length > 0) fwrite(writer->buffer, 1, writer->length, writer->out);
+    writer->length = 0;
+}
+
+static inline void reportChars(ReportWriter* writer, const char* text, size_t length) 
+{
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+}
+
+// Left-justify the last written field to width, like "%-*s"
+static inline void reportPad(ReportWriter* writer, size_t fieldStart, int width) 
+{
+    size_t written = writer->length - fieldStart;
+    if (written >= (size_t)width) return;
+    memset(writer->buffer + writer->length, ' ', width - written);
+    writer->length += width - written;
+}
+
+// Append the digits of an unsigned value
+static inline void reportDigits(ReportWriter* writer, uint64_t value) 
+{
+    char digits[20];
+    int n = 0;
+    do 
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n > 0) writer->buffer[writer->length++] = digits[--n];
+}
+
+// Like "%-*d"
+static inline void reportInt(ReportWriter* writer, int64_t value, int width) 
+{
+    size_t start = writer->length;
+    if (value < 0) writer->buffer[writer->length++] = '-';
+    reportDigits(writer, value < 0 ? -(uint64_t)value : (uint64_t)value);
+    reportPad(writer, start, width);
+}
+
+// A fixed-point value with `decimals` implied decimals, rounded half away from
+// zero to 2 decimals and left-justified like "%-*.2f"
+static inline void reportAmount(ReportWriter* writer, int64_t value, int decimals, int width) 
+{
+    size_t start = writer->length;
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    uint64_t divisor = 1;
+    for (int i = 2; i < decimals; i++) divisor *= 10;
+    uint64_t cents = (magnitude + divisor / 2) / divisor;
+    
+    if (value < 0 && cents > 0) writer->buffer[writer->length++] = '-';
+    reportDigits(writer, cents / 100);
+    writer->buffer[writer->length++] = '.';
+    writer->buffer[writer->length++] = (char)('0' + cents / 10 % 10);
+    writer->buffer[writer->length++] = (char)('0' + cents % 10);
+    reportPad(writer, start, width);
+}
+
+static inline void reportTwoDigits(char* out, int value) 
+{
+    out[0] = (char)('0' + value / 10);
+    out[1] = (char)('0' + value % 10);
+}
+
+// "YYYY-MM-DD HH:MM:SS" in local time, left-justified to width
+void reportTimestamp(ReportWriter* writer, time_t timestamp, int width) 
+{
+    size_t start = writer->length;
+    char* out = writer->buffer + writer->length;
+    
+    if (timestamp < writer->dayStart || timestamp >= writer->dayEnd) 
+    {
+        struct tm parts;
+        localtime_r(&timestamp, &parts);
+        strftime(writer->date, sizeof(writer->date), "%Y-%m-%d", &parts);
+        
+        // Cache the day only if it has exactly 24 hours of wall-clock time
+        struct tm midnight = parts;
+        midnight.tm_hour = midnight.tm_min = midnight.tm_sec = 0;
+        midnight.tm_isdst = -1;
+        struct tm next = midnight;
+        next.tm_mday++;
+        time_t dayStart = mktime(&midnight);
+        time_t dayEnd = mktime(&next);
+        if (dayEnd - dayStart == 86400 && timestamp >= dayStart && timestamp < dayEnd) 
+        {
+            writer->dayStart = dayStart;
+            writer->dayEnd = dayEnd;
+        } 
+        else 
+        {
+            writer->dayStart = writer->dayEnd = 0;
+            memcpy(out, writer->date, 10);
+            out[10] = ' ';
+            reportTwoDigits(out + 11, parts.tm_hour);
+            out[13] = ':';
+            reportTwoDigits(out + 14, parts.tm_min);
+            out[16] = ':';
+            reportTwoDigits(out + 17, parts.tm_sec);
+            writer->length += 19;
+            reportPad(writer, start, width);
+            return;
+        }
+    }
+    
+    int seconds = (int)(timestamp - writer->dayStart);
+    memcpy(out, writer->date, 10);
+    out[10] = ' ';
+    reportTwoDigits(out + 11, seconds / 3600);
+    out[13] = ':';
+    reportTwoDigits(out + 14, seconds / 60 % 60);
+    out[16] = ':';
+    reportTwoDigits(out + 17, seconds % 60);
+    writer->length += 19;
+    reportPad(writer, start, width);
+}
+
+// One row of the transaction listings, matching their column widths
+void reportTransactionRow(ReportWriter* writer, const Transaction* tx) 
+{
+    if (writer->length + REPORT_ROW_MAX > REPORT_BUFFER_SIZE) flushReportWriter(writer);
+    
+    reportInt(writer, tx->transaction_id, 6);
+    reportChars(writer, " | ", 3);
+    reportInt(writer, tx->buyer_id, 8);
+    reportChars(writer, " | ", 3);
+    reportInt(writer, tx->seller_id, 8);
+    reportChars(writer, " | ", 3);
+    reportAmount(writer, tx->energy_wh, 3, 15);
+    reportChars(writer, " | ", 3);
+    reportAmount(writer, tx->price_micro, 6, 15);
+    reportChars(writer, " | ", 3);
+    reportAmount(writer, txTotalMicro(tx), 6, 15);
+    reportChars(writer, " | ", 3);
+    reportTimestamp(writer, txTimestamp(tx), 20);
+    writer->buffer[writer->length++] = '\n';
+}
+
+static void reportTransactionVisit(void* record, void* ctx) 
+{
+    reportTransactionRow((ReportWriter*)ctx, (const Transaction*)record);
+}
+
+// Function to traverse and display all transactions in the B+ tree
+void displayAllTransactions(BTree* tree) 
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Transaction tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    printf("\n===== TRANSACTION LIST =====\n");
+    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
+           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
+    printf("--------------------------------------------------------------------------------------\n");
+    
+    ReportWriter* writer = (ReportWriter*)malloc(sizeof(ReportWriter));
+    if (!writer) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    initReportWriter(writer, stdout);
+    
+    int count = 0;
+    if (tree->cow) 
+    {
+        // List a point-in-time view, so concurrent updates neither wait for nor tear the listing
+        TreeSnapshot* snapshot = takeSnapshot(tree);
+        count = forEachInSnapshot(snapshot, reportTransactionVisit, writer);
+        releaseSnapshot(snapshot);
+    } 
+    else 
+    {
+        // Find the leftmost leaf node
+        Node* current = tree->root;
+        while (!current->leaf) 
+        {
+            current = current->children[0];
+        }
+        
+        // Traverse all leaf nodes using the 'next' pointers
+        while (current != NULL) 
+        {
+            for (int i = 0; i < current->n; i++) 
+            {
+                reportTransactionRow(writer, (Transaction*)current->records[i]);
+                count++;
+            }
+            current = current->next;
+        }
+    }
+    flushReportWriter(writer);
+    free(writer);
+    
+    printf("--------------------------------------------------------------------------------------\n");
+    printf("Total transactions: %d\n\n", count);
+    METRIC_STOP(METRIC_SCAN_ALL_TRANSACTIONS, scanStart, count);
+}
+
+// Process and display a seller record
+void displaySellerRecord(void* record) 
+{
+    Seller* seller = (Seller*)record;
+    printf("%-8d | %-15.4f | %-15.4f | %-12.2f | ", 
+           seller->seller_id, 
+           microToUnits(seller->rate_below_300), 
+           microToUnits(seller->rate_above_300),
+           microToUnits(seller->total_revenue));
+    
+    // Display regular buyers
+    printf("Regular buyers: ");
+    int buyerCount = 0;
+    RegularBuyerNode* current = seller->regular_buyers;
+    while (current != NULL) {
+        if (buyerCount > 0) printf(", ");
+        printf("%d(%d tx)", current->buyer_id, current->transaction_count);
+        buyerCount++;
+        current = current->next;
+    }
+    if (buyerCount == 0) printf("None");
+    printf("\n");
+}
+
+// Display all sellers
+void displayAllSellers(BTree* tree) 
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Seller tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    printf("\n===== SELLER LIST =====\n");
+    printf("%-8s | %-15s | %-15s | %-12s | %-s\n", 
+           "SELLER ID", "RATE <300kWh", "RATE >300kWh", "REVENUE", "REGULAR BUYERS");
+    printf("--------------------------------------------------------------------------------------\n");
+    
+    // Find the leftmost leaf node
+    Node* current = tree->root;
+    while (!current->leaf) 
+    {
+        current = current->children[0];
+    }
+    
+    // Traverse all leaf nodes using the 'next' pointers
+    int count = 0;
+    while (current != NULL) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            displaySellerRecord(current->records[i]);
+            count++;
+        }
+        current = current->next;
+    }
+    
+    printf("--------------------------------------------------------------------------------------\n");
+    printf("Total sellers: %d\n\n", count);
+    METRIC_STOP(METRIC_SCAN_ALL_SELLERS, scanStart, count);
+}
+
+// Process and display a buyer record
+void displayBuyerRecord(void* record) 
+{
+    Buyer* buyer = (Buyer*)record;
+    printf("%-8d | %-20.2f\n", 
+           buyer->buyer_id, 
+           whToKwh(buyer->total_energy_purchased));
+}
+
+// Display all buyers
+void displayAllBuyers(BTree* tree) 
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Buyer tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    printf("\n===== BUYER LIST =====\n");
+    printf("%-8s | %-20s\n", "BUYER ID", "TOTAL ENERGY (kWh)");
+    printf("---------------------------------\n");
+    
+    // Find the leftmost leaf node
+    Node* current = tree->root;
+    while (!current->leaf) 
+    {
+        current = current->children[0];
+    }
+    
+    // Traverse all leaf nodes using the 'next' pointers
+    int count = 0;
+    while (current != NULL) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            displayBuyerRecord(current->records[i]);
+            count++;
+        }
+        current = current->next;
+    }
+    
+    printf("---------------------------------\n");
+    printf("Total buyers: %d\n\n", count);
+    METRIC_STOP(METRIC_SCAN_ALL_BUYERS, scanStart, count);
+}
+
+// Running totals for a time range listing
+typedef struct TimeRangeTotals 
+{
+    int count;
+    int64_t total_energy;         // Wh
+    int64_t total_revenue;        // Micro-units
+    ReportWriter* writer;         // Where matching rows are listed
+} TimeRangeTotals;
+
+// Visitor that prints an archived transaction in a time range listing
+void displayArchivedTransaction(Transaction* tx, void* ctx) 
+{
+    TimeRangeTotals* totals = (TimeRangeTotals*)ctx;
+    reportTransactionRow(totals->writer, tx);
+    
+    totals->count++;
+    totals->total_energy += tx->energy_wh;
+    totals->total_revenue += txTotalMicro(tx);
+}
+
+/**
+ * Display transactions within a specific time range, including archived ones
+ */
+void displayTransactionsInTimeRange(BTree* tree, const char* archivePath, time_t start_time, time_t end_time) 
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Transaction tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    long scanned = 0;
+    
+    // Find the leftmost leaf node
+    Node* current = tree->root;
+    while (!current->leaf) 
+    {
+        current = current->children[0];
+    }
+    
+    // Format time strings for display
+    char start_str[30], end_str[30];
+    strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", localtime(&start_time));
+    strftime(end_str, sizeof(end_str), "%Y-%m-%d %H:%M:%S", localtime(&end_time));
+    
+    // Traverse all leaf nodes using the 'next' pointers
+    printf("\n===== TRANSACTIONS FROM %s TO %s =====\n", start_str, end_str);
+    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
+           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
+    printf("--------------------------------------------------------------------------------------\n");
+    
+    int count = 0;
+    int64_t total_energy = 0;     // Wh
+    int64_t total_revenue = 0;    // Micro-units
+    
+    ReportWriter* writer = (ReportWriter*)malloc(sizeof(ReportWriter));
+    if (!writer) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    initReportWriter(writer, stdout);
+    
+    while (current != NULL) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            Transaction* tx = current->records[i];
+            
+            // Check if transaction is within the specified time range
+            time_t timestamp = txTimestamp(tx);
+            if (timestamp >= start_time && timestamp <= end_time) 
+            {
+                reportTransactionRow(writer, tx);
+                
+                count++;
+                total_energy += tx->energy_wh;
+                total_revenue += txTotalMicro(tx);
+            }
+        }
+        scanned += current->n;
+        current = current->next;
+    }
+    
+    // Archived transactions are read back from disk
+    TimeRangeTotals archived = { 0, 0, 0, writer };
+    forEachArchivedTransaction(archivePath, start_time, end_time, displayArchivedTransaction, &archived);
+    flushReportWriter(writer);
+    free(writer);
+    count += archived.count;
+    total_energy += archived.total_energy;
+    total_revenue += archived.total_revenue;
+    
+    printf("--------------------------------------------------------------------------------------\n");
+    printf("Total transactions: %d | Total energy: %.2f kWh | Total revenue: $%.2f\n", 
+           count, whToKwh(total_energy), microToUnits(total_revenue));
+    if (archived.count > 0) printf("(%d of them from the archive)\n", archived.count);
+    printf("\n");
+    METRIC_STOP(METRIC_SCAN_TIME_RANGE, scanStart, scanned);
+}
+
+//Calculate total revenue for a specific seller, in micro-units
+int64_t calculateSellerRevenue(BTree* tree, int seller_id) 
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Transaction tree is empty.\n");
+        return 0;
+    }
+    
+    METRIC_START(scanStart);
+    
+    // Sum the seller's transactions over key-range partitions of the leaf chain in parallel
+    SellerScanPartial totals = sumSellerTransactions(sharedScanPool(), tree, seller_id);
+    
+    printf("\n===== REVENUE SUMMARY FOR SELLER ID: %d =====\n", seller_id);
+    printf("Total transactions: %d\n", totals.count);
+    printf("Total energy sold: %.2f kWh\n", whToKwh(totals.energy));
+    printf("Total revenue: $%.2f\n\n", microToUnits(totals.revenue));
+    
+    METRIC_STOP(METRIC_SCAN_SELLER_REVENUE, scanStart, totals.scanned);
+    return totals.revenue;
+}
+
+
+ // Find and display transactions in ascending order by energy amount within a range
+void displayTransactionsByEnergyRange(BTree* tree, double min_energy, double max_energy)
+{
+    if (!tree || !tree->root) 
+    {
+        printf("Transaction tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    // Step 1: Collect the transactions in the energy range from partitions of
+    // the leaf chain in parallel, concatenate the partitions' matches in ID
+    // order and sort the whole array by energy
+    long scanned = 0;
+    int count = 0;
+    Transaction** transactions = collectTransactionsByEnergy(sharedScanPool(), tree, toEnergyWh(min_energy), toEnergyWh(max_energy), &count, &scanned);
+    if (!transactions) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Step 2: Display sorted transactions
+    printf("\n===== TRANSACTIONS BY ENERGY RANGE (%.2f - %.2f kWh) =====\n", min_energy, max_energy);
+    printf("%-6s | %-8s | %-8s | %-15s | %-15s | %-15s | %-20s\n", 
+           "TX ID", "BUYER ID", "SELLER ID", "ENERGY (kWh)", "PRICE/kWh", "TOTAL PRICE", "TIMESTAMP");
+    printf("--------------------------------------------------------------------------------------\n");
+    
+    ReportWriter* writer = (ReportWriter*)malloc(sizeof(ReportWriter));
+    if (writer) 
+    {
+        initReportWriter(writer, stdout);
+        for (int i = 0; i < count; i++) reportTransactionRow(writer, transactions[i]);
+        flushReportWriter(writer);
+        free(writer);
+    }
+    
+    printf("--------------------------------------------------------------------------------------\n");
+    printf("Total transactions in range: %d\n\n", count);
+    
+    // Free the auxiliary array
+    free(transactions);
+    METRIC_STOP(METRIC_SCAN_ENERGY_RANGE, scanStart, scanned);
+}
+
+
+ //Display buyers in ascending order based on energy bought
+void displayBuyersByEnergyBought(BTree* buyerTree) 
+{
+    if (!buyerTree || !buyerTree->root) 
+    {
+        printf("Buyer tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    // Step 1: Traverse tree and collect buyers with their energy as the sort key
+    SortEntry* buyers = NULL;
+    int count = 0;
+    int capacity = 10;  // Initial capacity
+    
+    // Allocate initial array
+    buyers = (SortEntry*)malloc(capacity * sizeof(SortEntry));
+    if (!buyers) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Find the leftmost leaf node
+    Node* current = buyerTree->root;
+    while (!current->leaf) 
+    {
+        current = current->children[0];
+    }
+    
+    // Collect buyers
+    while (current != NULL) 
+    {
+        for (int i = 0; i < current->n; i++) {
+            Buyer* buyer = (Buyer*)current->records[i];
+            
+            // Resize array if needed
+            if (count >= capacity) 
+            {
+                capacity *= 2;
+                buyers = (SortEntry*)realloc(buyers, capacity * sizeof(SortEntry));
+                if (!buyers) 
+                {
+                    printf("Memory reallocation failed.\n");
+                    return;
+                }
+            }
+            
+            buyers[count].key = signedSortKey(buyer->total_energy_purchased);
+            buyers[count++].item = buyer;
+        }
+        current = current->next;
+    }
+    
+    // Step 2: Sort buyers by energy purchased (stable, so equal amounts stay in ID order)
+    if (!sortEntries(buyers, count, sharedScanPool())) 
+    {
+        printf("Memory allocation failed.\n");
+        free(buyers);
+        return;
+    }
+    
+    // Step 3: Display sorted buyers
+    printf("\n===== BUYERS BY ENERGY PURCHASED (ASCENDING) =====\n");
+    printf("%-8s | %-20s\n", "BUYER ID", "TOTAL ENERGY (kWh)");
+    printf("---------------------------------\n");
+    
+    for (int i = 0; i < count; i++) 
+    {
+        const Buyer* buyer = (const Buyer*)buyers[i].item;
+        printf("%-8d | %-20.2f\n", 
+               buyer->buyer_id, 
+               whToKwh(buyer->total_energy_purchased));
+    }
+    
+    printf("---------------------------------\n");
+    printf("Total buyers: %d\n\n", count);
+    
+    // Free the auxiliary array
+    free(buyers);
+    METRIC_STOP(METRIC_SCAN_BUYERS_BY_ENERGY, scanStart, count);
+}
+
+
+// Display seller-buyer pairs in ascending order based on number of transactions
+void displayPairsByTransactionCount(PairTree* pairTree) 
+{
+    if (!pairTree || pairTree->count == 0) 
+    {
+        printf("Seller-Buyer pair tree is empty.\n");
+        return;
+    }
+    
+    METRIC_START(scanStart);
+    
+    // Step 1: Traverse tree and collect pairs with their transaction count as the sort key
+    SortEntry* pairs = NULL;
+    int count = 0;
+    int capacity = 10;  // Initial capacity
+    
+    // Allocate initial array
+    pairs = (SortEntry*)malloc(capacity * sizeof(SortEntry));
+    if (!pairs) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Collect pairs along the leaf chain
+    PairTreeNode* current = PairTreeFirstLeaf(pairTree);
+    while (current != NULL) 
+    {
+        for (int i = 0; i < current->n; i++) {
+            SellerBuyerPair* pair = &current->values[i];
+            
+            // Resize array if needed
+            if (count >= capacity) 
+            {
+                capacity *= 2;
+                pairs = (SortEntry*)realloc(pairs, capacity * sizeof(SortEntry));
+                if (!pairs) 
+                {
+                    printf("Memory reallocation failed.\n");
+                    return;
+                }
+            }
+            
+            pairs[count].key = signedSortKey(pair->number_of_transactions);
+            pairs[count++].item = pair;
+        }
+        current = current->next;
+    }
+    
+    // Step 2: Sort pairs by transaction count (stable, so equal counts stay in pair order)
+    if (!sortEntries(pairs, count, sharedScanPool())) 
+    {
+        printf("Memory allocation failed.\n");
+        free(pairs);
+        return;
+    }
+    
+    // Step 3: Display sorted pairs
+    printf("\n===== SELLER-BUYER PAIRS BY TRANSACTION COUNT (ASCENDING) =====\n");
+    printf("%-8s | %-8s | %-20s\n", "SELLER ID", "BUYER ID", "TRANSACTION COUNT");
+    printf("------------------------------------------\n");
+    
+    for (int i = 0; i < count; i++) 
+    {
+        const SellerBuyerPair* pair = (const SellerBuyerPair*)pairs[i].item;
+        printf("%-8d | %-8d | %-20d\n", 
+               pair->seller_id, 
+               pair->buyer_id, 
+               pair->number_of_transactions);
+    }
+    
+    printf("------------------------------------------\n");
+    printf("Total pairs: %d\n\n", count);
+    
+    // Free the auxiliary array
+    free(pairs);
+    METRIC_STOP(METRIC_SCAN_PAIRS_BY_COUNT, scanStart, count);
+}
+
+// Shape of the per-entity transaction sets of every seller or buyer in a tree
+typedef struct TransactionSetStats 
+{
+    long sets;
+    long inline_sets;
+    long transactions;
+    TreeStats promoted;           // Trees of the promoted sets, added together
+} TransactionSetStats;
+
+void collectTransactionSetStats(BTree* entityTree, bool sellers, TransactionSetStats* stats) 
+{
+    if (!entityTree || !entityTree->root) return;
+    
+    Node* current = entityTree->root;
+    while (!current->leaf) current = current->children[0];
+    
+    for (; current != NULL; current = current->next) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            TransactionSet* set = sellers ? &((Seller*)current->records[i])->transactions 
+                                          : &((Buyer*)current->records[i])->transactions;
+            stats->sets++;
+            stats->transactions += set->count;
+            if (set->promoted) collectTreeStats(set->tree, &stats->promoted);
+            else stats->inline_sets++;
+        }
+    }
+}
+
+// Print one row of the tree statistics table
+void printTreeStatsRow(const char* name, const TreeStats* stats) 
+{
+    printf("%-22s | %-6d | %-10ld | %-10ld | %-10ld | %-9.1f | %-9.1f | %-12zu\n", 
+           name, stats->height, stats->leaf_nodes, stats->internal_nodes, stats->leaf_keys, 
+           stats->leaf_slots ? 100.0 * stats->leaf_keys / stats->leaf_slots : 0.0, 
+           stats->internal_slots ? 100.0 * stats->internal_keys / stats->internal_slots : 0.0, 
+           stats->bytes);
+}
+
+// Display height, node counts, fill factor and node memory of every tree
+void displayTreeStatistics(BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    TreeStats transactions = {0}, sellers = {0}, buyers = {0}, pairs = {0};
+    collectTreeStats(transactionTree, &transactions);
+    collectTreeStats(sellerTree, &sellers);
+    collectTreeStats(buyerTree, &buyers);
+    PairTreeCollectStats(pairTree->root, 1, &pairs);
+    
+    TransactionSetStats sellerSets = {0}, buyerSets = {0};
+    collectTransactionSetStats(sellerTree, true, &sellerSets);
+    collectTransactionSetStats(buyerTree, false, &buyerSets);
+    
+    printf("\n===== TREE STATISTICS =====\n");
+    printf("%-22s | %-6s | %-10s | %-10s | %-10s | %-9s | %-9s | %-12s\n", 
+           "TREE", "HEIGHT", "LEAVES", "INTERNAL", "KEYS", "LEAF FILL", "INT FILL", "NODE BYTES");
+    printf("------------------------------------------------------------------------------------------------------\n");
+    printTreeStatsRow("Transactions", &transactions);
+    printTreeStatsRow("Sellers", &sellers);
+    printTreeStatsRow("Buyers", &buyers);
+    printTreeStatsRow("Seller-buyer pairs", &pairs);
+    printTreeStatsRow("Seller subtrees (all)", &sellerSets.promoted);
+    printTreeStatsRow("Buyer subtrees (all)", &buyerSets.promoted);
+    printf("------------------------------------------------------------------------------------------------------\n");
+    printf("Fill is the percentage of key slots in use. Subtree rows add up the trees of promoted transaction sets.\n");
+    printf("Seller transaction sets: %ld (%ld inline, %ld promoted), %ld transactions\n", 
+           sellerSets.sets, sellerSets.inline_sets, sellerSets.sets - sellerSets.inline_sets, sellerSets.transactions);
+    printf("Buyer transaction sets: %ld (%ld inline, %ld promoted), %ld transactions\n\n", 
+           buyerSets.sets, buyerSets.inline_sets, buyerSets.sets - buyerSets.inline_sets, buyerSets.transactions);
+}
+
+/*
+ * Memory accounting
+ *
+ * Bytes requested from malloc and the arenas, by structure, found by walking every tree,
+ * list and index. Sizing a host needs bytes per transaction across the
+ * global tree, the seller and buyer subtrees, the pair tree, regular-buyer
+ * lists and hash indexes. The walk keeps the update paths free of counters.
+ * malloc adds a header and rounding to each allocation, so the report also
+ * prints the heap glibc has handed out, when it is available, and the chunks
+ * the node and record arenas have mapped.
+ */
+
+// --check-footprint fails above this many accounted bytes per transaction
+// (1M transactions of the suite's default workload)
+#define FOOTPRINT_BUDGET 210.0
+
+// Bytes currently allocated on the heap, arena objects included (0 if the C
+// library cannot report it)
+size_t heapBytesInUse(void) 
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    ArenaUsage arenas;
+    arenaUsage(&arenas);
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd + arenas.used;   // hblkhd: blocks glibc mapped on their own
+#else
+    return 0;
+#endif
+}
+
+typedef enum MemoryCategory 
+{
+    MEM_TRANSACTION_NODES,
+    MEM_TRANSACTION_RECORDS,
+    MEM_SELLER_NODES,
+    MEM_SELLER_RECORDS,
+    MEM_SELLER_SUBTREES,
+    MEM_REGULAR_BUYERS,
+    MEM_TARIFFS,
+    MEM_BUYER_NODES,
+    MEM_BUYER_RECORDS,
+    MEM_BUYER_SUBTREES,
+    MEM_PAIR_NODES,
+    MEM_HASH_INDEXES,
+    NUM_MEMORY_CATEGORIES
+} MemoryCategory;
+
+static const char* const memoryCategoryNames[NUM_MEMORY_CATEGORIES] = {
+    "Transaction tree nodes", "Transaction records", "Seller tree nodes", "Seller records", 
+    "Seller subtrees", "Regular buyer lists", "Seller tariffs", "Buyer tree nodes", "Buyer records", 
+    "Buyer subtrees", "Seller-buyer pair tree", "Hash indexes"
+};
+
+// Names in batch query results
+static const char* const memoryCategoryKeys[NUM_MEMORY_CATEGORIES] = {
+    "transaction_nodes", "transaction_records", "seller_nodes", "seller_records", 
+    "seller_subtrees", "regular_buyers", "tariffs", "buyer_nodes", "buyer_records", 
+    "buyer_subtrees", "pair_nodes", "hash_indexes"
+};
+
+typedef struct MemoryFootprint 
+{
+    long allocations[NUM_MEMORY_CATEGORIES];
+    size_t bytes[NUM_MEMORY_CATEGORIES];
+    long transactions;            // In the transaction tree
+    size_t totalBytes;
+} MemoryFootprint;
+
+static void addMemory(MemoryFootprint* footprint, MemoryCategory category, long allocations, size_t bytes) 
+{
+    footprint->allocations[category] += allocations;
+    footprint->bytes[category] += bytes;
+    footprint->totalBytes += bytes;
+}
+
+static void addTreeNodes(MemoryFootprint* footprint, MemoryCategory category, BTree* tree) 
+{
+    TreeStats stats = {0};
+    collectTreeStats(tree, &stats);
+    addMemory(footprint, category, stats.leaf_nodes + stats.internal_nodes, stats.bytes);
+}
+
+static void addHashIndex(MemoryFootprint* footprint, const HashIndex* index) 
+{
+    if (index) addMemory(footprint, MEM_HASH_INDEXES, 2, sizeof(HashIndex) + (index->mask + 1) * sizeof(HashSlot));
+}
+
+static void addTransactionSet(MemoryFootprint* footprint, MemoryCategory category, TransactionSet* set) 
+{
+    if (!set->promoted) return;
+    addMemory(footprint, category, 1, sizeof(BTree));
+    addTreeNodes(footprint, category, set->tree);
+}
+
+// Leftmost leaf of a generic tree
+static Node* firstLeaf(BTree* tree) 
+{
+    Node* node = tree->root;
+    while (!node->leaf) node = node->children[0];
+    return node;
+}
+
+// Add up the memory of the in-memory trees and everything hanging off them
+void collectMemoryFootprint(MemoryFootprint* footprint, BTree* transactionTree, BTree* sellerTree, 
+                            BTree* buyerTree, PairTree* pairTree) 
+{
+    memset(footprint, 0, sizeof(MemoryFootprint));
+    
+    addTreeNodes(footprint, MEM_TRANSACTION_NODES, transactionTree);
+    for (Node* leaf = firstLeaf(transactionTree); leaf != NULL; leaf = leaf->next) footprint->transactions += leaf->n;
+    addMemory(footprint, MEM_TRANSACTION_RECORDS, footprint->transactions, footprint->transactions * sizeof(Transaction));
+    addHashIndex(footprint, transactionTree->index);
+    
+    addTreeNodes(footprint, MEM_SELLER_NODES, sellerTree);
+    addHashIndex(footprint, sellerTree->index);
+    for (Node* leaf = firstLeaf(sellerTree); leaf != NULL; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) 
+        {
+            Seller* seller = (Seller*)leaf->records[i];
+            addMemory(footprint, MEM_SELLER_RECORDS, 1, sizeof(Seller));
+            addTransactionSet(footprint, MEM_SELLER_SUBTREES, &seller->transactions);
+            for (RegularBuyerNode* node = seller->regular_buyers; node != NULL; node = node->next) 
+            {
+                addMemory(footprint, MEM_REGULAR_BUYERS, 1, sizeof(RegularBuyerNode));
+            }
+            if (seller->tariff) addMemory(footprint, MEM_TARIFFS, 1, sizeof(Tariff));
+        }
+    }
+    
+    addTreeNodes(footprint, MEM_BUYER_NODES, buyerTree);
+    addHashIndex(footprint, buyerTree->index);
+    for (Node* leaf = firstLeaf(buyerTree); leaf != NULL; leaf = leaf->next) 
+    {
+        for (int i = 0; i < leaf->n; i++) 
+        {
+            addMemory(footprint, MEM_BUYER_RECORDS, 1, sizeof(Buyer));
+            addTransactionSet(footprint, MEM_BUYER_SUBTREES, &((Buyer*)leaf->records[i])->transactions);
+        }
+    }
+    
+    TreeStats pairs = {0};
+    PairTreeCollectStats(pairTree->root, 1, &pairs);
+    addMemory(footprint, MEM_PAIR_NODES, pairs.leaf_nodes + pairs.internal_nodes, pairs.bytes);
+    addHashIndex(footprint, pairTree->index);
+    addHashIndex(footprint, archivedIds);
+}
+
+// Bytes per transaction, or 0 with no transactions
+static double footprintPerTransaction(const MemoryFootprint* footprint, size_t bytes) 
+{
+    return footprint->transactions ? (double)bytes / footprint->transactions : 0.0;
+}
+
+// Print the memory of each structure, in total and per transaction
+void displayMemoryFootprint(BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    MemoryFootprint footprint;
+    collectMemoryFootprint(&footprint, transactionTree, sellerTree, buyerTree, pairTree);
+    
+    printf("\n===== MEMORY FOOTPRINT, %ld TRANSACTIONS =====\n", footprint.transactions);
+    printf("%-24s | %-12s | %-14s | %-8s | %-6s\n", "STRUCTURE", "ALLOCATIONS", "BYTES", "BYTES/TX", "SHARE");
+    printf("--------------------------------------------------------------------------\n");
+    long allocations = 0;
+    for (int c = 0; c < NUM_MEMORY_CATEGORIES; c++) 
+    {
+        allocations += footprint.allocations[c];
+        printf("%-24s | %-12ld | %-14zu | %-8.1f | %5.1f%%\n", memoryCategoryNames[c], footprint.allocations[c], 
+               footprint.bytes[c], footprintPerTransaction(&footprint, footprint.bytes[c]), 
+               footprint.totalBytes ? 100.0 * footprint.bytes[c] / footprint.totalBytes : 0.0);
+    }
+    printf("--------------------------------------------------------------------------\n");
+    printf("%-24s | %-12ld | %-14zu | %-8.1f |\n", "Total", allocations, footprint.totalBytes, 
+           footprintPerTransaction(&footprint, footprint.totalBytes));
+    
+    size_t heap = heapBytesInUse();
+    if (heap > 0) 
+    {
+        printf("Heap in use: %zu bytes (%.1f per transaction), including malloc headers and rounding\n", 
+               heap, footprintPerTransaction(&footprint, heap));
+    }
+    ArenaUsage arenas;
+    arenaUsage(&arenas);
+    if (arenas.chunks > 0) 
+    {
+        printf("Arenas: %ld chunks of %zu KB (%zu bytes, %zu in use), %ld with huge pages advised, %ld NUMA-interleaved\n", 
+               arenas.chunks, ARENA_CHUNK_BYTES >> 10, arenas.reserved, arenas.used, arenas.huge_chunks, 
+               arenas.interleaved_chunks);
+    }
+    printf("\n");
+}
+
+#ifdef ENABLE_METRICS
+static const char* metricNames[NUM_METRICS] = {
+    "insert", "split", "search", "processTransaction", 
+    "scan: all transactions", "scan: all sellers", "scan: all buyers", "scan: time range", 
+    "scan: seller revenue", "scan: energy range", "scan: buyers by energy", "scan: pairs by count", 
+    "scan: export"
+};
+
+// Upper bound in ns of the histogram bucket holding the given fraction of calls
+static uint64_t metricPercentile(const Metric* metric, double fraction) 
+{
+    uint64_t target = (uint64_t)(metric->calls * fraction);
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++) 
+    {
+        seen += metric->buckets[b];
+        if (seen > target) return 2ULL << b;
+    }
+    return 2ULL << (LATENCY_BUCKETS - 1);
+}
+#endif
+
+// Display the hot-path counters and latency histograms gathered so far
+void displayMetrics(void) 
+{
+#ifdef ENABLE_METRICS
+    printf("\n===== HOT-PATH METRICS =====\n");
+    printf("%-24s | %-10s | %-10s | %-10s | %-10s | %-10s | %-10s\n", 
+           "OPERATION", "CALLS", "AVG NS", "P50 NS <=", "P99 NS <=", "MAX NS <=", "ITEMS/CALL");
+    printf("------------------------------------------------------------------------------------------------\n");
+    for (int id = 0; id < NUM_METRICS; id++) 
+    {
+        const Metric* metric = &metrics[id];
+        if (metric->calls == 0) continue;
+        
+        int top = LATENCY_BUCKETS - 1;
+        while (top > 0 && metric->buckets[top] == 0) top--;
+        printf("%-24s | %-10llu | %-10.0f | %-10llu | %-10llu | %-10llu | %-10.1f\n", 
+               metricNames[id], (unsigned long long)metric->calls, (double)metric->total_ns / metric->calls, 
+               (unsigned long long)metricPercentile(metric, 0.5), (unsigned long long)metricPercentile(metric, 0.99), 
+               (unsigned long long)(2ULL << top), (double)metric->items / metric->calls);
+    }
+    printf("------------------------------------------------------------------------------------------------\n");
+    printf("Items are levels descended (insert, search), keys moved (split) and records visited (scans).\n");
+    printf("Nodes allocated: %llu (%llu bytes) | Leaf splits: %llu | Internal splits: %llu | Root splits: %llu\n\n", 
+           (unsigned long long)nodesAllocated, (unsigned long long)nodeBytesAllocated, 
+           (unsigned long long)leafSplits, (unsigned long long)internalSplits, (unsigned long long)rootSplits);
+#else
+    printf("\nHot-path metrics are disabled; rebuild with -DENABLE_METRICS to collect them.\n\n");
+#endif
+}
+
+int my_strptime(const char *date_str, const char *format, struct tm *tm) 
+{
+    // This function handles the "%Y-%m-%d" format.
+    int year, month, day;
+    if (strcmp(format, "%Y-%m-%d") == 0) 
+    {
+        if (sscanf(date_str, "%4d-%2d-%2d", &year, &month, &day) == 3) 
+        {
+            tm->tm_year = year - 1900;  // years since 1900
+            tm->tm_mon = month - 1;     // months since January [0-11]
+            tm->tm_mday = day;
+            tm->tm_hour = 0;
+            tm->tm_min = 0;
+            tm->tm_sec = 0;
+            tm->tm_isdst = -1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Outcome of an import; anything but inserted lines means exporting would rewrite the file
+typedef struct ImportSummary 
+{
+    int inserted;
+    int updated;                  // Duplicate IDs that changed an earlier line
+    int unchanged;                // Duplicate IDs identical to an earlier line
+    int skipped;                  // Invalid lines and archived IDs
+    bool opened;
+} ImportSummary;
+
+// Import transactions from a CSV file in the transactions.txt format
+ImportSummary importTransactionsFrom(const char* path, BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    ImportSummary summary = { 0, 0, 0, 0, false };
+    FILE* file = fopen(path, "r");
+    if (!file) 
+    {
+        printf("Error opening file %s for reading\n", path);
+        return summary;
+    }
+    summary.opened = true;
+    
+    int count = 0, updated = 0, unchanged = 0;
+    char line[256];
+    
+    // Skip header line if present
+    if (fgets(line, sizeof(line), file) != NULL) 
+    {
+        // Check if this is a header line (contains non-numeric characters)
+        if (line[0] < '0' || line[0] > '9') 
+        {
+            // It's a header, continue to next line
+        } 
+        else 
+        {
+            // It's data, rewind to start of file
+            rewind(file);
+        }
+    }
+    
+    // Read and process each line
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        int transaction_id, buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        long long timestamp;
+        
+        // Parse the line
+        if (sscanf(line, "%d,%d,%d,%lf,%lf,%lld", &transaction_id, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp) == 6)
+        {
+            if (!isValidTimestamp((time_t)timestamp)) 
+            {
+                printf("Warning: Skipping line with timestamp out of range: %s", line);
+                summary.skipped++;
+                continue;
+            }
+            
+            // Create the transaction, then add it (or reconcile it with an existing ID)
+            Transaction* tx = createTransaction(transaction_id, buyer_id, seller_id, energy_kwh, price_per_kwh, (time_t)timestamp);
+            
+            switch (upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree)) 
+            {
+                case UPSERT_INSERTED: count++; break;
+                case UPSERT_UPDATED: updated++; break;
+                case UPSERT_UNCHANGED: unchanged++; break;
+                case UPSERT_ARCHIVED: 
+                    printf("Warning: Skipping transaction %d, its ID is archived\n", transaction_id);
+                    summary.skipped++;
+                    break;
+            }
+        } 
+        else 
+        {
+            printf("Warning: Skipping invalid line: %s", line);
+            summary.skipped++;
+        }
+    }
+    
+    fclose(file);
+    printf("Successfully imported %d transactions from %s\n", count, path);
+    if (updated > 0 || unchanged > 0) 
+    {
+        printf("Duplicate transaction IDs: %d updated, %d unchanged\n", updated, unchanged);
+    }
+    
+    summary.inserted = count;
+    summary.updated = updated;
+    summary.unchanged = unchanged;
+    return summary;
+}
+
+//Function to import data from transactions.txt
+ImportSummary importTransactions(BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    return importTransactionsFrom("transactions.txt", transactionTree, sellerTree, buyerTree, pairTree);
+}
+
+
+// Format a fixed-point value with the given number of implied decimals,
+// dropping trailing zeros beyond the second decimal
+char* formatFixed(char* buf, int64_t value, int decimals) 
+{
+    int64_t scale = 1;
+    for (int i = 0; i < decimals; i++) scale *= 10;
+    
+    uint64_t magnitude = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    int len = sprintf(buf, "%s%llu.%0*llu", value < 0 ? "-" : "", 
+                      (unsigned long long)(magnitude / scale), decimals, (unsigned long long)(magnitude % scale));
+    
+    int keep = len - decimals + 2;
+    while (len > keep && buf[len - 1] == '0') len--;
+    buf[len] = '\0';
+    return buf;
+}
+
+// Write one transaction to an export file, with as many decimals as needed to be lossless
+static void exportTransactionVisit(void* record, void* ctx) 
+{
+    const Transaction* tx = (const Transaction*)record;
+    char energy_str[32], price_str[32];
+    fprintf((FILE*)ctx, "%d,%d,%d,%s,%s,%lld\n", 
+           tx->transaction_id, tx->buyer_id, tx->seller_id, 
+           formatFixed(energy_str, tx->energy_wh, 3), formatFixed(price_str, tx->price_micro, 6), 
+           (long long)txTimestamp(tx));
+}
+
+static char* pathWithSuffix(const char* path, const char* suffix) 
+{
+    char* result = (char*)malloc(strlen(path) + strlen(suffix) + 1);
+    if (!result) 
+    {
+        printf("Memory allocation failed for path\n");
+        exit(1);
+    }
+    strcpy(result, path);
+    strcat(result, suffix);
+    return result;
+}
+
+// Write a file with write(file, ctx) without ever leaving it half written: the
+// data goes to <path>.export, is synced, and only then renamed over path.
+// Returns what write returned (rows written), or -1 if anything failed.
+static long replaceFile(const char* path, long (*write)(FILE* file, void* ctx), void* ctx) 
+{
+    char* tempPath = pathWithSuffix(path, ".export");
+    long count = -1;
+    FILE* file = fopen(tempPath, "w");
+    if (file) 
+    {
+        count = write(file, ctx);
+        bool ok = count >= 0 && fflush(file) == 0 && !ferror(file) && fsync(fileno(file)) == 0;
+        if (fclose(file) != 0 || !ok) count = -1;
+    }
+    if (count >= 0 && rename(tempPath, path) != 0) count = -1;
+    if (count < 0) unlink(tempPath);
+    free(tempPath);
+    return count;
+}
+
+// Write a snapshot's transactions, with the header line
+static long writeSnapshotFile(FILE* file, void* ctx) 
+{
+    fprintf(file, "transaction_id,buyer_id,seller_id,energy,price,timestamp\n");
+    return forEachInSnapshot((const TreeSnapshot*)ctx, exportTransactionVisit, file);
+}
+
+// Write a snapshot's transactions to a file in the transactions.txt format,
+// synced to disk if durable. Returns the number written, or -1 on failure.
+long exportSnapshotTo(const TreeSnapshot* snapshot, const char* path, bool durable) 
+{
+    FILE* file = fopen(path, "w");
+    if (!file) return -1;
+    
+    long count = writeSnapshotFile(file, (void*)snapshot);
+    bool ok = fflush(file) == 0 && !ferror(file) && (!durable || fsync(fileno(file)) == 0);
+    if (fclose(file) != 0 || !ok) return -1;
+    return count;
+}
+
+// Replace a file with a snapshot's transactions, see replaceFile
+long replaceWithSnapshot(const TreeSnapshot* snapshot, const char* path) 
+{
+    return replaceFile(path, writeSnapshotFile, (void*)snapshot);
+}
+
+// Write all transactions of a tree, with the header line
+static long writeTransactionFile(FILE* file, void* ctx) 
+{
+    BTree* tree = (BTree*)ctx;
+    
+    // Write header
+    fprintf(file, "transaction_id,buyer_id,seller_id,energy,price,timestamp\n");
+    
+    if (!tree || !tree->root) 
+    {
+        printf("Transaction tree is empty, writing empty file.\n");
+        return 0;
+    }
+    
+    long count = 0;
+    
+    if (tree->cow) 
+    {
+        // Write a point-in-time view, so concurrent updates neither wait for nor tear the export
+        TreeSnapshot* snapshot = takeSnapshot(tree);
+        count = forEachInSnapshot(snapshot, exportTransactionVisit, file);
+        releaseSnapshot(snapshot);
+    } 
+    else 
+    {
+        // Find the leftmost leaf node
+        Node* current = tree->root;
+        while (!current->leaf) 
+        {
+            current = current->children[0];
+        }
+        
+        // Traverse all leaf nodes using the 'next' pointers
+        while (current != NULL) 
+        {
+            for (int i = 0; i < current->n; i++) 
+            {
+                exportTransactionVisit(current->records[i], file);
+                count++;
+            }
+            current = current->next;
+        }
+    }
+    return count;
+}
+
+// Export all transactions to a CSV file in the transactions.txt format. The file
+// is replaced atomically, so it may be the file the transactions were loaded from.
+// Returns the number exported, or -1 if the file was left unchanged.
+long exportTransactionsTo(BTree* tree, const char* path) 
+{
+    METRIC_START(scanStart);
+    long count = replaceFile(path, writeTransactionFile, tree);
+    if (count < 0) 
+    {
+        printf("Error writing file %s\n", path);
+        return -1;
+    }
+    
+    METRIC_STOP(METRIC_SCAN_EXPORT, scanStart, count);
+    printf("Successfully exported %ld transactions to %s\n", count, path);
+    return count;
+}
+
+void exportTransactions( BTree* tree) 
+{
+    exportTransactionsTo(tree, "transactions.txt");
+}
+
+
+/*
+ * Checkpointing
+ *
+ * With a checkpoint interval, every update is also appended to a write-ahead
+ * log next to the transaction file (<file>.wal): upserts as transactions.txt
+ * lines, deletions as "delete:ID". A background thread wakes every interval
+ * and, holding the log lock for a few microseconds, cuts the log (renames it
+ * to <file>.wal.old) and takes a snapshot of the transaction tree. Without
+ * any lock it then writes the snapshot to <file>.checkpoint, syncs it, renames
+ * it over <file> and deletes the old log segment, so the file plus the log
+ * always hold every applied update. Opening a checkpointer replays the logs
+ * left by a crash. Seller, buyer and pair aggregates are rebuilt from the
+ * transactions when they are loaded, so the checkpoint covers them too. The
+ * log is flushed after each update but not synced: it survives a crash of
+ * the process, not of the machine.
+ */
+
+typedef struct Checkpointer 
+{
+    BTree* transactionTree;       // Snapshots must be enabled
+    const char* path;             // Transaction file that checkpoints replace
+    char* logPath;                // <path>.wal: updates since the last cut
+    char* oldLogPath;             // <path>.wal.old: updates the checkpoint being written covers
+    char* tempPath;               // <path>.checkpoint
+    FILE* log;
+    double interval;              // Seconds between checkpoints
+    long pending;                 // Updates logged since the last cut
+    bool oldPending;              // oldLogPath exists and is not yet covered by a checkpoint
+    bool stopping;
+    pthread_mutex_t lock;         // Held by writers to apply and log an update, and to cut the log
+    pthread_mutex_t writing;      // Held for a whole checkpoint, so only one runs at a time
+    pthread_cond_t wake;
+    pthread_t thread;
+    
+    // Measurements, guarded by lock
+    long checkpoints;
+    long failures;
+    long lastRows;
+    uint64_t writeNanos;          // Total time spent writing checkpoints
+    uint64_t maxWriteNanos;
+    uint64_t maxCutNanos;         // Longest the log lock was held for a cut
+} Checkpointer;
+
+static uint64_t monotonicNanos(void);
+
+// Apply a checkpointer's log; returns the number of updates, or -1 if there is no log
+long replayLog(const char* path, BTree* transactionTree, BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    FILE* file = fopen(path, "r");
+    if (!file) return -1;
+    
+    long count = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) 
+    {
+        int transaction_id, buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        long long timestamp;
+        
+        // A line torn by a crash ends the log without a newline and is skipped
+        if (!strchr(line, '\n')) break;
+        if (sscanf(line, "delete:%d", &transaction_id) == 1) 
+        {
+            deleteTransaction(transactionTree, transaction_id, sellerTree, buyerTree, pairTree);
+            count++;
+        } 
+        else if (sscanf(line, "%d,%d,%d,%lf,%lf,%lld", &transaction_id, &buyer_id, &seller_id, 
+                        &energy_kwh, &price_per_kwh, &timestamp) == 6 && isValidTimestamp((time_t)timestamp)) 
+        {
+            Transaction* tx = createTransaction(transaction_id, buyer_id, seller_id, energy_kwh, price_per_kwh, (time_t)timestamp);
+            upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree);
+            count++;
+        }
+    }
+    
+    fclose(file);
+    return count;
+}
+
+// Append the complete lines of one file to another
+static bool appendLog(const char* from, const char* to) 
+{
+    FILE* in = fopen(from, "r");
+    if (!in) return errno == ENOENT;
+    FILE* out = fopen(to, "a");
+    if (!out) 
+    {
+        fclose(in);
+        return false;
+    }
+    
+    char line[256];
+    while (fgets(line, sizeof(line), in) != NULL && strchr(line, '\n')) fputs(line, out);
+    bool ok = !ferror(in) && fflush(out) == 0 && !ferror(out);
+    fclose(in);
+    return fclose(out) == 0 && ok;
+}
+
+// Start an update that is logged if cp is not NULL
+void beginLoggedUpdate(Checkpointer* cp) 
+{
+    if (cp) pthread_mutex_lock(&cp->lock);
+}
+
+// Log a transaction added or changed by the current update
+void logUpsert(Checkpointer* cp, const Transaction* tx) 
+{
+    if (!cp) return;
+    exportTransactionVisit((void*)tx, cp->log);
+    cp->pending++;
+}
+
+// Log a transaction removed by the current update
+void logDelete(Checkpointer* cp, int transaction_id) 
+{
+    if (!cp) return;
+    fprintf(cp->log, "delete:%d\n", transaction_id);
+    cp->pending++;
+}
+
+// Finish an update, flushing its log lines to the kernel
+void endLoggedUpdate(Checkpointer* cp) 
+{
+    if (!cp) return;
+    fflush(cp->log);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+// Write every update logged so far into the transaction file and drop it from
+// the log; with force, write the file even if nothing was logged. Writers are
+// only held up while the log is cut. Returns the transactions written (0 if
+// there was nothing to do), or -1 if the checkpoint failed; its updates then
+// stay in the log for the next attempt.
+static long writeCheckpoint(Checkpointer* cp, bool force) 
+{
+    pthread_mutex_lock(&cp->writing);
+    pthread_mutex_lock(&cp->lock);
+    if (!force && cp->pending == 0 && !cp->oldPending) 
+    {
+        pthread_mutex_unlock(&cp->lock);
+        pthread_mutex_unlock(&cp->writing);
+        return 0;
+    }
+    
+    // Cut: the old segment (which a failed checkpoint may have left) takes the log so far
+    uint64_t cutStart = monotonicNanos();
+    fclose(cp->log);
+    bool cut = cp->oldPending ? appendLog(cp->logPath, cp->oldLogPath) : rename(cp->logPath, cp->oldLogPath) == 0;
+    cp->log = fopen(cp->logPath, cut ? "w" : "a");
+    if (!cp->log) 
+    {
+        printf("Error opening file %s for writing\n", cp->logPath);
+        exit(1);
+    }
+    TreeSnapshot* snapshot = NULL;
+    if (cut) 
+    {
+        snapshot = takeSnapshot(cp->transactionTree);
+        cp->oldPending = true;
+        cp->pending = 0;
+    }
+    uint64_t cutNanos = monotonicNanos() - cutStart;
+    if (cutNanos > cp->maxCutNanos) cp->maxCutNanos = cutNanos;
+    if (!cut) cp->failures++;
+    pthread_mutex_unlock(&cp->lock);
+    if (!cut) 
+    {
+        pthread_mutex_unlock(&cp->writing);
+        return -1;
+    }
+    
+    uint64_t writeStart = monotonicNanos();
+    long rows = exportSnapshotTo(snapshot, cp->tempPath, true);
+    releaseSnapshot(snapshot);
+    if (rows >= 0 && rename(cp->tempPath, cp->path) != 0) rows = -1;
+    if (rows >= 0) unlink(cp->oldLogPath);
+    else unlink(cp->tempPath);
+    uint64_t writeNanos = monotonicNanos() - writeStart;
+    
+    pthread_mutex_lock(&cp->lock);
+    if (rows >= 0) 
+    {
+        cp->oldPending = false;
+        cp->checkpoints++;
+        cp->lastRows = rows;
+        cp->writeNanos += writeNanos;
+        if (writeNanos > cp->maxWriteNanos) cp->maxWriteNanos = writeNanos;
+    } 
+    else 
+    {
+        cp->failures++;
+    }
+    pthread_mutex_unlock(&cp->lock);
+    pthread_mutex_unlock(&cp->writing);
+    return rows;
+}
+
+// Checkpoint the updates logged so far; false if the checkpoint failed
+bool checkpointNow(Checkpointer* cp) 
+{
+    return writeCheckpoint(cp, false) >= 0;
+}
+
+// Write the transaction file now, whether or not anything was logged since the
+// last checkpoint. Returns the transactions written, or -1 on failure.
+long forceCheckpoint(Checkpointer* cp) 
+{
+    return writeCheckpoint(cp, true);
+}
+
+static void* checkpointThread(void* arg) 
+{
+    Checkpointer* cp = (Checkpointer*)arg;
+    pthread_mutex_lock(&cp->lock);
+    while (!cp->stopping) 
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        long long nanos = deadline.tv_nsec + (long long)(cp->interval * 1e9);
+        deadline.tv_sec += nanos / 1000000000;
+        deadline.tv_nsec = nanos % 1000000000;
+        while (!cp->stopping && pthread_cond_timedwait(&cp->wake, &cp->lock, &deadline) != ETIMEDOUT);
+        if (cp->stopping) break;
+        
+        pthread_mutex_unlock(&cp->lock);
+        checkpointNow(cp);
+        pthread_mutex_lock(&cp->lock);
+    }
+    pthread_mutex_unlock(&cp->lock);
+    return NULL;
+}
+
+// Recover the updates logged for path since its last checkpoint, then start
+// checkpointing it every interval seconds. Enables snapshots on the transaction tree.
+Checkpointer* openCheckpointer(const char* path, double interval, BTree* transactionTree, 
+                               BTree* sellerTree, BTree* buyerTree, PairTree* pairTree) 
+{
+    Checkpointer* cp = (Checkpointer*)calloc(1, sizeof(Checkpointer));
+    if (!cp) 
+    {
+        printf("Memory allocation failed for Checkpointer\n");
+        exit(1);
+    }
+    cp->transactionTree = transactionTree;
+    cp->path = path;
+    cp->logPath = pathWithSuffix(path, ".wal");
+    cp->oldLogPath = pathWithSuffix(path, ".wal.old");
+    cp->tempPath = pathWithSuffix(path, ".checkpoint");
+    cp->interval = interval;
+    pthread_mutex_init(&cp->lock, NULL);
+    pthread_mutex_init(&cp->writing, NULL);
+    pthread_cond_init(&cp->wake, NULL);
+    enableSnapshots(transactionTree);
+    
+    // The old segment predates the current log
+    long fromOld = replayLog(cp->oldLogPath, transactionTree, sellerTree, buyerTree, pairTree);
+    long fromLog = replayLog(cp->logPath, transactionTree, sellerTree, buyerTree, pairTree);
+    if (fromOld >= 0 || fromLog >= 0) 
+    {
+        printf("Recovered %ld logged updates for %s\n", (fromOld > 0 ? fromOld : 0) + (fromLog > 0 ? fromLog : 0), path);
+    }
+    cp->oldPending = fromOld >= 0;
+    cp->pending = fromLog > 0 ? fromLog : 0;
+    
+    // Finish any torn last line, so appended updates start on a line of their own
+    cp->log = fopen(cp->logPath, "a+");
+    if (!cp->log) 
+    {
+        printf("Error opening file %s for writing\n", cp->logPath);
+        exit(1);
+    }
+    if (fseek(cp->log, -1, SEEK_END) == 0 && fgetc(cp->log) != '\n') 
+    {
+        fseek(cp->log, 0, SEEK_END);
+        fputc('\n', cp->log);
+    }
+    
+    // Fold the recovered updates into the transaction file before accepting new ones
+    checkpointNow(cp);
+    pthread_create(&cp->thread, NULL, checkpointThread, cp);
+    return cp;
+}
+
+// Stop the checkpoint thread and write a final checkpoint; the log is removed if it succeeds
+bool closeCheckpointer(Checkpointer* cp) 
+{
+    pthread_mutex_lock(&cp->lock);
+    cp->stopping = true;
+    pthread_cond_signal(&cp->wake);
+    pthread_mutex_unlock(&cp->lock);
+    pthread_join(cp->thread, NULL);
+    
+    long written = cp->checkpoints;
+    bool ok = checkpointNow(cp);
+    fclose(cp->log);
+    if (ok) unlink(cp->logPath);
+    if (cp->checkpoints > written) printf("Checkpointed %ld transactions to %s\n", cp->lastRows, cp->path);
+    return ok;
+}
+
+void printCheckpointStats(const Checkpointer* cp) 
+{
+    printf("Checkpoints: %ld written every %g s (%ld failed), last %ld transactions, write avg %.1f ms max %.1f ms\n", 
+           cp->checkpoints, cp->interval, cp->failures, cp->lastRows, 
+           cp->checkpoints ? cp->writeNanos / 1e6 / cp->checkpoints : 0.0, cp->maxWriteNanos / 1e6);
+    printf("Longest writer pause for a log cut: %.1f us\n", cp->maxCutNanos / 1e3);
+}
+
+/*
+ * Batch query mode
+ *
+ * --batch loads an input file once, runs a list of queries given on the
+ * command line or in a query file, and streams each result to stdout as CSV
+ * or as one JSON object per line. Amounts are printed exactly, from the
+ * fixed-point values. Progress messages go to stderr so stdout stays parseable.
+ */
+
+typedef enum OutputFormat 
+{
+    OUTPUT_CSV,
+    OUTPUT_JSON
+} OutputFormat;
+
+// Streams the rows of one query result
+typedef struct QueryWriter 
+{
+    OutputFormat format;
+    FILE* out;
+    const char* const* columns;
+    int numColumns;
+    int rows;
+} QueryWriter;
+
+// Point stdout at fd, returning the saved descriptor for restoreStdout
+static int redirectStdout(int fd) 
+{
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    if (fd >= 0) dup2(fd, STDOUT_FILENO);
+    return saved;
+}
+
+// Point stdout at /dev/null, e.g. while a report runs in a benchmark
+static int silenceStdout(void) 
+{
+    int devnull = open("/dev/null", O_WRONLY);
+    int saved = redirectStdout(devnull);
+    if (devnull >= 0) close(devnull);
+    return saved;
+}
+
+static void restoreStdout(int saved) 
+{
+    fflush(stdout);
+    if (saved >= 0) 
+    {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+// Print a string as a JSON string literal
+static void printJsonString(FILE* out, const char* text) 
+{
+    fputc('"', out);
+    for (; *text; text++) 
+    {
+        if (*text == '"' || *text == '\\') fputc('\\', out);
+        fputc(*text, out);
+    }
+    fputc('"', out);
+}
+
+void beginQuery(QueryWriter* writer, const char* query, const char* const* columns, int numColumns) 
+{
+    writer->columns = columns;
+    writer->numColumns = numColumns;
+    writer->rows = 0;
+    
+    if (writer->format == OUTPUT_JSON) 
+    {
+        fprintf(writer->out, "{\"query\":");
+        printJsonString(writer->out, query);
+        fprintf(writer->out, ",\"rows\":[");
+        return;
+    }
+    
+    fprintf(writer->out, "# %s\n", query);
+    for (int i = 0; i < numColumns; i++) fprintf(writer->out, i ? ",%s" : "%s", columns[i]);
+    fprintf(writer->out, "\n");
+}
+
+// Write one row; values are numbers already formatted as text
+void writeQueryRow(QueryWriter* writer, const char* const* values) 
+{
+    if (writer->format == OUTPUT_JSON) 
+    {
+        fprintf(writer->out, writer->rows ? ",{" : "{");
+        for (int i = 0; i < writer->numColumns; i++) 
+        {
+            fprintf(writer->out, i ? ",\"%s\":%s" : "\"%s\":%s", writer->columns[i], values[i]);
+        }
+        fprintf(writer->out, "}");
+    } 
+    else 
+    {
+        for (int i = 0; i < writer->numColumns; i++) fprintf(writer->out, i ? ",%s" : "%s", values[i]);
+        fprintf(writer->out, "\n");
+    }
+    writer->rows++;
+}
+
+void endQuery(QueryWriter* writer, const char* error) 
+{
+    if (writer->format == OUTPUT_JSON) 
+    {
+        fprintf(writer->out, "]");
+        if (error) 
+        {
+            fprintf(writer->out, ",\"error\":");
+            printJsonString(writer->out, error);
+        }
+        fprintf(writer->out, "}\n");
+    } 
+    else if (error) 
+    {
+        fprintf(writer->out, "# error: %s\n", error);
+    }
+    fflush(writer->out);
+}
+
+static const char* const transactionColumns[] = {
+    "transaction_id", "buyer_id", "seller_id", "energy_kwh", "price_per_kwh", "total_price", "timestamp"
+};
+
+// Write a transaction as a row with transactionColumns
+static void writeTransactionRow(QueryWriter* writer, const Transaction* tx) 
+{
+    char id[16], buyer[16], seller[16], energy[32], price[32], total[32], timestamp[24];
+    sprintf(id, "%d", tx->transaction_id);
+    sprintf(buyer, "%d", tx->buyer_id);
+    sprintf(seller, "%d", tx->seller_id);
+    formatFixed(energy, tx->energy_wh, 3);
+    formatFixed(price, tx->price_micro, 6);
+    formatFixed(total, txTotalMicro(tx), 6);
+    sprintf(timestamp, "%lld", (long long)txTimestamp(tx));
+    const char* values[] = { id, buyer, seller, energy, price, total, timestamp };
+    writeQueryRow(writer, values);
+}
+
+// Visitor adapter for archived and per-entity transactions
+static void writeTransactionVisit(Transaction* tx, void* ctx) 
+{
+    writeTransactionRow((QueryWriter*)ctx, tx);
+}
+
+// Parse a unix timestamp or a YYYY-MM-DD date (local midnight; endOfDay adds 23:59:59)
+static bool parseQueryTime(const char* text, bool endOfDay, time_t* result) 
+{
+    struct tm tm = {0};
+    if (strlen(text) == 10 && text[4] == '-' && my_strptime(text, "%Y-%m-%d", &tm)) 
+    {
+        *result = mktime(&tm);
+        if (*result == -1) return false;
+        if (endOfDay) *result += 86399;
+        return true;
+    }
+    
+    char* end;
+    long long value = strtoll(text, &end, 10);
+    if (end == text || *end != '\0') return false;
+    *result = (time_t)value;
+    return true;
+}
+
+// Parse a whole query argument as an ID (any int)
+static bool parseQueryId(const char* text, int* result) 
+{
+    char* end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) return false;
+    *result = (int)value;
+    return true;
+}
+
+// Parse a whole query argument as a finite number, e.g. an energy in kWh
+static bool parseQueryNumber(const char* text, double* result) 
+{
+    char* end;
+    *result = strtod(text, &end);
+    return end != text && *end == '\0' && isfinite(*result);
+}
+
+// Visitor for the seller-revenue query: sums the seller's in-memory transactions
+static void addToTotals(Transaction* tx, void* ctx) 
+{
+    TimeRangeTotals* totals = (TimeRangeTotals*)ctx;
+    totals->count++;
+    totals->total_energy += tx->energy_wh;
+    totals->total_revenue += txTotalMicro(tx);
+}
+
+// The trees a batch runs against, and whether a query modified them
+typedef struct BatchContext 
+{
+    BTree* transactionTree;
+    BTree* sellerTree;
+    BTree* buyerTree;
+    PairTree* pairTree;
+    char* archivePath;            // <input>.archive
+    bool modified;
+    Checkpointer* checkpoint;     // Logs inserts and deletes, NULL unless checkpointing
+} BatchContext;
+
+// Create the trees of a transaction file and load it. Its archive is read first
+// (seller, buyer and pair aggregates, and the archived IDs), so rows of archived
+// transactions left in the file are refused rather than counted twice.
+ImportSummary openDataset(BatchContext* data, const char* input) 
+{
+    data->transactionTree = createBTree(ORDER/2, 'T');
+    data->sellerTree = createBTree(ORDER/2, 'S');
+    data->buyerTree = createBTree(ORDER/2, 'B');
+    data->pairTree = PairTreeCreate();
+    enableLookupIndexes(data->sellerTree, data->buyerTree, data->pairTree);
+    data->modified = false;
+    data->checkpoint = NULL;
+    
+    // transactions.txt used to keep its archive under a fixed name
+    data->archivePath = pathWithSuffix(input, ARCHIVE_SUFFIX);
+    if (strcmp(input, "transactions.txt") == 0 && access(data->archivePath, F_OK) != 0 && 
+        access(LEGACY_ARCHIVE_FILE, F_OK) == 0 && rename(LEGACY_ARCHIVE_FILE, data->archivePath) == 0) 
+    {
+        printf("Moved %s to %s\n", LEGACY_ARCHIVE_FILE, data->archivePath);
+    }
+    
+    freeHashIndex(archivedIds);
+    archivedIds = NULL;
+    int archived = loadArchiveAggregates(data->archivePath, data->sellerTree, data->buyerTree, data->pairTree);
+    if (archived > 0) printf("Loaded aggregates for %d archived transactions\n", archived);
+    
+    return importTransactionsFrom(input, data->transactionTree, data->sellerTree, data->buyerTree, data->pairTree);
+}
+
+/*
+ * Run one query:
+ *   transaction:ID  seller:ID  buyer:ID      point lookups (seller/buyer totals include the archive)
+ *   time-range:FROM:TO                       FROM/TO as YYYY-MM-DD or unix seconds, archive included
+ *   seller-revenue:ID                        totals of one seller's in-memory transactions only
+ *   energy-range:MIN:MAX                     transactions sorted by energy (kWh)
+ *   buyers-by-energy[:N]  pairs-by-count[:N] ascending rankings, optionally the first N
+ *   insert:ID,BUYER,SELLER,KWH,PRICE[,TS]   add a transaction (TS defaults to now)
+ *   delete:ID                                remove a transaction
+ * Returns false if the query is malformed, including numbers with trailing text.
+ */
+bool runQuery(BatchContext* batch, QueryWriter* writer, const char* query) 
+{
+    char name[32], arg1[64] = "", arg2[64] = "";
+    int fields = sscanf(query, "%31[^:]:%63[^:]:%63s", name, arg1, arg2);
+    if (fields < 1) return false;
+    
+    if (strcmp(name, "transaction") == 0 && fields == 2) 
+    {
+        int transaction_id;
+        if (!parseQueryId(arg1, &transaction_id)) return false;
+        
+        beginQuery(writer, query, transactionColumns, 7);
+        Transaction* tx = searchTransaction(batch->transactionTree, transaction_id);
+        if (tx) writeTransactionRow(writer, tx);
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "seller") == 0 && fields == 2) 
+    {
+        static const char* const columns[] = { "seller_id", "transactions", "revenue", "rate_below_300", "rate_above_300" };
+        int seller_id;
+        if (!parseQueryId(arg1, &seller_id)) return false;
+        
+        beginQuery(writer, query, columns, 5);
+        Seller* seller = searchSeller(batch->sellerTree, seller_id);
+        if (seller) 
+        {
+            char id[16], count[16], revenue[32], below[32], above[32];
+            sprintf(id, "%d", seller->seller_id);
+            sprintf(count, "%d", seller->transactions.count);
+            formatFixed(revenue, seller->total_revenue, 6);
+            formatFixed(below, seller->rate_below_300, 6);
+            formatFixed(above, seller->rate_above_300, 6);
+            const char* values[] = { id, count, revenue, below, above };
+            writeQueryRow(writer, values);
+        }
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "buyer") == 0 && fields == 2) 
+    {
+        static const char* const columns[] = { "buyer_id", "transactions", "energy_kwh" };
+        int buyer_id;
+        if (!parseQueryId(arg1, &buyer_id)) return false;
+        
+        beginQuery(writer, query, columns, 3);
+        Buyer* buyer = searchBuyer(batch->buyerTree, buyer_id);
+        if (buyer) 
+        {
+            char id[16], count[16], energy[32];
+            sprintf(id, "%d", buyer->buyer_id);
+            sprintf(count, "%d", buyer->transactions.count);
+            formatFixed(energy, buyer->total_energy_purchased, 3);
+            const char* values[] = { id, count, energy };
+            writeQueryRow(writer, values);
+        }
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "time-range") == 0 && fields == 3) 
+    {
+        time_t from, to;
+        if (!parseQueryTime(arg1, false, &from) || !parseQueryTime(arg2, true, &to)) return false;
+        
+        beginQuery(writer, query, transactionColumns, 7);
+        Node* current = batch->transactionTree->root;
+        while (!current->leaf) current = current->children[0];
+        for (; current != NULL; current = current->next) 
+        {
+            for (int i = 0; i < current->n; i++) 
+            {
+                Transaction* tx = (Transaction*)current->records[i];
+                time_t timestamp = txTimestamp(tx);
+                if (timestamp >= from && timestamp <= to) writeTransactionRow(writer, tx);
+            }
+        }
+        forEachArchivedTransaction(batch->archivePath, from, to, writeTransactionVisit, writer);
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "seller-revenue") == 0 && fields == 2) 
+    {
+        static const char* const columns[] = { "seller_id", "transactions", "energy_kwh", "revenue" };
+        int seller_id;
+        if (!parseQueryId(arg1, &seller_id)) return false;
+        
+        TimeRangeTotals totals = { 0, 0, 0, NULL };
+        Seller* seller = searchSeller(batch->sellerTree, seller_id);
+        if (seller) forEachInTransactionSet(&seller->transactions, addToTotals, &totals);
+        
+        char id[16], count[16], energy[32], revenue[32];
+        sprintf(id, "%d", seller_id);
+        sprintf(count, "%d", totals.count);
+        formatFixed(energy, totals.total_energy, 3);
+        formatFixed(revenue, totals.total_revenue, 6);
+        const char* values[] = { id, count, energy, revenue };
+        beginQuery(writer, query, columns, 4);
+        writeQueryRow(writer, values);
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "energy-range") == 0 && fields == 3) 
+    {
+        double min_kwh, max_kwh;
+        if (!parseQueryNumber(arg1, &min_kwh) || !parseQueryNumber(arg2, &max_kwh)) return false;
+        int32_t min_wh = toEnergyWh(min_kwh);
+        int32_t max_wh = toEnergyWh(max_kwh);
+        
+        int count = 0;
+        long scanned = 0;
+        Transaction** matches = collectTransactionsByEnergy(sharedScanPool(), batch->transactionTree, min_wh, max_wh, &count, &scanned);
+        
+        beginQuery(writer, query, transactionColumns, 7);
+        if (!matches) 
+        {
+            endQuery(writer, "memory allocation failed");
+            return true;
+        }
+        for (int i = 0; i < count; i++) writeTransactionRow(writer, matches[i]);
+        endQuery(writer, NULL);
+        free(matches);
+        return true;
+    }
+    
+    if (strcmp(name, "buyers-by-energy") == 0 || strcmp(name, "pairs-by-count") == 0) 
+    {
+        bool buyers = name[0] == 'b';
+        int limit = INT_MAX;
+        if (fields >= 2 && (!parseQueryId(arg1, &limit) || limit < 0)) return false;
+        
+        // Collect records along the leaf chain, keyed by the ranking value
+        int count = 0, capacity = 64;
+        SortEntry* items = (SortEntry*)malloc(capacity * sizeof(SortEntry));
+        if (buyers) 
+        {
+            Node* current = batch->buyerTree->root;
+            while (!current->leaf) current = current->children[0];
+            for (; current != NULL && items; current = current->next) 
+            {
+                for (int i = 0; i < current->n && items; i++) 
+                {
+                    if (count == capacity) items = (SortEntry*)realloc(items, (capacity *= 2) * sizeof(SortEntry));
+                    if (!items) break;
+                    Buyer* buyer = (Buyer*)current->records[i];
+                    items[count].key = signedSortKey(buyer->total_energy_purchased);
+                    items[count++].item = buyer;
+                }
+            }
+        } 
+        else 
+        {
+            for (PairTreeNode* current = PairTreeFirstLeaf(batch->pairTree); current != NULL && items; current = current->next) 
+            {
+                for (int i = 0; i < current->n && items; i++) 
+                {
+                    if (count == capacity) items = (SortEntry*)realloc(items, (capacity *= 2) * sizeof(SortEntry));
+                    if (!items) break;
+                    items[count].key = signedSortKey(current->values[i].number_of_transactions);
+                    items[count++].item = &current->values[i];
+                }
+            }
+        }
+        
+        static const char* const buyerColumns[] = { "buyer_id", "energy_kwh" };
+        static const char* const pairColumns[] = { "seller_id", "buyer_id", "transactions" };
+        beginQuery(writer, query, buyers ? buyerColumns : pairColumns, buyers ? 2 : 3);
+        if (!items || !sortEntries(items, count, sharedScanPool())) 
+        {
+            endQuery(writer, "memory allocation failed");
+            free(items);
+            return true;
+        }
+        for (int i = 0; i < count && i < limit; i++) 
+        {
+            char a[16], b[32], c[16];
+            if (buyers) 
+            {
+                const Buyer* buyer = (const Buyer*)items[i].item;
+                sprintf(a, "%d", buyer->buyer_id);
+                formatFixed(b, buyer->total_energy_purchased, 3);
+            } 
+            else 
+            {
+                const SellerBuyerPair* pair = (const SellerBuyerPair*)items[i].item;
+                sprintf(a, "%d", pair->seller_id);
+                sprintf(b, "%d", pair->buyer_id);
+                sprintf(c, "%d", pair->number_of_transactions);
+            }
+            const char* values[] = { a, b, c };
+            writeQueryRow(writer, values);
+        }
+        endQuery(writer, NULL);
+        free(items);
+        return true;
+    }
+    
+    if (strcmp(name, "insert") == 0 && fields == 2) 
+    {
+        int transaction_id, buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        long long timestamp = (long long)time(NULL);
+        int parsed = sscanf(arg1, "%d,%d,%d,%lf,%lf,%lld", &transaction_id, &buyer_id, &seller_id, 
+                            &energy_kwh, &price_per_kwh, &timestamp);
+        if (parsed < 5) return false;
+        
+        static const char* const columns[] = { "transaction_id", "inserted" };
+        const char* error = NULL;
+        bool inserted = false;
+        if (!isValidTimestamp((time_t)timestamp)) error = "timestamp out of range";
+        else if (searchTransaction(batch->transactionTree, transaction_id)) error = "transaction ID already exists";
+        else if (isArchivedTransaction(transaction_id)) error = "transaction ID is archived";
+        else 
+        {
+            Transaction* tx = createTransaction(transaction_id, buyer_id, seller_id, energy_kwh, price_per_kwh, (time_t)timestamp);
+            upsertTransaction(batch->transactionTree, tx, batch->sellerTree, batch->buyerTree, batch->pairTree);
+            logUpsert(batch->checkpoint, tx);
+            inserted = batch->modified = true;
+        }
+        
+        char id[16];
+        sprintf(id, "%d", transaction_id);
+        const char* values[] = { id, inserted ? "true" : "false" };
+        beginQuery(writer, query, columns, 2);
+        writeQueryRow(writer, values);
+        endQuery(writer, error);
+        return true;
+    }
+    
+    if (strcmp(name, "memory") == 0 && fields == 1) 
+    {
+        static const char* const columns[] = { "structure", "allocations", "bytes", "bytes_per_transaction" };
+        MemoryFootprint footprint;
+        collectMemoryFootprint(&footprint, batch->transactionTree, batch->sellerTree, batch->buyerTree, batch->pairTree);
+        
+        beginQuery(writer, query, columns, 4);
+        long allocations = 0;
+        for (int c = 0; c <= NUM_MEMORY_CATEGORIES; c++) 
+        {
+            bool total = c == NUM_MEMORY_CATEGORIES;
+            char structure[40], count[24], bytes[24], perTransaction[24];
+            sprintf(structure, writer->format == OUTPUT_JSON ? "\"%s\"" : "%s", total ? "total" : memoryCategoryKeys[c]);
+            sprintf(count, "%ld", total ? allocations : footprint.allocations[c]);
+            sprintf(bytes, "%zu", total ? footprint.totalBytes : footprint.bytes[c]);
+            sprintf(perTransaction, "%.1f", footprintPerTransaction(&footprint, total ? footprint.totalBytes : footprint.bytes[c]));
+            if (!total) allocations += footprint.allocations[c];
+            
+            const char* values[] = { structure, count, bytes, perTransaction };
+            writeQueryRow(writer, values);
+        }
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    if (strcmp(name, "delete") == 0 && fields == 2) 
+    {
+        static const char* const columns[] = { "transaction_id", "deleted" };
+        int transaction_id;
+        if (!parseQueryId(arg1, &transaction_id)) return false;
+        
+        bool deleted = deleteTransaction(batch->transactionTree, transaction_id, 
+                                         batch->sellerTree, batch->buyerTree, batch->pairTree);
+        batch->modified |= deleted;
+        if (deleted) logDelete(batch->checkpoint, transaction_id);
+        
+        const char* values[] = { arg1, deleted ? "true" : "false" };
+        beginQuery(writer, query, columns, 2);
+        writeQueryRow(writer, values);
+        endQuery(writer, NULL);
+        return true;
+    }
+    
+    return false;
+}
+
+// Whether a query changes the trees (and needs exclusive access to them)
+bool queryModifies(const char* query) 
+{
+    return strncmp(query, "insert:", 7) == 0 || strncmp(query, "delete:", 7) == 0;
+}
+
+// Run a batch: returns the process exit status
+int runBatch(int argc, char* argv[]) 
+{
+    const char* input = "transactions.txt";
+    const char* output = NULL;
+    const char* queryFile = NULL;
+    QueryWriter writer = { OUTPUT_CSV, stdout, NULL, 0, 0 };
+    
+    int firstQuery = argc;
+    for (int i = 0; i < argc; i++) 
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input = argv[++i];
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) output = argv[++i];
+        else if (strcmp(argv[i], "--queries") == 0 && i + 1 < argc) queryFile = argv[++i];
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) 
+        {
+            i++;
+            if (strcmp(argv[i], "json") == 0) writer.format = OUTPUT_JSON;
+            else if (strcmp(argv[i], "csv") != 0) 
+            {
+                fprintf(stderr, "Unknown format: %s (use csv or json)\n", argv[i]);
+                return 1;
+            }
+        } 
+        else 
+        {
+            firstQuery = i;
+            break;
+        }
+    }
+    
+    // Load once, with progress messages on stderr
+    BatchContext batch;
+    int saved = redirectStdout(STDERR_FILENO);
+    ImportSummary summary = openDataset(&batch, input);
+    restoreStdout(saved);
+    if (!summary.opened) return 1;
+    
+    int failed = 0;
+    for (int i = firstQuery; i < argc; i++) 
+    {
+        if (!runQuery(&batch, &writer, argv[i])) 
+        {
+            fprintf(stderr, "Invalid query: %s\n", argv[i]);
+            failed++;
+        }
+    }
+    
+    if (queryFile) 
+    {
+        FILE* file = fopen(queryFile, "r");
+        if (!file) 
+        {
+            fprintf(stderr, "Error opening file %s for reading\n", queryFile);
+            return 1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), file) != NULL) 
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (line[0] == '\0' || line[0] == '#') continue;
+            if (!runQuery(&batch, &writer, line)) 
+            {
+                fprintf(stderr, "Invalid query: %s\n", line);
+                failed++;
+            }
+        }
+        fclose(file);
+    }
+    
+    // Rewrite only if the data differs from what the output file would already hold
+    bool sameFile = output && strcmp(output, input) == 0;
+    bool normalized = summary.updated > 0 || summary.unchanged > 0 || summary.skipped > 0;
+    if (output && (!sameFile || batch.modified || normalized)) 
+    {
+        saved = redirectStdout(STDERR_FILENO);
+        if (exportTransactionsTo(batch.transactionTree, output) < 0) failed++;
+        restoreStdout(saved);
+    } 
+    else if (output) 
+    {
+        fprintf(stderr, "No changes, %s left as is\n", output);
+    }
+    
+    return failed ? 1 : 0;
+}
+
+/*
+ * Query server
+ *
+ * --serve keeps the trees resident and answers the batch queries over a Unix
+ * domain socket with a line protocol: each request line is one query (or
+ * "format csv|json", "export [path]", "quit"), and each response is the
+ * query's CSV result followed by an empty line, or one JSON line. The main
+ * thread runs a poll() event loop that accepts clients and reads requests; a
+ * pool of worker threads runs the queries under a readers-writer lock, so
+ * lookups and reports run concurrently while inserts and deletes are
+ * exclusive. "export" writes a snapshot of the transaction tree and holds no
+ * lock while writing. With a checkpoint interval, inserts and deletes are
+ * logged and a checkpointer persists the trees in the background; exporting
+ * the input file then forces a checkpoint; other exports go to files in
+ * SERVER_EXPORT_DIR. Each client has at most one
+ * request in flight, which keeps its responses in order.
+ */
+
+#define SERVER_SOCKET "energy_trading.sock"
+#define SERVER_WORKERS 4
+#define SERVER_MAX_CLIENTS 256
+#define SERVER_LINE_MAX 256
+#define SERVER_EXPORT_DIR "exports"   // "export NAME" writes SERVER_EXPORT_DIR/NAME
+
+typedef struct ServerClient 
+{
+    int fd;                       // -1 when the slot is free
+    char buffer[SERVER_LINE_MAX]; // Bytes received but not yet dispatched
+    int length;
+    bool busy;                    // A worker is handling one of its requests
+    bool closing;                 // Close once the in-flight request is answered
+    bool discarding;              // Skipping the rest of a line too long for the buffer
+    bool overlong;                // Such a line has ended and still needs its answer
+    OutputFormat format;
+} ServerClient;
+
+typedef struct ServerJob 
+{
+    int client;                   // Index into QueryServer.clients
+    char query[SERVER_LINE_MAX];
+    bool rejected;                // Answer "invalid query" without running it
+    struct ServerJob* next;
+} ServerJob;
+
+typedef struct QueryServer 
+{
+    BatchContext batch;
+    pthread_rwlock_t treeLock;
+    pthread_mutex_t queueLock;
+    pthread_cond_t queueReady;
+    ServerJob* head;
+    ServerJob* tail;
+    bool stopping;
+    const char* exportPath;       // File written by a bare "export" request
+    int wakePipe[2];              // Workers write a client index here when done
+    ServerClient clients[SERVER_MAX_CLIENTS];
+} QueryServer;
+
+static volatile sig_atomic_t serverInterrupted = 0;
+
+static void handleServerSignal(int signal) 
+{
+    (void)signal;
+    serverInterrupted = 1;
+}
+
+// Send a whole buffer, ignoring a client that has gone away
+static void sendAll(int fd, const char* data, size_t length) 
+{
+    while (length > 0) 
+    {
+        ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return;
+        data += sent;
+        length -= (size_t)sent;
+    }
+}
+
+// A name "export NAME" may write: a plain file name, so the file stays in SERVER_EXPORT_DIR
+static bool validExportName(const char* name) 
+{
+    return name[0] != '\0' && name[0] != '.' && strchr(name, '/') == NULL;
+}
+
+// Whether two paths name the same file, however they are spelled
+static bool sameFile(const char* a, const char* b) 
+{
+    struct stat first, second;
+    return stat(a, &first) == 0 && stat(b, &second) == 0 && 
+           first.st_dev == second.st_dev && first.st_ino == second.st_ino;
+}
+
+// Run one request and send the response; called by workers
+static void serveRequest(QueryServer* server, ServerClient* client, const ServerJob* job) 
+{
+    const char* query = job->query;
+    char* response = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&response, &length);
+    if (!out) return;
+    
+    if (job->rejected) 
+    {
+        QueryWriter writer = { client->format, out, NULL, 0, 0 };
+        beginQuery(&writer, query, NULL, 0);
+        endQuery(&writer, "invalid query");
+        if (writer.format == OUTPUT_CSV) fputc('\n', out);
+    } 
+    else if (strncmp(query, "format ", 7) == 0) 
+    {
+        // Only this client's worker touches its format while it is busy
+        if (strcmp(query + 7, "json") == 0) client->format = OUTPUT_JSON;
+        else if (strcmp(query + 7, "csv") == 0) client->format = OUTPUT_CSV;
+        fprintf(out, client->format == OUTPUT_JSON ? "{\"format\":\"json\"}\n" : "# format csv\n\n");
+    } 
+    else if (strcmp(query, "export") == 0 || strncmp(query, "export ", 7) == 0) 
+    {
+        // Write a snapshot without the tree lock, so updates carry on during the write.
+        // Every file is replaced atomically. The transaction file, however it is named,
+        // is written only by a checkpoint when there is a checkpointer: it deletes the
+        // log that the file must cover.
+        static const char* const columns[] = { "transactions" };
+        const char* name = query[6] ? query + 7 : NULL;
+        char path[sizeof(SERVER_EXPORT_DIR) + SERVER_LINE_MAX];
+        bool valid = !name || validExportName(name);
+        if (name && valid) 
+        {
+            snprintf(path, sizeof(path), "%s/%s", SERVER_EXPORT_DIR, name);
+            mkdir(SERVER_EXPORT_DIR, 0755);
+        }
+        bool inputFile = !name || (valid && sameFile(path, server->exportPath));
+        
+        long count = -1;
+        if (inputFile && server->batch.checkpoint) 
+        {
+            count = forceCheckpoint(server->batch.checkpoint);
+        } 
+        else if (valid) 
+        {
+            TreeSnapshot* snapshot = takeSnapshot(server->batch.transactionTree);
+            count = replaceWithSnapshot(snapshot, inputFile ? server->exportPath : path);
+            releaseSnapshot(snapshot);
+        }
+        
+        QueryWriter writer = { client->format, out, NULL, 0, 0 };
+        beginQuery(&writer, query, columns, 1);
+        if (!valid) 
+        {
+            endQuery(&writer, "invalid export name");
+        } 
+        else if (count < 0) 
+        {
+            endQuery(&writer, "cannot write export file");
+        } 
+        else 
+        {
+            char written[24];
+            sprintf(written, "%ld", count);
+            const char* values[] = { written };
+            writeQueryRow(&writer, values);
+            endQuery(&writer, NULL);
+        }
+        if (writer.format == OUTPUT_CSV) fputc('\n', out);
+    } 
+    else 
+    {
+        QueryWriter writer = { client->format, out, NULL, 0, 0 };
+        bool exclusive = queryModifies(query);
+        if (exclusive) 
+        {
+            pthread_rwlock_wrlock(&server->treeLock);
+            beginLoggedUpdate(server->batch.checkpoint);
+        } 
+        else 
+        {
+            pthread_rwlock_rdlock(&server->treeLock);
+        }
+        bool valid = runQuery(&server->batch, &writer, query);
+        if (exclusive) endLoggedUpdate(server->batch.checkpoint);
+        pthread_rwlock_unlock(&server->treeLock);
+        
+        if (!valid) 
+        {
+            beginQuery(&writer, query, NULL, 0);
+            endQuery(&writer, "invalid query");
+        }
+        if (writer.format == OUTPUT_CSV) fputc('\n', out);
+    }
+    
+    fclose(out);
+    sendAll(client->fd, response, length);
+    free(response);
+}
+
+static void* serverWorker(void* arg) 
+{
+    QueryServer* server = (QueryServer*)arg;
+    while (1) 
+    {
+        pthread_mutex_lock(&server->queueLock);
+        while (!server->head && !server->stopping) pthread_cond_wait(&server->queueReady, &server->queueLock);
+        if (!server->head) 
+        {
+            pthread_mutex_unlock(&server->queueLock);
+            return NULL;
+        }
+        ServerJob* job = server->head;
+        server->head = job->next;
+        if (!server->head) server->tail = NULL;
+        pthread_mutex_unlock(&server->queueLock);
+        
+        serveRequest(server, &server->clients[job->client], job);
+        
+        // Hand the client back to the event loop
+        int index = job->client;
+        free(job);
+        while (write(server->wakePipe[1], &index, sizeof(index)) < 0 && errno == EINTR);
+    }
+}
+
+// If the client has a complete request line buffered (or an over-long line to
+// answer), queue it; returns true if queued
+static bool dispatchRequest(QueryServer* server, int index) 
+{
+    ServerClient* client = &server->clients[index];
+    char* newline = client->overlong ? NULL : memchr(client->buffer, '\n', client->length);
+    if (!newline && !client->overlong) return false;
+    
+    ServerJob* job = (ServerJob*)malloc(sizeof(ServerJob));
+    if (!job) 
+    {
+        printf("Memory allocation failed for ServerJob\n");
+        exit(1);
+    }
+    job->client = index;
+    job->next = NULL;
+    job->rejected = client->overlong;
+    if (client->overlong) 
+    {
+        // The line itself was discarded as it arrived; only its answer is left
+        snprintf(job->query, sizeof(job->query), "(line longer than %d bytes)", SERVER_LINE_MAX - 1);
+        client->overlong = false;
+    } 
+    else 
+    {
+        int lineLength = (int)(newline - client->buffer);
+        memcpy(job->query, client->buffer, lineLength);
+        job->query[lineLength] = '\0';
+        if (lineLength > 0 && job->query[lineLength - 1] == '\r') job->query[lineLength - 1] = '\0';
+        
+        client->length -= lineLength + 1;
+        memmove(client->buffer, newline + 1, client->length);
+    }
+    
+    if (!job->rejected && (strcmp(job->query, "quit") == 0 || job->query[0] == '\0')) 
+    {
+        if (job->query[0] != '\0') client->closing = true;
+        free(job);
+        return false;
+    }
+    
+    client->busy = true;
+    pthread_mutex_lock(&server->queueLock);
+    if (server->tail) server->tail->next = job;
+    else server->head = job;
+    server->tail = job;
+    pthread_cond_signal(&server->queueReady);
+    pthread_mutex_unlock(&server->queueLock);
+    return true;
+}
+
+static void closeClient(ServerClient* client) 
+{
+    close(client->fd);
+    client->fd = -1;
+    client->length = 0;
+    client->busy = false;
+    client->closing = false;
+    client->discarding = false;
+    client->overlong = false;
+}
+
+// Queue the client's next buffered request, closing it if it asked to quit
+static void resumeClient(QueryServer* server, int index) 
+{
+    ServerClient* client = &server->clients[index];
+    while (!client->busy && !client->closing && (client->length > 0 || client->overlong)) 
+    {
+        if (!dispatchRequest(server, index)) 
+        {
+            if (!memchr(client->buffer, '\n', client->length)) break;
+        }
+    }
+    if (client->closing && !client->busy) closeClient(client);
+}
+
+// Serve queries on socketPath until SIGINT/SIGTERM; returns the exit status
+int runServer(const char* socketPath, const char* input, int workers, double checkpointInterval) 
+{
+    QueryServer* server = (QueryServer*)calloc(1, sizeof(QueryServer));
+    if (!server) 
+    {
+        printf("Memory allocation failed for QueryServer\n");
+        return 1;
+    }
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) server->clients[i].fd = -1;
+    
+    ImportSummary summary = openDataset(&server->batch, input);
+    if (!summary.opened) return 1;
+    server->exportPath = input;
+    enableSnapshots(server->batch.transactionTree);
+    
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || strlen(socketPath) >= sizeof(address.sun_path)) 
+    {
+        printf("Error creating socket %s\n", socketPath);
+        return 1;
+    }
+    strcpy(address.sun_path, socketPath);
+    unlink(socketPath);
+    if (bind(listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0 || 
+        pipe(server->wakePipe) < 0) 
+    {
+        printf("Error listening on %s\n", socketPath);
+        return 1;
+    }
+    
+    pthread_rwlock_init(&server->treeLock, NULL);
+    pthread_mutex_init(&server->queueLock, NULL);
+    pthread_cond_init(&server->queueReady, NULL);
+    
+    // Workers and the checkpoint thread start with SIGINT/SIGTERM blocked so the signal interrupts poll() in this thread
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleServerSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigset_t stopSignals, previousMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+    
+    if (checkpointInterval > 0) 
+    {
+        server->batch.checkpoint = openCheckpointer(input, checkpointInterval, server->batch.transactionTree, 
+                                                    server->batch.sellerTree, server->batch.buyerTree, server->batch.pairTree);
+    }
+    pthread_t threads[64];
+    if (workers < 1) workers = 1;
+    if (workers > 64) workers = 64;
+    for (int i = 0; i < workers; i++) pthread_create(&threads[i], NULL, serverWorker, server);
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+    
+    printf("Serving %d transactions on %s with %d workers\n", summary.inserted, socketPath, workers);
+    fflush(stdout);
+    
+    struct pollfd fds[SERVER_MAX_CLIENTS + 2];
+    int owners[SERVER_MAX_CLIENTS + 2];
+    while (!serverInterrupted) 
+    {
+        int count = 0;
+        fds[count].fd = listener;
+        fds[count].events = POLLIN;
+        owners[count++] = -1;
+        fds[count].fd = server->wakePipe[0];
+        fds[count].events = POLLIN;
+        owners[count++] = -1;
+        for (int i = 0; i < SERVER_MAX_CLIENTS; i++) 
+        {
+            // Busy clients are not read from until their response is sent
+            if (server->clients[i].fd < 0 || server->clients[i].busy) continue;
+            fds[count].fd = server->clients[i].fd;
+            fds[count].events = POLLIN;
+            owners[count++] = i;
+        }
+        
+        if (poll(fds, count, -1) < 0) 
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        if (fds[0].revents & POLLIN) 
+        {
+            int fd = accept(listener, NULL, NULL);
+            int slot = 0;
+            while (slot < SERVER_MAX_CLIENTS && server->clients[slot].fd >= 0) slot++;
+            if (fd >= 0 && slot == SERVER_MAX_CLIENTS) close(fd);
+            else if (fd >= 0) 
+            {
+                server->clients[slot].fd = fd;
+                server->clients[slot].format = OUTPUT_CSV;
+            }
+        }
+        
+        if (fds[1].revents & POLLIN) 
+        {
+            int index;
+            if (read(server->wakePipe[0], &index, sizeof(index)) == sizeof(index)) 
+            {
+                server->clients[index].busy = false;
+                resumeClient(server, index);
+            }
+        }
+        
+        for (int i = 2; i < count; i++) 
+        {
+            if (!fds[i].revents) continue;
+            ServerClient* client = &server->clients[owners[i]];
+            ssize_t received = read(client->fd, client->buffer + client->length, SERVER_LINE_MAX - client->length);
+            if (received <= 0) 
+            {
+                closeClient(client);
+                continue;
+            }
+            client->length += (int)received;
+            
+            // A line that cannot fit in the buffer is skipped up to its newline and
+            // then answered as invalid, in order with the client's other requests
+            if (client->discarding) 
+            {
+                char* newline = memchr(client->buffer, '\n', client->length);
+                if (!newline) 
+                {
+                    client->length = 0;
+                    continue;
+                }
+                client->length -= (int)(newline + 1 - client->buffer);
+                memmove(client->buffer, newline + 1, client->length);
+                client->discarding = false;
+                client->overlong = true;
+            } 
+            else if (client->length == SERVER_LINE_MAX && !memchr(client->buffer, '\n', client->length)) 
+            {
+                client->discarding = true;
+                client->length = 0;
+                continue;
+            }
+            resumeClient(server, owners[i]);
+        }
+    }
+    
+    // Drain the workers, then persist any inserts and deletes
+    pthread_mutex_lock(&server->queueLock);
+    server->stopping = true;
+    pthread_cond_broadcast(&server->queueReady);
+    pthread_mutex_unlock(&server->queueLock);
+    for (int i = 0; i < workers; i++) pthread_join(threads[i], NULL);
+    
+    for (int i = 0; i < SERVER_MAX_CLIENTS; i++) 
+    {
+        if (server->clients[i].fd >= 0) close(server->clients[i].fd);
+    }
+    close(listener);
+    unlink(socketPath);
+    
+    // Without a checkpointer the input file is replaced atomically; if that fails it keeps
+    // the data as loaded, and the exit status reports the lost updates
+    int status = 0;
+    if (server->batch.checkpoint) 
+    {
+        closeCheckpointer(server->batch.checkpoint);
+        printCheckpointStats(server->batch.checkpoint);
+    } 
+    else if (server->batch.modified && exportTransactionsTo(server->batch.transactionTree, input) < 0) 
+    {
+        status = 1;
+    }
+    printf("Server stopped\n");
+    return status;
+}
+
+/*
+ * Streaming ingest
+ *
+ * --ingest reads transactions from stdin or from producers connecting to a
+ * Unix domain socket, either as newline-delimited lines in the
+ * transactions.txt format or, with --length-prefixed, as the same lines each
+ * preceded by a 4-byte big-endian length. A reader thread parses records
+ * into a bounded queue; the main thread drains it in micro-batches through
+ * upsertTransaction/processTransaction. When the queue is full the reader
+ * stops reading, so a fast producer is slowed down by the socket or pipe
+ * buffer instead of growing memory. An optional seventh field carries the
+ * producer's send time (CLOCK_REALTIME, ns) for end-to-end latency;
+ * otherwise latency is measured from the moment the record was read. With
+ * --checkpoint SECONDS each micro-batch is logged and a checkpointer persists
+ * the trees in the background instead of one export at the end.
+ */
+
+#define INGEST_QUEUE_CAPACITY 65536
+#define INGEST_BATCH_SIZE 1024
+#define INGEST_REPORT_SECONDS 1.0
+
+// Log-linear latency histogram: 16 sub-buckets per power of two (about 6% resolution)
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_BUCKETS (64 << HISTOGRAM_SUB_BITS)
+
+typedef struct LatencyHistogram 
+{
+    uint64_t count;
+    uint64_t max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+} LatencyHistogram;
+
+static int histogramBucket(uint64_t value) 
+{
+    if (value < (1u << HISTOGRAM_SUB_BITS)) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int)(value >> (exponent - HISTOGRAM_SUB_BITS)) & ((1 << HISTOGRAM_SUB_BITS) - 1);
+    return ((exponent - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) + sub;
+}
+
+// Smallest value of a bucket
+static uint64_t histogramBucketValue(int bucket) 
+{
+    if (bucket < (1 << HISTOGRAM_SUB_BITS)) return (uint64_t)bucket;
+    int exponent = (bucket >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+    uint64_t sub = bucket & ((1 << HISTOGRAM_SUB_BITS) - 1);
+    return (((uint64_t)1 << HISTOGRAM_SUB_BITS) | sub) << (exponent - HISTOGRAM_SUB_BITS);
+}
+
+void histogramRecord(LatencyHistogram* histogram, uint64_t value) 
+{
+    histogram->count++;
+    if (value > histogram->max) histogram->max = value;
+    histogram->buckets[histogramBucket(value)]++;
+}
+
+uint64_t histogramPercentile(const LatencyHistogram* histogram, double fraction) 
+{
+    uint64_t target = (uint64_t)(histogram->count * fraction);
+    uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) 
+    {
+        seen += histogram->buckets[b];
+        if (seen > target) return histogramBucketValue(b);
+    }
+    return histogram->max;
+}
+
+static uint64_t monotonicNanos(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t realtimeNanos(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// One parsed record waiting to be applied
+typedef struct IngestRecord 
+{
+    int transaction_id;
+    int buyer_id;
+    int seller_id;
+    double energy_kwh;
+    double price_per_kwh;
+    bool autoPrice;               // Price given as "auto": quoted from the seller's tariff or rates
+    long long timestamp;
+    uint64_t start_ns;            // CLOCK_REALTIME send or receive time
+} IngestRecord;
+
+typedef struct IngestQueue 
+{
+    IngestRecord* records;        // Ring buffer
+    int capacity;
+    int head;
+    int count;
+    bool closed;                  // No more records will be pushed
+    long stalls;                  // Times the reader waited on a full queue
+    long rejected;                // Unparseable lines
+    pthread_mutex_t lock;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+} IngestQueue;
+
+typedef struct IngestSource 
+{
+    IngestQueue* queue;
+    int fd;                       // stdin, or -1 to accept producers on listener
+    int listener;
+    bool lengthPrefixed;
+} IngestSource;
+
+static volatile sig_atomic_t ingestInterrupted = 0;
+
+static void handleIngestSignal(int signal) 
+{
+    (void)signal;
+    ingestInterrupted = 1;
+}
+
+// Parse one transactions.txt line with an optional send time; the price may be "auto"
+static bool parseIngestRecord(const char* line, IngestRecord* record) 
+{
+    unsigned long long sent = 0;
+    int fields = sscanf(line, "%d,%d,%d,%lf,%lf,%lld,%llu", &record->transaction_id, &record->buyer_id, 
+                        &record->seller_id, &record->energy_kwh, &record->price_per_kwh, &record->timestamp, &sent);
+    record->autoPrice = false;
+    if (fields == 4) 
+    {
+        fields = sscanf(line, "%d,%d,%d,%lf,auto,%lld,%llu", &record->transaction_id, &record->buyer_id, 
+                        &record->seller_id, &record->energy_kwh, &record->timestamp, &sent) + 1;
+        record->autoPrice = true;
+    }
+    if (fields < 6 || !isValidTimestamp((time_t)record->timestamp)) return false;
+    record->start_ns = fields == 7 ? (uint64_t)sent : realtimeNanos();
+    return true;
+}
+
+// Push a record, waiting while the queue is full
+static void ingestPush(IngestQueue* queue, const IngestRecord* record) 
+{
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count == queue->capacity) queue->stalls++;
+    while (queue->count == queue->capacity) pthread_cond_wait(&queue->notFull, &queue->lock);
+    queue->records[(queue->head + queue->count) % queue->capacity] = *record;
+    queue->count++;
+    pthread_cond_signal(&queue->notEmpty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Read one producer until end of stream
+static void ingestStream(IngestSource* source, int fd) 
+{
+    char buffer[65536];
+    char line[SERVER_LINE_MAX];
+    int length = 0;
+    uint32_t expected = 0;        // Remaining payload bytes of a length-prefixed record
+    int headerBytes = 0;
+    unsigned char header[4];
+    ssize_t received;
+    
+    while (!ingestInterrupted && (received = read(fd, buffer, sizeof(buffer))) != 0) 
+    {
+        if (received < 0) 
+        {
+            if (errno == EINTR) continue;
+            break;
+        }
+        
+        for (ssize_t i = 0; i < received; i++) 
+        {
+            char c = buffer[i];
+            bool complete = false;
+            if (source->lengthPrefixed) 
+            {
+                if (headerBytes < 4) 
+                {
+                    header[headerBytes++] = (unsigned char)c;
+                    if (headerBytes == 4) 
+                    {
+                        expected = ((uint32_t)header[0] << 24) | ((uint32_t)header[1] << 16) | 
+                                   ((uint32_t)header[2] << 8) | header[3];
+                        length = 0;
+                        complete = expected == 0;
+                    }
+                    if (!complete) continue;
+                } 
+                else 
+                {
+                    if (length < SERVER_LINE_MAX - 1) line[length++] = c;
+                    complete = --expected == 0;
+                }
+                if (complete) headerBytes = 0;
+            } 
+            else if (c == '\n') 
+            {
+                complete = true;
+            } 
+            else if (length < SERVER_LINE_MAX - 1) 
+            {
+                line[length++] = c;
+            }
+            
+            if (!complete) continue;
+            line[length] = '\0';
+            length = 0;
+            
+            IngestRecord record;
+            if (parseIngestRecord(line, &record)) ingestPush(source->queue, &record);
+            else if (line[0] != '\0' && strncmp(line, "transaction_id", 14) != 0) 
+            {
+                pthread_mutex_lock(&source->queue->lock);
+                source->queue->rejected++;
+                pthread_mutex_unlock(&source->queue->lock);
+            }
+        }
+    }
+}
+
+static void* ingestReader(void* arg) 
+{
+    IngestSource* source = (IngestSource*)arg;
+    if (source->fd >= 0) 
+    {
+        ingestStream(source, source->fd);
+    } 
+    else 
+    {
+        // Producers are served one after another until interrupted
+        while (!ingestInterrupted) 
+        {
+            int fd = accept(source->listener, NULL, NULL);
+            if (fd < 0) 
+            {
+                if (errno == EINTR) continue;
+                break;
+            }
+            ingestStream(source, fd);
+            close(fd);
+        }
+    }
+    
+    pthread_mutex_lock(&source->queue->lock);
+    source->queue->closed = true;
+    pthread_cond_signal(&source->queue->notEmpty);
+    pthread_mutex_unlock(&source->queue->lock);
+    return NULL;
+}
+
+// Ingest from stdin (socketPath NULL) or a socket until the stream ends or SIGINT/SIGTERM
+int runIngest(int argc, char* argv[]) 
+{
+    const char* input = "transactions.txt";
+    const char* socketPath = NULL;
+    int batchSize = INGEST_BATCH_SIZE;
+    int capacity = INGEST_QUEUE_CAPACITY;
+    bool lengthPrefixed = false;
+    double checkpointInterval = 0.0;
+    
+    for (int i = 0; i < argc; i++) 
+    {
+        if (strcmp(argv[i], "--input") == 0 && i + 1 < argc) input = argv[++i];
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) checkpointInterval = atof(argv[++i]);
+        else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) socketPath = argv[++i];
+        else if (strcmp(argv[i], "--batch-size") == 0 && i + 1 < argc) batchSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--queue") == 0 && i + 1 < argc) capacity = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--length-prefixed") == 0) lengthPrefixed = true;
+        else 
+        {
+            fprintf(stderr, "Unknown ingest option: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (batchSize < 1 || capacity < 1) 
+    {
+        fprintf(stderr, "--batch-size and --queue must be positive\n");
+        return 1;
+    }
+    
+    // Reports go to stderr, so stdout can be reserved for the producer pipeline
+    BatchContext data;
+    int saved = redirectStdout(STDERR_FILENO);
+    openDataset(&data, input);
+    BTree* transactionTree = data.transactionTree;
+    BTree* sellerTree = data.sellerTree;
+    BTree* buyerTree = data.buyerTree;
+    PairTree* pairTree = data.pairTree;
+    loadTariffs(TARIFF_FILE, sellerTree);
+    PricingTable* pricing = (PricingTable*)malloc(sizeof(PricingTable));
+    if (pricing) initPricingTable(pricing, sellerTree);
+    
+    IngestQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.capacity = capacity;
+    queue.records = (IngestRecord*)malloc(capacity * sizeof(IngestRecord));
+    IngestRecord* batch = (IngestRecord*)malloc(batchSize * sizeof(IngestRecord));
+    if (!queue.records || !batch || !pricing) 
+    {
+        printf("Memory allocation failed for ingest queue\n");
+        restoreStdout(saved);
+        return 1;
+    }
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.notEmpty, NULL);
+    pthread_cond_init(&queue.notFull, NULL);
+    
+    IngestSource source = { &queue, socketPath ? -1 : STDIN_FILENO, -1, lengthPrefixed };
+    if (socketPath) 
+    {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        source.listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (source.listener < 0 || strlen(socketPath) >= sizeof(address.sun_path)) 
+        {
+            printf("Error creating socket %s\n", socketPath);
+            restoreStdout(saved);
+            return 1;
+        }
+        strcpy(address.sun_path, socketPath);
+        unlink(socketPath);
+        if (bind(source.listener, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(source.listener, 8) < 0) 
+        {
+            printf("Error listening on %s\n", socketPath);
+            restoreStdout(saved);
+            return 1;
+        }
+        printf("Ingesting from %s\n", socketPath);
+    }
+    
+    // No SA_RESTART, so a signal interrupts the reader's blocking read/accept;
+    // this thread blocks the signals so they are delivered to the reader
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = handleIngestSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    sigset_t stopSignals, previousMask;
+    sigemptyset(&stopSignals);
+    sigaddset(&stopSignals, SIGINT);
+    sigaddset(&stopSignals, SIGTERM);
+    
+    pthread_t reader;
+    pthread_create(&reader, NULL, ingestReader, &source);
+    pthread_sigmask(SIG_BLOCK, &stopSignals, &previousMask);
+    Checkpointer* checkpoint = NULL;
+    if (checkpointInterval > 0) 
+    {
+        checkpoint = openCheckpointer(input, checkpointInterval, transactionTree, sellerTree, buyerTree, pairTree);
+    }
+    
+    LatencyHistogram* latency = (LatencyHistogram*)calloc(1, sizeof(LatencyHistogram));
+    long applied = 0, updated = 0, unpriced = 0, archived = 0, batches = 0, intervalApplied = 0;
+    uint64_t start = 0, lastReport = 0;
+    
+    while (1) 
+    {
+        // Take whatever is queued, up to one micro-batch
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == 0 && !queue.closed) pthread_cond_wait(&queue.notEmpty, &queue.lock);
+        int taken = queue.count < batchSize ? queue.count : batchSize;
+        for (int i = 0; i < taken; i++) batch[i] = queue.records[(queue.head + i) % queue.capacity];
+        queue.head = (queue.head + taken) % queue.capacity;
+        queue.count -= taken;
+        bool done = taken == 0 && queue.closed;
+        pthread_cond_signal(&queue.notFull);
+        pthread_mutex_unlock(&queue.lock);
+        if (done) break;
+        
+        if (start == 0) start = lastReport = monotonicNanos();
+        beginLoggedUpdate(checkpoint);
+        int dropped = 0, reused = 0;
+        for (int i = 0; i < taken; i++) 
+        {
+            IngestRecord* record = &batch[i];
+            if (isArchivedTransaction(record->transaction_id)) 
+            {
+                reused++;
+                continue;
+            }
+            if (record->autoPrice) 
+            {
+                int32_t quoted;
+                if (!quotePrice(pricing, record->seller_id, toEnergyWh(record->energy_kwh), (time_t)record->timestamp, &quoted)) 
+                {
+                    dropped++;
+                    continue;
+                }
+                record->price_per_kwh = microToUnits(quoted);
+            }
+            Transaction* tx = createTransaction(record->transaction_id, record->buyer_id, record->seller_id, 
+                                                record->energy_kwh, record->price_per_kwh, (time_t)record->timestamp);
+            logUpsert(checkpoint, tx);
+            if (upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree) != UPSERT_INSERTED) updated++;
+        }
+        endLoggedUpdate(checkpoint);
+        
+        // A record's latency ends when its batch has been applied
+        uint64_t now = realtimeNanos();
+        for (int i = 0; i < taken; i++) 
+        {
+            histogramRecord(latency, now > batch[i].start_ns ? now - batch[i].start_ns : 0);
+        }
+        applied += taken - dropped - reused;
+        intervalApplied += taken - dropped - reused;
+        unpriced += dropped;
+        archived += reused;
+        batches++;
+        
+        uint64_t mono = monotonicNanos();
+        if ((mono - lastReport) / 1e9 >= INGEST_REPORT_SECONDS) 
+        {
+            printf("Ingested %ld transactions (%.0f tx/s, p99 latency %.3f ms)\n", applied, 
+                   intervalApplied / ((mono - lastReport) / 1e9), histogramPercentile(latency, 0.99) / 1e6);
+            intervalApplied = 0;
+            lastReport = mono;
+        }
+    }
+    pthread_join(reader, NULL);
+    pthread_sigmask(SIG_SETMASK, &previousMask, NULL);
+    double seconds = start ? (monotonicNanos() - start) / 1e9 : 0.0;
+    
+    if (socketPath) 
+    {
+        close(source.listener);
+        unlink(socketPath);
+    }
+    
+    printf("\n===== INGEST SUMMARY =====\n");
+    printf("Transactions applied: %ld (%ld replaced existing IDs), rejected lines: %ld, archived IDs skipped: %ld\n", 
+           applied, updated, queue.rejected, archived);
+    if (pricing->hits + pricing->misses > 0) 
+    {
+        printf("Auto-priced: %ld, dropped without a price: %ld, seller cache hit rate %.1f%%\n", 
+               pricing->hits + pricing->misses - unpriced, unpriced, 100.0 * pricing->hits / (pricing->hits + pricing->misses));
+    }
+    printf("Micro-batches: %ld (average %.1f transactions), reader stalls on a full queue: %ld\n", 
+           batches, batches ? (double)applied / batches : 0.0, queue.stalls);
+    printf("Elapsed: %.3f s, sustained throughput: %.0f tx/s\n", seconds, seconds > 0 ? applied / seconds : 0.0);
+    printf("End-to-end latency (ms): p50 %.3f | p90 %.3f | p99 %.3f | p99.9 %.3f | max %.3f\n", 
+           histogramPercentile(latency, 0.5) / 1e6, histogramPercentile(latency, 0.9) / 1e6, 
+           histogramPercentile(latency, 0.99) / 1e6, histogramPercentile(latency, 0.999) / 1e6, latency->max / 1e6);
+    
+    // Without a checkpointer the input file is replaced atomically, or kept as loaded
+    int status = 0;
+    if (checkpoint) 
+    {
+        closeCheckpointer(checkpoint);
+        printCheckpointStats(checkpoint);
+    } 
+    else if (applied > 0 && exportTransactionsTo(transactionTree, input) < 0) 
+    {
+        status = 1;
+    }
+    restoreStdout(saved);
+    
+    free(latency);
+    free(pricing);
+    free(batch);
+    free(queue.records);
+    return status;
+}
+
+/*
+ * Disk-resident paged B+ tree
+ *
+ * A file-backed variant of the transaction tree for histories that do not fit
+ * in memory. The file is a sequence of fixed-size pages addressed by page ID;
+ * page 0 holds the metadata, internal pages hold separator keys and child page
+ * IDs, and leaf pages hold the transaction records themselves (as ArchiveRecord)
+ * plus the page ID of the next leaf. Pages are accessed through a buffer pool
+ * with a fixed number of frames and CLOCK replacement, so memory use is bounded
+ * and each lookup costs at most one page read per tree level. Every page is
+ * checked as it is pinned (key count, page IDs in range, depth within the
+ * recorded height), so a damaged file fails with an error instead of sending
+ * a lookup out of bounds.
+ */
+
+#define PAGE_SIZE 4096
+#define META_PAGE 0               // Page 0 is the metadata page, so 0 also means "no page"
+#define MIN_POOL_FRAMES 8         // A split pins up to four pages at once
+
+// Header at the start of every tree page
+typedef struct PageHeader 
+{
+    uint8_t leaf;
+    uint8_t reserved;
+    uint16_t n;                   // Number of keys
+    uint32_t next;                // Next leaf page (leaves only)
+} PageHeader;
+
+#define LEAF_PAGE_CAPACITY ((PAGE_SIZE - sizeof(PageHeader)) / (sizeof(int32_t) + sizeof(ArchiveRecord)))
+#define INTERNAL_PAGE_CAPACITY ((PAGE_SIZE - sizeof(PageHeader) - sizeof(uint32_t)) / (sizeof(int32_t) + sizeof(uint32_t)))
+
+// Leaf page: sorted keys and the records they identify
+typedef struct LeafPage 
+{
+    PageHeader header;
+    int32_t keys[LEAF_PAGE_CAPACITY];
+    ArchiveRecord records[LEAF_PAGE_CAPACITY];
+} LeafPage;
+
+// Internal page: keys[i] is the largest key under children[i]
+typedef struct InternalPage 
+{
+    PageHeader header;
+    int32_t keys[INTERNAL_PAGE_CAPACITY];
+    uint32_t children[INTERNAL_PAGE_CAPACITY + 1];
+} InternalPage;
+
+// Metadata page
+typedef struct MetaPage 
+{
+    char magic[8];                // "ETBTREE2"
+    uint32_t root;
+    uint32_t page_count;
+    uint32_t height;
+    uint32_t reserved;
+    uint64_t record_count;
+} MetaPage;
+
+_Static_assert(sizeof(LeafPage) <= PAGE_SIZE, "leaf page exceeds PAGE_SIZE");
+_Static_assert(sizeof(InternalPage) <= PAGE_SIZE, "internal page exceeds PAGE_SIZE");
+_Static_assert(sizeof(MetaPage) <= PAGE_SIZE, "meta page exceeds PAGE_SIZE");
+
+// Buffer pool frame
+typedef struct Frame 
+{
+    uint32_t page_id;
+    int pin_count;
+    bool valid;
+    bool dirty;
+    bool referenced;              // CLOCK reference bit
+    int hash_next;                // Next frame in the same hash bucket, -1 ends the chain
+    unsigned char* data;
+} Frame;
+
+// Fixed-size page cache over a file with CLOCK replacement
+typedef struct BufferPool 
+{
+    int fd;
+    int num_frames;
+    Frame* frames;
+    unsigned char* memory;        // num_frames * PAGE_SIZE bytes backing the frames
+    int* buckets;                 // Page ID hash table, heads of frame chains
+    int num_buckets;              // Power of two
+    int clock_hand;
+    uint32_t page_count;          // Pages in the file, including unflushed new ones
+    long hits;
+    long misses;
+    long reads;
+    long writes;
+} BufferPool;
+
+// Paged B+ tree of transactions keyed by transaction_id
+typedef struct PagedBTree 
+{
+    BufferPool* pool;
+    MetaPage meta;                // Cached copy, written back on flush
+    bool broken;                  // An insert failed halfway, so the pages no longer form a tree
+} PagedBTree;
+
+static inline int poolBucket(BufferPool* pool, uint32_t page_id) 
+{
+    return (int)((page_id * 2654435761u) & (uint32_t)(pool->num_buckets - 1));
+}
+
+// Open (or create) a page file with a buffer pool of num_frames pages
+BufferPool* bufferPoolOpen(const char* path, int num_frames) 
+{
+    if (num_frames < MIN_POOL_FRAMES) num_frames = MIN_POOL_FRAMES;
+    
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) 
+    {
+        printf("Error opening page file %s\n", path);
+        return NULL;
+    }
+    
+    // A partial page means this is not a page file (or a torn one); never treat it as new
+    off_t size = lseek(fd, 0, SEEK_END);
+    if (size < 0 || size % PAGE_SIZE != 0) 
+    {
+        printf("%s is not a page file (size is not a multiple of %d bytes)\n", path, PAGE_SIZE);
+        close(fd);
+        return NULL;
+    }
+    
+    BufferPool* pool = (BufferPool*)calloc(1, sizeof(BufferPool));
+    if (!pool) 
+    {
+        printf("Memory allocation failed for BufferPool\n");
+        exit(1);
+    }
+    
+    pool->fd = fd;
+    pool->num_frames = num_frames;
+    pool->frames = (Frame*)calloc(num_frames, sizeof(Frame));
+    pool->memory = (unsigned char*)malloc((size_t)num_frames * PAGE_SIZE);
+    pool->num_buckets = 1;
+    while (pool->num_buckets < 2 * num_frames) pool->num_buckets *= 2;
+    pool->buckets = (int*)malloc(pool->num_buckets * sizeof(int));
+    if (!pool->frames || !pool->memory || !pool->buckets) 
+    {
+        printf("Memory allocation failed for BufferPool\n");
+        exit(1);
+    }
+    
+    for (int i = 0; i < pool->num_buckets; i++) pool->buckets[i] = -1;
+    for (int i = 0; i < num_frames; i++) 
+    {
+        pool->frames[i].data = pool->memory + (size_t)i * PAGE_SIZE;
+        pool->frames[i].hash_next = -1;
+    }
+    
+    pool->page_count = (uint32_t)(size / PAGE_SIZE);
+    
+    return pool;
+}
+
+// Write a frame back to the file if it is dirty
+static bool poolWriteFrame(BufferPool* pool, Frame* frame) 
+{
+    if (!frame->valid || !frame->dirty) return true;
+    
+    if (pwrite(pool->fd, frame->data, PAGE_SIZE, (off_t)frame->page_id * PAGE_SIZE) != PAGE_SIZE) 
+    {
+        printf("Error writing page %u\n", frame->page_id);
+        return false;
+    }
+    frame->dirty = false;
+    pool->writes++;
+    return true;
+}
+
+// Find a frame to reuse with the CLOCK algorithm, evicting its page
+static int poolEvict(BufferPool* pool) 
+{
+    // Two full sweeps clear every reference bit, so a third finds a victim unless all are pinned
+    for (int step = 0; step < 3 * pool->num_frames; step++) 
+    {
+        int i = pool->clock_hand;
+        pool->clock_hand = (pool->clock_hand + 1) % pool->num_frames;
+        Frame* frame = &pool->frames[i];
+        
+        if (!frame->valid) return i;
+        if (frame->pin_count > 0) continue;
+        if (frame->referenced) 
+        {
+            frame->referenced = false;
+            continue;
+        }
+        
+        if (!poolWriteFrame(pool, frame)) return -1;
+        
+        // Unlink from the hash chain
+        int* link = &pool->buckets[poolBucket(pool, frame->page_id)];
+        while (*link != i) link = &pool->frames[*link].hash_next;
+        *link = frame->hash_next;
+        frame->hash_next = -1;
+        frame->valid = false;
+        return i;
+    }
+    
+    printf("Buffer pool exhausted: all %d frames are pinned\n", pool->num_frames);
+    return -1;
+}
+
+// Pin a page in the pool and return its data; fresh pages are zero-filled
+// instead of read. Returns NULL if no frame could be freed.
+static unsigned char* poolFetch(BufferPool* pool, uint32_t page_id, bool fresh) 
+{
+    int bucket = poolBucket(pool, page_id);
+    for (int i = pool->buckets[bucket]; i != -1; i = pool->frames[i].hash_next) 
+    {
+        if (pool->frames[i].page_id == page_id) 
+        {
+            pool->hits++;
+            pool->frames[i].pin_count++;
+            pool->frames[i].referenced = true;
+            return pool->frames[i].data;
+        }
+    }
+    
+    pool->misses++;
+    int i = poolEvict(pool);
+    if (i < 0) return NULL;
+    
+    Frame* frame = &pool->frames[i];
+    if (fresh) 
+    {
+        memset(frame->data, 0, PAGE_SIZE);
+    } 
+    else 
+    {
+        ssize_t got = pread(pool->fd, frame->data, PAGE_SIZE, (off_t)page_id * PAGE_SIZE);
+        if (got < 0) 
+        {
+            printf("Error reading page %u\n", page_id);
+            return NULL;
+        }
+        if (got < PAGE_SIZE) memset(frame->data + got, 0, PAGE_SIZE - got);
+        pool->reads++;
+    }
+    
+    frame->page_id = page_id;
+    frame->pin_count = 1;
+    frame->valid = true;
+    frame->dirty = fresh;
+    frame->referenced = true;
+    frame->hash_next = pool->buckets[bucket];
+    pool->buckets[bucket] = i;
+    
+    return frame->data;
+}
+
+// Pin an existing page
+unsigned char* bufferPoolPin(BufferPool* pool, uint32_t page_id) 
+{
+    return poolFetch(pool, page_id, false);
+}
+
+// Allocate a new zeroed page at the end of the file and pin it
+unsigned char* bufferPoolNewPage(BufferPool* pool, uint32_t* page_id) 
+{
+    *page_id = pool->page_count;
+    unsigned char* data = poolFetch(pool, *page_id, true);
+    if (data) pool->page_count++;
+    return data;
+}
+
+// Release a pinned page, marking it dirty if it was modified
+void bufferPoolUnpin(BufferPool* pool, uint32_t page_id, bool dirty) 
+{
+    for (int i = pool->buckets[poolBucket(pool, page_id)]; i != -1; i = pool->frames[i].hash_next) 
+    {
+        if (pool->frames[i].page_id == page_id) 
+        {
+            pool->frames[i].pin_count--;
+            pool->frames[i].dirty |= dirty;
+            return;
+        }
+    }
+}
+
+// Write all dirty pages to the file
+bool bufferPoolFlush(BufferPool* pool) 
+{
+    bool ok = true;
+    for (int i = 0; i < pool->num_frames; i++) 
+    {
+        ok &= poolWriteFrame(pool, &pool->frames[i]);
+    }
+    return ok;
+}
+
+// Flush and release the pool
+void bufferPoolClose(BufferPool* pool) 
+{
+    bufferPoolFlush(pool);
+    close(pool->fd);
+    free(pool->frames);
+    free(pool->memory);
+    free(pool->buckets);
+    free(pool);
+}
+
+// Write the cached metadata into page 0
+static bool pagedTreeWriteMeta(PagedBTree* tree) 
+{
+    unsigned char* data = bufferPoolPin(tree->pool, META_PAGE);
+    if (!data) return false;
+    tree->meta.page_count = tree->pool->page_count;
+    memcpy(data, &tree->meta, sizeof(MetaPage));
+    bufferPoolUnpin(tree->pool, META_PAGE, true);
+    return true;
+}
+
+// Pin a tree page, checking that its ID and header are possible in this file and
+// whether it is a leaf matches the level it is reached at (level 0 is the root).
+// A page that fails is reported and released. Links to other pages are checked
+// when they are followed, by this same function.
+static unsigned char* pagedTreePin(PagedBTree* tree, uint32_t page_id, uint32_t level) 
+{
+    if (page_id == META_PAGE || page_id >= tree->pool->page_count || level >= tree->meta.height) 
+    {
+        printf("Corrupt paged tree: page %u at level %u is out of range\n", page_id, level);
+        return NULL;
+    }
+    
+    unsigned char* data = bufferPoolPin(tree->pool, page_id);
+    if (!data) return NULL;
+    
+    const PageHeader* header = (const PageHeader*)data;
+    bool leafLevel = level == tree->meta.height - 1;
+    bool valid = header->leaf == leafLevel && 
+                 (leafLevel ? header->n <= LEAF_PAGE_CAPACITY && header->next < tree->pool->page_count 
+                            : header->n >= 1 && header->n <= INTERNAL_PAGE_CAPACITY);
+    if (!valid) 
+    {
+        bufferPoolUnpin(tree->pool, page_id, false);
+        printf("Corrupt paged tree: page %u at level %u has an invalid header\n", page_id, level);
+        return NULL;
+    }
+    return data;
+}
+
+// Open a paged tree file, creating an empty tree if the file is new
+PagedBTree* pagedTreeOpen(const char* path, int pool_frames) 
+{
+    BufferPool* pool = bufferPoolOpen(path, pool_frames);
+    if (!pool) return NULL;
+    
+    PagedBTree* tree = (PagedBTree*)calloc(1, sizeof(PagedBTree));
+    if (!tree) 
+    {
+        printf("Memory allocation failed for PagedBTree\n");
+        exit(1);
+    }
+    tree->pool = pool;
+    
+    if (pool->page_count == 0) 
+    {
+        // New file: metadata page plus an empty root leaf
+        uint32_t meta_id, root_id;
+        bufferPoolNewPage(pool, &meta_id);
+        LeafPage* root = (LeafPage*)bufferPoolNewPage(pool, &root_id);
+        root->header.leaf = 1;
+        bufferPoolUnpin(pool, root_id, true);
+        bufferPoolUnpin(pool, meta_id, true);
+        
+        memcpy(tree->meta.magic, "ETBTREE2", 8);
+        tree->meta.root = root_id;
+        tree->meta.height = 1;
+        tree->meta.record_count = 0;
+        pagedTreeWriteMeta(tree);
+    } 
+    else 
+    {
+        unsigned char* data = bufferPoolPin(pool, META_PAGE);
+        if (!data) 
+        {
+            printf("Error reading the metadata page of %s\n", path);
+            bufferPoolClose(pool);
+            free(tree);
+            return NULL;
+        }
+        memcpy(&tree->meta, data, sizeof(MetaPage));
+        bufferPoolUnpin(pool, META_PAGE, false);
+        
+        if (memcmp(tree->meta.magic, "ETBTREE2", 8) != 0) 
+        {
+            printf("%s is not a paged transaction tree\n", path);
+            bufferPoolClose(pool);
+            free(tree);
+            return NULL;
+        }
+        
+        // The height bounds every descent, which records one page per level
+        unsigned char* root = NULL;
+        if (tree->meta.height >= 1 && tree->meta.height <= MAX_TREE_HEIGHT) root = pagedTreePin(tree, tree->meta.root, 0);
+        if (!root) 
+        {
+            printf("%s has invalid metadata (root page %u, height %u)\n", path, tree->meta.root, tree->meta.height);
+            bufferPoolClose(pool);
+            free(tree);
+            return NULL;
+        }
+        bufferPoolUnpin(pool, tree->meta.root, false);
+    }
+    
+    return tree;
+}
+
+// Flush all pages and close the tree
+void pagedTreeClose(PagedBTree* tree) 
+{
+    pagedTreeWriteMeta(tree);
+    bufferPoolClose(tree->pool);
+    free(tree);
+}
+
+// Descend to the leaf for key, recording page IDs and child indexes along the way
+// (at most meta.height <= MAX_TREE_HEIGHT levels). Only one page is pinned at a
+// time. Returns the number of levels recorded, or -1 on error.
+static int pagedTreeDescend(PagedBTree* tree, int key, uint32_t* pages, int* indexes) 
+{
+    uint32_t page_id = tree->meta.root;
+    int depth = 0;
+    
+    while (1) 
+    {
+        unsigned char* data = pagedTreePin(tree, page_id, depth);
+        if (!data) return -1;
+        
+        PageHeader* header = (PageHeader*)data;
+        pages[depth] = page_id;
+        
+        if (header->leaf) 
+        {
+            LeafPage* leaf = (LeafPage*)data;
+            indexes[depth] = binaryLowerBound(leaf->keys, leaf->header.n, key);
+            bufferPoolUnpin(tree->pool, page_id, false);
+            return depth + 1;
+        }
+        
+        InternalPage* node = (InternalPage*)data;
+        int i = binaryLowerBound(node->keys, node->header.n, key);
+        indexes[depth] = i;
+        uint32_t child = node->children[i];
+        bufferPoolUnpin(tree->pool, page_id, false);
+        
+        page_id = child;
+        depth++;
+    }
+}
+
+// Look up a transaction by ID; returns true and fills out if found.
+// A corrupt page is reported and makes the lookup return false.
+bool pagedTreeSearch(PagedBTree* tree, int key, Transaction* out) 
+{
+    if (tree->broken) return false;
+    uint32_t page_id = tree->meta.root;
+    
+    for (uint32_t level = 0; ; level++) 
+    {
+        unsigned char* data = pagedTreePin(tree, page_id, level);
+        if (!data) return false;
+        
+        if (((PageHeader*)data)->leaf) 
+        {
+            LeafPage* leaf = (LeafPage*)data;
+            int i = binaryLowerBound(leaf->keys, leaf->header.n, key);
+            bool found = i < leaf->header.n && leaf->keys[i] == key;
+            if (found && out) unpackTransaction(&leaf->records[i], out);
+            bufferPoolUnpin(tree->pool, page_id, false);
+            return found;
+        }
+        
+        InternalPage* node = (InternalPage*)data;
+        uint32_t child = node->children[binaryLowerBound(node->keys, node->header.n, key)];
+        bufferPoolUnpin(tree->pool, page_id, false);
+        page_id = child;
+    }
+}
+
+// Insert separator key and right child after position idx of an internal page,
+// splitting it if full. On split, *split_key and *split_page receive the
+// separator and new page to insert one level up.
+static bool pagedInsertInternal(PagedBTree* tree, uint32_t page_id, uint32_t level, int idx, int key, uint32_t right, 
+                                bool* split, int* split_key, uint32_t* split_page) 
+{
+    InternalPage* node = (InternalPage*)pagedTreePin(tree, page_id, level);
+    if (!node) return false;
+    
+    int n = node->header.n;
+    int32_t keys[INTERNAL_PAGE_CAPACITY + 1];
+    uint32_t children[INTERNAL_PAGE_CAPACITY + 2];
+    
+    // Build the merged key/child sequence
+    memcpy(keys, node->keys, idx * sizeof(int32_t));
+    keys[idx] = key;
+    memcpy(&keys[idx + 1], &node->keys[idx], (n - idx) * sizeof(int32_t));
+    memcpy(children, node->children, (idx + 1) * sizeof(uint32_t));
+    children[idx + 1] = right;
+    memcpy(&children[idx + 2], &node->children[idx + 1], (n - idx) * sizeof(uint32_t));
+    n++;
+    
+    *split = n > (int)INTERNAL_PAGE_CAPACITY;
+    if (!*split) 
+    {
+        memcpy(node->keys, keys, n * sizeof(int32_t));
+        memcpy(node->children, children, (n + 1) * sizeof(uint32_t));
+        node->header.n = n;
+        bufferPoolUnpin(tree->pool, page_id, true);
+        return true;
+    }
+    
+    // Split: the middle key moves up
+    uint32_t new_id;
+    InternalPage* sibling = (InternalPage*)bufferPoolNewPage(tree->pool, &new_id);
+    if (!sibling) 
+    {
+        bufferPoolUnpin(tree->pool, page_id, false);
+        return false;
+    }
+    
+    int leftN = n / 2;
+    int rightN = n - leftN - 1;
+    memcpy(node->keys, keys, leftN * sizeof(int32_t));
+    memcpy(node->children, children, (leftN + 1) * sizeof(uint32_t));
+    node->header.n = leftN;
+    memcpy(sibling->keys, &keys[leftN + 1], rightN * sizeof(int32_t));
+    memcpy(sibling->children, &children[leftN + 1], (rightN + 1) * sizeof(uint32_t));
+    sibling->header.n = rightN;
+    
+    *split_key = keys[leftN];
+    *split_page = new_id;
+    bufferPoolUnpin(tree->pool, new_id, true);
+    bufferPoolUnpin(tree->pool, page_id, true);
+    return true;
+}
+
+// Insert a transaction unless its ID is already present.
+// Returns 1 if inserted, 0 if the ID exists, -1 on I/O error or corruption.
+// A failure while a split propagates, after the leaf has been split, leaves
+// the new leaf without a parent entry: the tree is then marked broken, every
+// later call fails, and the file has to be rebuilt.
+int pagedTreeInsert(PagedBTree* tree, const Transaction* tx) 
+{
+    uint32_t pages[MAX_TREE_HEIGHT];
+    int indexes[MAX_TREE_HEIGHT];
+    int key = tx->transaction_id;
+    if (tree->broken) return -1;
+    
+    int depth = pagedTreeDescend(tree, key, pages, indexes);
+    if (depth < 0) return -1;
+    
+    uint32_t leaf_id = pages[depth - 1];
+    int pos = indexes[depth - 1];
+    LeafPage* leaf = (LeafPage*)pagedTreePin(tree, leaf_id, depth - 1);
+    if (!leaf) return -1;
+    
+    if (pos < leaf->header.n && leaf->keys[pos] == key) 
+    {
+        bufferPoolUnpin(tree->pool, leaf_id, false);
+        return 0;
+    }
+    
+    ArchiveRecord rec;
+    packTransaction(tx, &rec);
+    int n = leaf->header.n;
+    
+    // record_count is only advanced once the insert can no longer fail
+    if (n < (int)LEAF_PAGE_CAPACITY) 
+    {
+        memmove(&leaf->keys[pos + 1], &leaf->keys[pos], (n - pos) * sizeof(int32_t));
+        memmove(&leaf->records[pos + 1], &leaf->records[pos], (n - pos) * sizeof(ArchiveRecord));
+        leaf->keys[pos] = key;
+        leaf->records[pos] = rec;
+        leaf->header.n++;
+        bufferPoolUnpin(tree->pool, leaf_id, true);
+        tree->meta.record_count++;
+        return 1;
+    }
+    
+    // Leaf is full: split it, keeping the lower half in place
+    uint32_t new_id;
+    LeafPage* sibling = (LeafPage*)bufferPoolNewPage(tree->pool, &new_id);
+    if (!sibling) 
+    {
+        bufferPoolUnpin(tree->pool, leaf_id, false);
+        return -1;
+    }
+    sibling->header.leaf = 1;
+    
+    int total = n + 1;
+    int leftN = total / 2;
+    int rightN = total - leftN;
+    
+    // Place the new entry while distributing the keys over the two pages
+    for (int src = n - 1, dst = total - 1; dst >= 0; dst--) 
+    {
+        int32_t k;
+        ArchiveRecord r;
+        if (dst == pos) 
+        {
+            k = key;
+            r = rec;
+        } 
+        else 
+        {
+            k = leaf->keys[src];
+            r = leaf->records[src];
+            src--;
+        }
+        
+        if (dst >= leftN) 
+        {
+            sibling->keys[dst - leftN] = k;
+            sibling->records[dst - leftN] = r;
+        } 
+        else 
+        {
+            leaf->keys[dst] = k;
+            leaf->records[dst] = r;
+        }
+    }
+    leaf->header.n = leftN;
+    sibling->header.n = rightN;
+    sibling->header.next = leaf->header.next;
+    leaf->header.next = new_id;
+    
+    int sep_key = leaf->keys[leftN - 1];
+    uint32_t right_page = new_id;
+    bufferPoolUnpin(tree->pool, new_id, true);
+    bufferPoolUnpin(tree->pool, leaf_id, true);
+    
+    // Propagate the split up the recorded path
+    for (int level = depth - 2; level >= 0; level--) 
+    {
+        bool split;
+        int next_key;
+        uint32_t next_page;
+        if (!pagedInsertInternal(tree, pages[level], level, indexes[level], sep_key, right_page, &split, &next_key, &next_page)) 
+        {
+            tree->broken = true;
+            return -1;
+        }
+        if (!split) 
+        {
+            tree->meta.record_count++;
+            return 1;
+        }
+        sep_key = next_key;
+        right_page = next_page;
+    }
+    
+    // The root split, grow the tree by one level
+    uint32_t root_id;
+    InternalPage* root = tree->meta.height < MAX_TREE_HEIGHT ? (InternalPage*)bufferPoolNewPage(tree->pool, &root_id) : NULL;
+    if (!root) 
+    {
+        tree->broken = true;
+        return -1;
+    }
+    root->header.n = 1;
+    root->keys[0] = sep_key;
+    root->children[0] = tree->meta.root;
+    root->children[1] = right_page;
+    bufferPoolUnpin(tree->pool, root_id, true);
+    
+    tree->meta.root = root_id;
+    tree->meta.height++;
+    tree->meta.record_count++;
+    return 1;
+}
+
+// Visit every stored transaction in key order along the leaf chain.
+// Returns the number visited, or -1 on error.
+long pagedTreeScan(PagedBTree* tree, void (*visit)(Transaction* tx, void* ctx), void* ctx) 
+{
+    if (tree->broken) return -1;
+    
+    // Find the leftmost leaf
+    uint32_t page_id = tree->meta.root;
+    uint32_t leafLevel = tree->meta.height - 1;
+    for (uint32_t level = 0; level < leafLevel; level++) 
+    {
+        unsigned char* data = pagedTreePin(tree, page_id, level);
+        if (!data) return -1;
+        uint32_t child = ((InternalPage*)data)->children[0];
+        bufferPoolUnpin(tree->pool, page_id, false);
+        page_id = child;
+    }
+    
+    long count = 0;
+    for (uint32_t visited = 0; page_id != META_PAGE; visited++) 
+    {
+        // A chain longer than the file has pages must loop
+        if (visited == tree->pool->page_count) 
+        {
+            printf("Corrupt paged tree: the leaf chain loops\n");
+            return -1;
+        }
+        LeafPage* leaf = (LeafPage*)pagedTreePin(tree, page_id, leafLevel);
+        if (!leaf) return -1;
+        
+        for (int i = 0; i < leaf->header.n; i++) 
+        {
+            Transaction tx;
+            unpackTransaction(&leaf->records[i], &tx);
+            visit(&tx, ctx);
+            count++;
+        }
+        
+        uint32_t next = leaf->header.next;
+        bufferPoolUnpin(tree->pool, page_id, false);
+        page_id = next;
+    }
+    
+    return count;
+}
+
+// Copy every in-memory transaction into a paged tree file. Returns the number inserted.
+long exportToPagedTree(BTree* transactionTree, const char* path, int pool_frames) 
+{
+    PagedBTree* paged = pagedTreeOpen(path, pool_frames);
+    if (!paged) return -1;
+    
+    Node* current = transactionTree->root;
+    while (!current->leaf) current = current->children[0];
+    
+    long inserted = 0;
+    for (; current != NULL; current = current->next) 
+    {
+        for (int i = 0; i < current->n; i++) 
+        {
+            int result = pagedTreeInsert(paged, (Transaction*)current->records[i]);
+            if (result < 0) 
+            {
+                pagedTreeClose(paged);
+                return -1;
+            }
+            inserted += result;
+        }
+    }
+    
+    pagedTreeClose(paged);
+    return inserted;
+}
+
+// Monotonic wall clock in seconds, for benchmarks
+double nowSeconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Microbenchmark of in-node key search latency across fanouts
+void benchmarkNodeSearch(void)
+{
+    const int lookups = 2000000;
+    const int fanouts[] = {4, 6, 8, 16, 32, 64, 128, 256};
+    const int numFanouts = sizeof(fanouts) / sizeof(fanouts[0]);
+    int* probes = (int*)malloc(lookups * sizeof(int));
+    if (!probes) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    printf("\n===== IN-NODE SEARCH LATENCY (ns/lookup) =====\n");
+    printf("%-8s | %-10s | %-10s | %-10s | %-10s\n", "FANOUT", "LINEAR", "BINARY", "SIMD", "SELECTED");
+    printf("------------------------------------------------------\n");
+    
+    srand(42);
+    for (int f = 0; f < numFanouts; f++) 
+    {
+        // A full node of a tree with this fanout holds fanout-1 keys
+        Node node;
+        node.n = fanouts[f] - 1;
+        node.keys = (int*)malloc(node.n * sizeof(int));
+        for (int i = 0; i < node.n; i++) node.keys[i] = i * 2;
+        for (int i = 0; i < lookups; i++) probes[i] = rand() % (node.n * 2 + 1);
+        
+        double ns[4];
+        long checksum = 0;
+        double start = nowSeconds();
+        for (int i = 0; i < lookups; i++) checksum += linearLowerBound(node.keys, node.n, probes[i]);
+        ns[0] = (nowSeconds() - start) * 1e9 / lookups;
+        
+        start = nowSeconds();
+        for (int i = 0; i < lookups; i++) checksum += binaryLowerBound(node.keys, node.n, probes[i]);
+        ns[1] = (nowSeconds() - start) * 1e9 / lookups;
+        
+        start = nowSeconds();
+        for (int i = 0; i < lookups; i++) checksum += simdLowerBound(node.keys, node.n, probes[i]);
+        ns[2] = (nowSeconds() - start) * 1e9 / lookups;
+        
+        start = nowSeconds();
+        for (int i = 0; i < lookups; i++) checksum += nodeLowerBound(&node, probes[i]);
+        ns[3] = (nowSeconds() - start) * 1e9 / lookups;
+        
+        printf("%-8d | %-10.2f | %-10.2f | %-10.2f | %-10.2f\n", fanouts[f], ns[0], ns[1], ns[2], ns[3]);
+        if (checksum == -1) printf("\n"); // Keep the lookups from being optimized away
+        free(node.keys);
+    }
+    
+    printf("------------------------------------------------------\n");
+    free(probes);
+}
+
+// Recursive descent kept as the baseline for benchmarkDescent
+static void* searchRecursive(Node* node, int key) 
+{
+    int i = nodeLowerBound(node, key);
+    if (node->leaf) return (i < node->n && node->keys[i] == key) ? node->records[i] : NULL;
+    return searchRecursive(node->children[i], key);
+}
+
+// Benchmark of point-lookup latency, recursive vs iterative descent
+void benchmarkDescent(void)
+{
+    const int numKeys = 1000000;
+    const int lookups = 2000000;
+    const int degrees[] = {2, 3, 8, 32};
+    const int numDegrees = sizeof(degrees) / sizeof(degrees[0]);
+    int* probes = (int*)malloc(lookups * sizeof(int));
+    if (!probes) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    printf("\n===== POINT LOOKUP LATENCY, %d KEYS (ns/lookup) =====\n", numKeys);
+    printf("%-8s | %-8s | %-12s | %-12s\n", "DEGREE", "HEIGHT", "RECURSIVE", "ITERATIVE");
+    printf("------------------------------------------------\n");
+    
+    srand(42);
+    for (int i = 0; i < lookups; i++) probes[i] = rand() % numKeys;
+    
+    for (int d = 0; d < numDegrees; d++) 
+    {
+        BTree* tree = createBTree(degrees[d], 'T');
+        for (int i = 0; i < numKeys; i++) 
+        {
+            // Multiplicative scrambling gives a random insertion order of 0..numKeys-1
+            int key = (int)(((long long)i * 7919) % numKeys);
+            insert(tree, key, &probes[0]);
+        }
+        
+        int height = 1;
+        for (Node* node = tree->root; !node->leaf; node = node->children[0]) height++;
+        
+        long found = 0;
+        double start = nowSeconds();
+        for (int i = 0; i < lookups; i++) found += searchRecursive(tree->root, probes[i]) != NULL;
+        double recursiveNs = (nowSeconds() - start) * 1e9 / lookups;
+        
+        start = nowSeconds();
+        for (int i = 0; i < lookups; i++) found += search(tree->root, probes[i]) != NULL;
+        double iterativeNs = (nowSeconds() - start) * 1e9 / lookups;
+        
+        printf("%-8d | %-8d | %-12.2f | %-12.2f\n", degrees[d], height, recursiveNs, iterativeNs);
+        if (found != 2L * lookups) printf("Warning: %ld of %d lookups failed\n", 2L * lookups - found, 2 * lookups);
+    }
+    
+    printf("------------------------------------------------\n");
+    free(probes);
+}
+
+// Benchmark of paged tree lookups across buffer pool sizes
+void benchmarkPagedTree(const char* path) 
+{
+    const int numKeys = 1000000;
+    const int lookups = 200000;
+    const int poolSizes[] = {16, 64, 256, 1024, 8192};
+    const int numPoolSizes = sizeof(poolSizes) / sizeof(poolSizes[0]);
+    
+    unlink(path);
+    PagedBTree* tree = pagedTreeOpen(path, 1024);
+    if (!tree) return;
+    
+    srand(42);
+    double start = nowSeconds();
+    for (int i = 0; i < numKeys; i++) 
+    {
+        Transaction tx = { (int)(((long long)i * 7919) % numKeys), rand() % 1000, rand() % 100, 
+                           (rand() % 600) * ENERGY_SCALE, 5 * PRICE_SCALE, toTimeOffset(1700000000 + i) };
+        pagedTreeInsert(tree, &tx);
+    }
+    double buildSeconds = nowSeconds() - start;
+    uint32_t height = tree->meta.height;
+    uint32_t pages = tree->pool->page_count;
+    pagedTreeClose(tree);
+    
+    printf("\n===== PAGED B+ TREE (%d records, %u pages of %d bytes, height %u) =====\n", 
+           numKeys, pages, PAGE_SIZE, height);
+    printf("Build: %.2f s (%.0f inserts/s)\n", buildSeconds, numKeys / buildSeconds);
+    printf("%-12s | %-12s | %-14s | %-10s\n", "POOL PAGES", "NS/LOOKUP", "READS/LOOKUP", "HIT RATIO");
+    printf("------------------------------------------------------\n");
+    
+    for (int p = 0; p < numPoolSizes; p++) 
+    {
+        tree = pagedTreeOpen(path, poolSizes[p]);
+        if (!tree) return;
+        
+        // Warm the pool, then measure
+        srand(7);
+        for (int i = 0; i < lookups; i++) pagedTreeSearch(tree, rand() % numKeys, NULL);
+        tree->pool->hits = tree->pool->misses = tree->pool->reads = 0;
+        
+        int found = 0;
+        start = nowSeconds();
+        for (int i = 0; i < lookups; i++) found += pagedTreeSearch(tree, rand() % numKeys, NULL);
+        double ns = (nowSeconds() - start) * 1e9 / lookups;
+        
+        BufferPool* pool = tree->pool;
+        printf("%-12d | %-12.0f | %-14.3f | %-10.3f\n", poolSizes[p], ns, (double)pool->reads / lookups, 
+               (double)pool->hits / (pool->hits + pool->misses));
+        if (found != lookups) printf("Warning: %d of %d lookups failed\n", lookups - found, lookups);
+        pagedTreeClose(tree);
+    }
+    
+    printf("------------------------------------------------------\n");
+    unlink(path);
+}
+
+// Visitor for benchmarkTransactionSets: sums energy
+static void sumEnergy(Transaction* tx, void* ctx) 
+{
+    *(int64_t*)ctx += tx->energy_wh;
+}
+
+// Memory per buyer and scan speed of per-entity transaction sets vs a t=2 B+ tree per buyer
+void benchmarkTransactionSets(void) 
+{
+    const int numBuyers = 1000000;
+    
+    // Skewed transactions per buyer: most buyers have a handful, a few have many
+    int* perBuyer = (int*)malloc(numBuyers * sizeof(int));
+    srand(42);
+    long total = 0;
+    for (int b = 0; b < numBuyers; b++) 
+    {
+        int r = rand() % 100;
+        perBuyer[b] = r < 60 ? 1 + rand() % 3 : (r < 95 ? 4 + rand() % 12 : 16 + rand() % 200);
+        total += perBuyer[b];
+    }
+    
+    Transaction* txs = (Transaction*)malloc(total * sizeof(Transaction));
+    for (long i = 0; i < total; i++) 
+    {
+        txs[i].transaction_id = (int)i;
+        txs[i].energy_wh = (int32_t)(i % 600) * ENERGY_SCALE;
+    }
+    
+    // Legacy layout: one t=2 B+ tree per buyer
+    size_t before = heapBytesInUse();
+    BTree** trees = (BTree**)malloc(numBuyers * sizeof(BTree*));
+    long next = 0;
+    for (int b = 0; b < numBuyers; b++) 
+    {
+        trees[b] = createBTree(2, 'T');
+        for (int k = 0; k < perBuyer[b]; k++, next++) insert(trees[b], txs[next].transaction_id, &txs[next]);
+    }
+    size_t treeBytes = heapBytesInUse() - before;
+    
+    int64_t treeSum = 0;
+    double start = nowSeconds();
+    for (int b = 0; b < numBuyers; b++) 
+    {
+        Node* current = trees[b]->root;
+        while (!current->leaf) current = current->children[0];
+        for (; current != NULL; current = current->next) 
+        {
+            for (int i = 0; i < current->n; i++) sumEnergy((Transaction*)current->records[i], &treeSum);
+        }
+    }
+    double treeScan = nowSeconds() - start;
+    
+    // Adaptive sets
+    before = heapBytesInUse();
+    TransactionSet* sets = (TransactionSet*)malloc(numBuyers * sizeof(TransactionSet));
+    next = 0;
+    int promoted = 0;
+    for (int b = 0; b < numBuyers; b++) 
+    {
+        initTransactionSet(&sets[b]);
+        for (int k = 0; k < perBuyer[b]; k++, next++) addToTransactionSet(&sets[b], &txs[next]);
+        promoted += sets[b].promoted;
+    }
+    size_t setBytes = heapBytesInUse() - before;
+    
+    int64_t setSum = 0;
+    start = nowSeconds();
+    for (int b = 0; b < numBuyers; b++) forEachInTransactionSet(&sets[b], sumEnergy, &setSum);
+    double setScan = nowSeconds() - start;
+    
+    printf("\n===== PER-BUYER TRANSACTION SETS (%d buyers, %ld transactions, %d promoted) =====\n", 
+           numBuyers, total, promoted);
+    printf("%-20s | %-16s | %-16s\n", "LAYOUT", "BYTES/BUYER", "SCAN NS/TX");
+    printf("------------------------------------------------------\n");
+    printf("%-20s | %-16.1f | %-16.2f\n", "B+ tree (t=2)", (double)treeBytes / numBuyers, treeScan * 1e9 / total);
+    printf("%-20s | %-16.1f | %-16.2f\n", "Adaptive set", (double)setBytes / numBuyers, setScan * 1e9 / total);
+    printf("------------------------------------------------------\n");
+    if (treeSum != setSum) printf("Warning: scans disagree\n");
+    if (treeBytes == 0) printf("(heap usage not available on this platform)\n");
+}
+
+// Height, memory and lookup latency for different internal node fanouts
+void benchmarkTreeLayout(void) 
+{
+    const int numKeys = 1000000;
+    const int lookups = 1000000;
+    const int factors[] = {1, 2, 4};
+    const int numFactors = sizeof(factors) / sizeof(factors[0]);
+    int dummy = 0;
+    
+    printf("\n===== TREE LAYOUT, %d KEYS, LEAF DEGREE %d =====\n", numKeys, ORDER/2);
+    printf("%-16s | %-8s | %-14s | %-12s\n", "INTERNAL DEGREE", "HEIGHT", "BYTES/KEY", "NS/LOOKUP");
+    printf("------------------------------------------------------------\n");
+    
+    for (int f = 0; f < numFactors; f++) 
+    {
+        size_t before = heapBytesInUse();
+        BTree* tree = createBTreeWithDegrees(ORDER/2, (ORDER/2) * factors[f], 'T');
+        for (int i = 0; i < numKeys; i++) insert(tree, (int)(((long long)i * 7919) % numKeys), &dummy);
+        size_t bytes = heapBytesInUse() - before;
+        
+        int height = 1;
+        for (Node* node = tree->root; !node->leaf; node = node->children[0]) height++;
+        
+        srand(42);
+        long found = 0;
+        double start = nowSeconds();
+        for (int i = 0; i < lookups; i++) found += search(tree->root, rand() % numKeys) != NULL;
+        double ns = (nowSeconds() - start) * 1e9 / lookups;
+        
+        printf("%-16d | %-8d | %-14.2f | %-12.2f\n", tree->internal_t, height, (double)bytes / numKeys, ns);
+        if (found != lookups) printf("Warning: %ld of %d lookups failed\n", lookups - found, lookups);
+    }
+    
+    printf("------------------------------------------------------------\n");
+}
+
+// Typed trees used only by benchmarkTypedTrees; the application keeps the generic
+// trees for entities whose records must stay at a stable address
+DEFINE_TYPED_BTREE(TxTree, int, Transaction, ORDER/2 * 4)
+DEFINE_TYPED_BTREE(SellerTree, int, Seller, ORDER/2 * 4)
+DEFINE_TYPED_BTREE(BuyerTree, int, Buyer, ORDER/2 * 4)
+
+// Timings and footprint of one tree variant in benchmarkTypedTrees
+typedef struct TreeBenchResult 
+{
+    double insert_ns;
+    double lookup_ns;
+    double bytes_per_entry;
+    long found;
+} TreeBenchResult;
+
+// Insert n records of recordSize bytes into a generic tree, then look them all up
+static TreeBenchResult benchmarkGenericTree(const int* keys, int n, size_t recordSize) 
+{
+    TreeBenchResult result;
+    size_t before = heapBytesInUse();
+    double start = nowSeconds();
+    BTree* tree = createBTree(ORDER/2, 'T');
+    for (int i = 0; i < n; i++) 
+    {
+        void* record = calloc(1, recordSize);
+        *(int*)record = keys[i];
+        insert(tree, keys[i], record);
+    }
+    result.insert_ns = (nowSeconds() - start) * 1e9 / n;
+    result.bytes_per_entry = (double)(heapBytesInUse() - before) / n;
+    
+    result.found = 0;
+    start = nowSeconds();
+    for (int i = n - 1; i >= 0; i--) 
+    {
+        int* record = (int*)search(tree->root, keys[i]);
+        result.found += record && *record == keys[i];
+    }
+    result.lookup_ns = (nowSeconds() - start) * 1e9 / n;
+    return result;
+}
+
+// Same measurement for a typed tree, with the key also stored in the first field of the value
+#define BENCHMARK_TYPED_TREE(Name, ValueType, keyOf)                                           \
+static TreeBenchResult benchmark##Name(const int* keys, int n)                                  \
+{                                                                                               \
+    TreeBenchResult result;                                                                     \
+    size_t before = heapBytesInUse();                                                           \
+    double start = nowSeconds();                                                                \
+    Name* tree = Name##Create();                                                                \
+    for (int i = 0; i < n; i++)                                                                 \
+    {                                                                                           \
+        ValueType value;                                                                        \
+        memset(&value, 0, sizeof(value));                                                       \
+        *(int*)&value = keys[i];                                                                \
+        Name##Insert(tree, keyOf(keys[i]), value, NULL);                                        \
+    }                                                                                           \
+    result.insert_ns = (nowSeconds() - start) * 1e9 / n;                                        \
+    result.bytes_per_entry = (double)(heapBytesInUse() - before) / n;                           \
+                                                                                                \
+    result.found = 0;                                                                           \
+    start = nowSeconds();                                                                       \
+    for (int i = n - 1; i >= 0; i--)                                                            \
+    {                                                                                           \
+        ValueType* value = Name##Search(tree, keyOf(keys[i]));                                  \
+        result.found += value && *(int*)value == keys[i];                                       \
+    }                                                                                           \
+    result.lookup_ns = (nowSeconds() - start) * 1e9 / n;                                        \
+    return result;                                                                              \
+}
+
+#define INT_KEY(k) (k)
+#define PAIR_KEY(k) createPairKey((k) >> 16, (k) & 0xFFFF)
+
+BENCHMARK_TYPED_TREE(TxTree, Transaction, INT_KEY)
+BENCHMARK_TYPED_TREE(SellerTree, Seller, INT_KEY)
+BENCHMARK_TYPED_TREE(BuyerTree, Buyer, INT_KEY)
+BENCHMARK_TYPED_TREE(PairTree, SellerBuyerPair, PAIR_KEY)
+
+// Generic pointer-per-record trees vs typed trees with inline values, for each of the four trees
+void benchmarkTypedTrees(void) 
+{
+    const int n = 1000000;
+    int* keys = (int*)malloc(n * sizeof(int));
+    int* pairKeys = (int*)malloc(n * sizeof(int));
+    if (!keys || !pairKeys) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Distinct keys in random order; pair keys use the legacy (seller << 16 | buyer) packing,
+    // which only the generic int-keyed tree needs
+    for (int i = 0; i < n; i++) 
+    {
+        keys[i] = i;
+        pairKeys[i] = ((i % 15000) << 16) | (i / 15000);
+    }
+    srand(42);
+    for (int i = n - 1; i > 0; i--) 
+    {
+        int j = rand() % (i + 1);
+        int tmp = keys[i]; keys[i] = keys[j]; keys[j] = tmp;
+        tmp = pairKeys[i]; pairKeys[i] = pairKeys[j]; pairKeys[j] = tmp;
+    }
+    
+    struct 
+    {
+        const char* tree;
+        TreeBenchResult generic;
+        TreeBenchResult typed;
+    } rows[4];
+    rows[0].tree = "Transaction";
+    rows[0].generic = benchmarkGenericTree(keys, n, sizeof(Transaction));
+    rows[0].typed = benchmarkTxTree(keys, n);
+    rows[1].tree = "Seller";
+    rows[1].generic = benchmarkGenericTree(keys, n, sizeof(Seller));
+    rows[1].typed = benchmarkSellerTree(keys, n);
+    rows[2].tree = "Buyer";
+    rows[2].generic = benchmarkGenericTree(keys, n, sizeof(Buyer));
+    rows[2].typed = benchmarkBuyerTree(keys, n);
+    rows[3].tree = "SellerBuyerPair";
+    rows[3].generic = benchmarkGenericTree(pairKeys, n, sizeof(SellerBuyerPair));
+    rows[3].typed = benchmarkPairTree(pairKeys, n);
+    
+    printf("\n===== GENERIC VS TYPED B+ TREES (%d entries each) =====\n", n);
+    printf("%-16s | %-8s | %-12s | %-12s | %-12s\n", "TREE", "VARIANT", "INSERT NS", "LOOKUP NS", "BYTES/ENTRY");
+    printf("----------------------------------------------------------------------\n");
+    for (int r = 0; r < 4; r++) 
+    {
+        printf("%-16s | %-8s | %-12.1f | %-12.1f | %-12.1f\n", rows[r].tree, "generic", 
+               rows[r].generic.insert_ns, rows[r].generic.lookup_ns, rows[r].generic.bytes_per_entry);
+        printf("%-16s | %-8s | %-12.1f | %-12.1f | %-12.1f\n", "", "typed", 
+               rows[r].typed.insert_ns, rows[r].typed.lookup_ns, rows[r].typed.bytes_per_entry);
+        if (rows[r].generic.found != n || rows[r].typed.found != n) printf("Warning: lookups failed for %s\n", rows[r].tree);
+    }
+    printf("----------------------------------------------------------------------\n");
+    
+    free(keys);
+    free(pairKeys);
+}
+
+// Previous float-based transaction layout, kept for benchmarkFixedPoint
+typedef struct LegacyTransaction 
+{
+    int transaction_id;
+    int buyer_id;
+    int seller_id;
+    float energy_kwh;
+    float price_per_kwh;
+    float total_price;
+    time_t timestamp;
+} LegacyTransaction;
+
+// Record size, aggregation throughput and accuracy of fixed-point vs float records
+void benchmarkFixedPoint(void) 
+{
+    const int count = 10000000;
+    LegacyTransaction* legacy = (LegacyTransaction*)malloc(count * sizeof(LegacyTransaction));
+    Transaction* fixed = (Transaction*)malloc(count * sizeof(Transaction));
+    if (!legacy || !fixed) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Amounts with 2 decimals, as they appear in transactions.txt
+    srand(42);
+    for (int i = 0; i < count; i++) 
+    {
+        int energy_cents = 100 + rand() % 60000;
+        int price_cents = 100 + rand() % 900;
+        legacy[i].energy_kwh = energy_cents / 100.0f;
+        legacy[i].price_per_kwh = price_cents / 100.0f;
+        legacy[i].total_price = legacy[i].energy_kwh * legacy[i].price_per_kwh;
+        fixed[i].energy_wh = energy_cents * (ENERGY_SCALE / 100);
+        fixed[i].price_micro = price_cents * (PRICE_SCALE / 100);
+    }
+    
+    // Float aggregation as processTransaction used to do it
+    double start = nowSeconds();
+    float floatRevenue = 0.0f, floatEnergy = 0.0f;
+    for (int i = 0; i < count; i++) 
+    {
+        floatRevenue += legacy[i].total_price;
+        floatEnergy += legacy[i].energy_kwh;
+    }
+    double floatSeconds = nowSeconds() - start;
+    
+    start = nowSeconds();
+    int64_t fixedRevenue = 0, fixedEnergy = 0;
+    for (int i = 0; i < count; i++) 
+    {
+        fixedRevenue += txTotalMicro(&fixed[i]);
+        fixedEnergy += fixed[i].energy_wh;
+    }
+    double fixedSeconds = nowSeconds() - start;
+    
+    printf("\n===== FIXED-POINT VS FLOAT RECORDS (%d transactions) =====\n", count);
+    printf("%-12s | %-12s | %-14s | %-22s | %-16s\n", "LAYOUT", "BYTES/TX", "NS/TX (SUM)", "REVENUE", "ENERGY (kWh)");
+    printf("----------------------------------------------------------------------------------------\n");
+    printf("%-12s | %-12zu | %-14.2f | %-22.2f | %-16.2f\n", "float", sizeof(LegacyTransaction), 
+           floatSeconds * 1e9 / count, floatRevenue, floatEnergy);
+    printf("%-12s | %-12zu | %-14.2f | %-22.2f | %-16.2f\n", "fixed-point", sizeof(Transaction), 
+           fixedSeconds * 1e9 / count, microToUnits(fixedRevenue), whToKwh(fixedEnergy));
+    printf("----------------------------------------------------------------------------------------\n");
+    printf("Float revenue error: $%.2f\n", floatRevenue - microToUnits(fixedRevenue));
+    
+    free(legacy);
+    free(fixed);
+}
+
+/*
+ * Benchmark suite
+ *
+ * --bench-suite generates a deterministic synthetic transaction stream and
+ * times import, processTransaction, point lookups and every report, printing
+ * one CSV row per measurement so runs can be diffed and tracked over time.
+ */
+
+#define SUITE_START_TIMESTAMP 1704067200  // 2024-01-01 00:00:00 UTC
+#define SUITE_INPUT_FILE "bench_suite_input.txt"
+#define SUITE_EXPORT_FILE "bench_suite_export.txt"
+
+typedef enum TimestampMode 
+{
+    TIMESTAMPS_UNIFORM,     // Uniform over the whole span
+    TIMESTAMPS_DIURNAL,     // Uniform day, hour weighted by a daily demand curve
+    TIMESTAMPS_SEQUENTIAL   // Increasing with the transaction ID
+} TimestampMode;
+
+typedef struct WorkloadConfig 
+{
+    int transactions;
+    int sellers;
+    int buyers;
+    double zipf;            // Zipf exponent for seller and buyer popularity (0 = uniform)
+    TimestampMode timestamps;
+    int days;               // Span of the generated timestamps
+    uint64_t seed;
+} WorkloadConfig;
+
+typedef struct WorkloadGenerator 
+{
+    WorkloadConfig config;
+    uint64_t state;
+    double* sellerCdf;      // Cumulative Zipf weights by popularity rank
+    double* buyerCdf;
+} WorkloadGenerator;
+
+// splitmix64: small, fast and identical on every platform, unlike rand()
+static uint64_t workloadNext(WorkloadGenerator* gen) 
+{
+    uint64_t z = (gen->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform double in [0, 1)
+static double workloadUniform(WorkloadGenerator* gen) 
+{
+    return (workloadNext(gen) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Cumulative distribution of a Zipf(s) law over n ranks
+static double* buildZipfCdf(int n, double s) 
+{
+    double* cdf = (double*)malloc(n * sizeof(double));
+    if (!cdf) 
+    {
+        printf("Memory allocation failed for Zipf table\n");
+        exit(1);
+    }
+    
+    double sum = 0.0;
+    for (int i = 0; i < n; i++) 
+    {
+        sum += 1.0 / pow(i + 1, s);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < n; i++) cdf[i] /= sum;
+    return cdf;
+}
+
+// Draw a 0-based popularity rank
+static int sampleZipf(WorkloadGenerator* gen, const double* cdf, int n) 
+{
+    double u = workloadUniform(gen);
+    int lo = 0, hi = n - 1;
+    while (lo < hi) 
+    {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void initWorkloadGenerator(WorkloadGenerator* gen, const WorkloadConfig* config) 
+{
+    gen->config = *config;
+    gen->state = config->seed;
+    gen->sellerCdf = buildZipfCdf(config->sellers, config->zipf);
+    gen->buyerCdf = buildZipfCdf(config->buyers, config->zipf);
+}
+
+void freeWorkloadGenerator(WorkloadGenerator* gen) 
+{
+    free(gen->sellerCdf);
+    free(gen->buyerCdf);
+}
+
+// Relative demand per hour of day: low at night, morning and evening peaks
+static const double diurnalWeights[24] = {
+    2, 1, 1, 1, 1, 2, 4, 7, 8, 6, 5, 5, 5, 5, 5, 6, 7, 9, 10, 10, 8, 6, 4, 3
+};
+
+// Generate the transaction with the given ID. Amounts have 2 decimals like
+// real input; each buyer has its own preferred sellers, so pairs are skewed too.
+void generateTransaction(WorkloadGenerator* gen, int id, int* buyer_id, int* seller_id, 
+                         double* energy_kwh, double* price_per_kwh, time_t* timestamp) 
+{
+    const WorkloadConfig* config = &gen->config;
+    int buyerRank = sampleZipf(gen, gen->buyerCdf, config->buyers);
+    int sellerRank = sampleZipf(gen, gen->sellerCdf, config->sellers);
+    *buyer_id = 1 + buyerRank;
+    *seller_id = 1 + (int)((sellerRank + (int64_t)buyerRank * 7919) % config->sellers);
+    
+    // Mostly household-sized trades with a long tail of bulk ones
+    double u = workloadUniform(gen);
+    int energy_cents = u < 0.9 ? 100 + (int)(workloadUniform(gen) * 29900) 
+                               : 30000 + (int)(workloadUniform(gen) * 70000);
+    *energy_kwh = energy_cents / 100.0;
+    
+    // Each seller has a base rate with a discount above 300 kWh
+    int base_cents = 10 + (*seller_id * 37) % 30;
+    *price_per_kwh = (energy_cents > 30000 ? base_cents - 2 : base_cents) / 100.0;
+    
+    int64_t span = (int64_t)config->days * 86400;
+    int64_t offset;
+    switch (config->timestamps) 
+    {
+        case TIMESTAMPS_DIURNAL: 
+        {
+            double total = 0.0;
+            for (int h = 0; h < 24; h++) total += diurnalWeights[h];
+            double pick = workloadUniform(gen) * total;
+            int hour = 0;
+            while (hour < 23 && pick >= diurnalWeights[hour]) pick -= diurnalWeights[hour++];
+            int64_t day = (int64_t)(workloadUniform(gen) * config->days);
+            offset = day * 86400 + hour * 3600 + (int64_t)(workloadUniform(gen) * 3600);
+            break;
+        }
+        case TIMESTAMPS_SEQUENTIAL:
+            offset = (int64_t)id * span / (config->transactions + 1);
+            break;
+        default:
+            offset = (int64_t)(workloadUniform(gen) * span);
+            break;
+    }
+    *timestamp = (time_t)(SUITE_START_TIMESTAMP + offset);
+}
+
+// Write the generated workload in the transactions.txt format
+bool writeWorkloadFile(const WorkloadConfig* config, const char* path) 
+{
+    FILE* file = fopen(path, "w");
+    if (!file) 
+    {
+        printf("Error opening file %s for writing\n", path);
+        return false;
+    }
+    
+    WorkloadGenerator gen;
+    initWorkloadGenerator(&gen, config);
+    fprintf(file, "transaction_id,buyer_id,seller_id,energy,price,timestamp\n");
+    for (int id = 1; id <= config->transactions; id++) 
+    {
+        int buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        time_t timestamp;
+        generateTransaction(&gen, id, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp);
+        fprintf(file, "%d,%d,%d,%.2f,%.2f,%lld\n", id, buyer_id, seller_id, energy_kwh, price_per_kwh, (long long)timestamp);
+    }
+    freeWorkloadGenerator(&gen);
+    fclose(file);
+    return true;
+}
+
+// One CSV result row
+static void printSuiteResult(const char* name, long operations, double seconds) 
+{
+    printf("%s,%ld,%.6f,%.1f\n", name, operations, seconds, operations > 0 ? seconds * 1e9 / operations : 0.0);
+}
+
+// Parse key=value options for --bench-suite; returns false on an unknown option
+bool parseWorkloadOption(WorkloadConfig* config, const char* option) 
+{
+    const char* value = strchr(option, '=');
+    if (!value) return false;
+    value++;
+    
+    if (strncmp(option, "transactions=", 13) == 0) config->transactions = atoi(value);
+    else if (strncmp(option, "sellers=", 8) == 0) config->sellers = atoi(value);
+    else if (strncmp(option, "buyers=", 7) == 0) config->buyers = atoi(value);
+    else if (strncmp(option, "zipf=", 5) == 0) config->zipf = atof(value);
+    else if (strncmp(option, "days=", 5) == 0) config->days = atoi(value);
+    else if (strncmp(option, "seed=", 5) == 0) config->seed = strtoull(value, NULL, 10);
+    else if (strcmp(option, "time=uniform") == 0) config->timestamps = TIMESTAMPS_UNIFORM;
+    else if (strcmp(option, "time=diurnal") == 0) config->timestamps = TIMESTAMPS_DIURNAL;
+    else if (strcmp(option, "time=sequential") == 0) config->timestamps = TIMESTAMPS_SEQUENTIAL;
+    else return false;
+    return true;
+}
+
+// Run the suite, printing benchmark,operations,seconds,ns_per_op rows
+void runBenchmarkSuite(const WorkloadConfig* config) 
+{
+    const int lookups = 1000000;
+    
+    printf("# transactions=%d sellers=%d buyers=%d zipf=%.2f time=%s days=%d seed=%llu order=%d\n", 
+           config->transactions, config->sellers, config->buyers, config->zipf, 
+           config->timestamps == TIMESTAMPS_DIURNAL ? "diurnal" : 
+           (config->timestamps == TIMESTAMPS_SEQUENTIAL ? "sequential" : "uniform"), 
+           config->days, (unsigned long long)config->seed, ORDER);
+    printf("benchmark,operations,seconds,ns_per_op\n");
+    
+    double start = nowSeconds();
+    if (!writeWorkloadFile(config, SUITE_INPUT_FILE)) return;
+    printSuiteResult("generate", config->transactions, nowSeconds() - start);
+    
+    // Import: parse, create and account every transaction from the file
+    BTree* importTree = createBTree(ORDER/2, 'T');
+    BTree* importSellers = createBTree(ORDER/2, 'S');
+    BTree* importBuyers = createBTree(ORDER/2, 'B');
+    PairTree* importPairs = PairTreeCreate();
+    enableLookupIndexes(importSellers, importBuyers, importPairs);
+    int saved = silenceStdout();
+    start = nowSeconds();
+    importTransactionsFrom(SUITE_INPUT_FILE, importTree, importSellers, importBuyers, importPairs);
+    double seconds = nowSeconds() - start;
+    restoreStdout(saved);
+    printSuiteResult("import", config->transactions, seconds);
+    unlink(SUITE_INPUT_FILE);
+    
+    // Insert and process the same stream without file parsing
+    Transaction** txs = (Transaction**)malloc(config->transactions * sizeof(Transaction*));
+    if (!txs) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    WorkloadGenerator gen;
+    initWorkloadGenerator(&gen, config);
+    for (int i = 0; i < config->transactions; i++) 
+    {
+        int buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        time_t timestamp;
+        generateTransaction(&gen, i + 1, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp);
+        txs[i] = createTransaction(i + 1, buyer_id, seller_id, energy_kwh, price_per_kwh, timestamp);
+    }
+    
+    BTree* transactionTree = createBTree(ORDER/2, 'T');
+    BTree* sellerTree = createBTree(ORDER/2, 'S');
+    BTree* buyerTree = createBTree(ORDER/2, 'B');
+    PairTree* pairTree = PairTreeCreate();
+    enableLookupIndexes(sellerTree, buyerTree, pairTree);
+    
+    start = nowSeconds();
+    for (int i = 0; i < config->transactions; i++) insertTransaction(transactionTree, txs[i]);
+    printSuiteResult("insert_transaction", config->transactions, nowSeconds() - start);
+    
+    start = nowSeconds();
+    for (int i = 0; i < config->transactions; i++) processTransaction(txs[i], sellerTree, buyerTree, pairTree);
+    printSuiteResult("process_transaction", config->transactions, nowSeconds() - start);
+    
+    // Point lookups of entities drawn from the stream, so they follow its popularity skew
+    long found = 0;
+    start = nowSeconds();
+    for (int i = 0; i < lookups; i++) 
+    {
+        found += searchTransaction(transactionTree, 1 + (int)(workloadNext(&gen) % config->transactions)) != NULL;
+    }
+    printSuiteResult("search_transaction", lookups, nowSeconds() - start);
+    
+    start = nowSeconds();
+    for (int i = 0; i < lookups; i++) 
+    {
+        found += searchSeller(sellerTree, txs[workloadNext(&gen) % config->transactions]->seller_id) != NULL;
+    }
+    printSuiteResult("search_seller", lookups, nowSeconds() - start);
+    
+    start = nowSeconds();
+    for (int i = 0; i < lookups; i++) 
+    {
+        found += searchBuyer(buyerTree, txs[workloadNext(&gen) % config->transactions]->buyer_id) != NULL;
+    }
+    printSuiteResult("search_buyer", lookups, nowSeconds() - start);
+    
+    start = nowSeconds();
+    for (int i = 0; i < lookups; i++) 
+    {
+        const Transaction* tx = txs[workloadNext(&gen) % config->transactions];
+        found += searchSellerBuyerPair(pairTree, tx->seller_id, tx->buyer_id) != NULL;
+    }
+    printSuiteResult("search_pair", lookups, nowSeconds() - start);
+    
+    // Reports, with their output discarded
+    time_t weekStart = SUITE_START_TIMESTAMP + (time_t)(config->days / 2) * 86400;
+    int hotSeller = txs[0]->seller_id;
+    
+    saved = silenceStdout();
+    double reportSeconds[9];
+    start = nowSeconds();
+    displayAllTransactions(transactionTree);
+    reportSeconds[0] = nowSeconds() - start;
+    start = nowSeconds();
+    displayAllSellers(sellerTree);
+    reportSeconds[1] = nowSeconds() - start;
+    start = nowSeconds();
+    displayAllBuyers(buyerTree);
+    reportSeconds[2] = nowSeconds() - start;
+    start = nowSeconds();
+    displayTransactionsInTimeRange(transactionTree, NULL, weekStart, weekStart + 7 * 86400);
+    reportSeconds[3] = nowSeconds() - start;
+    start = nowSeconds();
+    calculateSellerRevenue(transactionTree, hotSeller);
+    reportSeconds[4] = nowSeconds() - start;
+    start = nowSeconds();
+    displayTransactionsByEnergyRange(transactionTree, 100.0, 300.0);
+    reportSeconds[5] = nowSeconds() - start;
+    start = nowSeconds();
+    displayBuyersByEnergyBought(buyerTree);
+    reportSeconds[6] = nowSeconds() - start;
+    start = nowSeconds();
+    displayPairsByTransactionCount(pairTree);
+    reportSeconds[7] = nowSeconds() - start;
+    start = nowSeconds();
+    exportTransactionsTo(transactionTree, SUITE_EXPORT_FILE);
+    reportSeconds[8] = nowSeconds() - start;
+    restoreStdout(saved);
+    unlink(SUITE_EXPORT_FILE);
+    
+    printSuiteResult("report_all_transactions", config->transactions, reportSeconds[0]);
+    printSuiteResult("report_all_sellers", config->sellers, reportSeconds[1]);
+    printSuiteResult("report_all_buyers", config->buyers, reportSeconds[2]);
+    printSuiteResult("report_time_range", config->transactions, reportSeconds[3]);
+    printSuiteResult("report_seller_revenue", config->transactions, reportSeconds[4]);
+    printSuiteResult("report_energy_range", config->transactions, reportSeconds[5]);
+    printSuiteResult("report_buyers_by_energy", config->buyers, reportSeconds[6]);
+    printSuiteResult("report_pairs_by_count", pairTree->count, reportSeconds[7]);
+    printSuiteResult("export", config->transactions, reportSeconds[8]);
+    
+    if (found != 4L * lookups) printf("# warning: %ld of %d lookups failed\n", 4L * lookups - found, 4 * lookups);
+    freeWorkloadGenerator(&gen);
+    free(txs);
+}
+
+// Seller price quotes: a seller tree descent per quote as menu option 1 did,
+// against the cached pricing table with learned rates and with tariffs
+void benchmarkPricing(void) 
+{
+    const int numSellers = 100000;
+    const int numQuotes = 5000000;
+    static const double skews[] = { 0.0, 0.8, 1.2 };
+    int* sellerIds = (int*)malloc(numQuotes * sizeof(int));
+    int64_t* energies = (int64_t*)malloc(numQuotes * sizeof(int64_t));
+    time_t* timestamps = (time_t*)malloc(numQuotes * sizeof(time_t));
+    Tariff* tariffs = (Tariff*)calloc(numSellers, sizeof(Tariff));
+    PricingTable* pricing = (PricingTable*)malloc(sizeof(PricingTable));
+    if (!sellerIds || !energies || !timestamps || !tariffs || !pricing) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Every seller has learned rates; the tariff run adds a peak/off-peak schedule with three tiers
+    BTree* sellerTree = createBTree(ORDER/2, 'S');
+    Seller** sellers = (Seller**)malloc(numSellers * sizeof(Seller*));
+    for (int i = 0; i < numSellers; i++) 
+    {
+        int base = 100000 + (i * 37) % 300000;
+        sellers[i] = createSeller(i + 1);
+        learnSellerRate(sellers[i], 0, base);
+        learnSellerRate(sellers[i], HIGH_VOLUME_WH, base - 20000);
+        insertSeller(sellerTree, sellers[i]);
+        
+        Tariff* tariff = &tariffs[i];
+        static const int starts[] = { 7 * 60, 17 * 60, 22 * 60 };
+        tariff->numPeriods = 3;
+        tariff->numTiers = 3;
+        for (int p = 0; p < 3; p++) 
+        {
+            tariff->period_start[p] = starts[p];
+            for (int t = 0; t < 3; t++) tariff->rates[p][t] = base * (p == 1 ? 3 : 2) / 2 - t * 10000;
+        }
+        tariff->tier_start_wh[1] = HIGH_VOLUME_WH;
+        tariff->tier_start_wh[2] = 1000 * ENERGY_SCALE;
+    }
+    
+    printf("\n===== SELLER PRICE QUOTES, %d SELLERS, %d QUOTES =====\n", numSellers, numQuotes);
+    printf("%-6s | %-14s | %-16s | %-16s | %-14s\n", "ZIPF", "DESCENT NS/Q", "CACHED NS/Q", "TARIFF NS/Q", "CACHE HIT RATE");
+    printf("------------------------------------------------------------------------------\n");
+    
+    int64_t checksum = 0;
+    for (int k = 0; k < 3; k++) 
+    {
+        WorkloadConfig config = { numQuotes, numSellers, 50000, skews[k], TIMESTAMPS_DIURNAL, 30, 7 };
+        WorkloadGenerator gen;
+        initWorkloadGenerator(&gen, &config);
+        for (int i = 0; i < numQuotes; i++) 
+        {
+            int buyer_id, seller_id;
+            double energy_kwh, price_per_kwh;
+            generateTransaction(&gen, i + 1, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamps[i]);
+            energies[i] = toEnergyWh(energy_kwh);
+            
+            // Popular sellers are popular with every buyer, scattered over the ID space
+            int rank = sampleZipf(&gen, gen.sellerCdf, numSellers);
+            sellerIds[i] = 1 + (int)(((int64_t)rank * 7919) % numSellers);
+        }
+        freeWorkloadGenerator(&gen);
+        
+        // The lookup menu option 1 used to do for every new transaction
+        double start = nowSeconds();
+        for (int i = 0; i < numQuotes; i++) 
+        {
+            Seller* seller = searchSeller(sellerTree, sellerIds[i]);
+            if (seller != NULL) 
+            {
+                if (energies[i] < HIGH_VOLUME_WH && seller->has_rate_below_300) checksum += seller->rate_below_300;
+                else if (energies[i] >= HIGH_VOLUME_WH && seller->has_rate_above_300) checksum += seller->rate_above_300;
+            }
+        }
+        double descent = nowSeconds() - start;
+        
+        double cached[2];
+        for (int withTariffs = 0; withTariffs < 2; withTariffs++) 
+        {
+            for (int i = 0; i < numSellers; i++) sellers[i]->tariff = withTariffs ? &tariffs[i] : NULL;
+            initPricingTable(pricing, sellerTree);
+            start = nowSeconds();
+            for (int i = 0; i < numQuotes; i++) 
+            {
+                int32_t price;
+                if (quotePrice(pricing, sellerIds[i], energies[i], timestamps[i], &price)) checksum += price;
+            }
+            cached[withTariffs] = nowSeconds() - start;
+        }
+        
+        printf("%-6.1f | %-14.1f | %-16.1f | %-16.1f | %.1f%%\n", skews[k], descent * 1e9 / numQuotes, 
+               cached[0] * 1e9 / numQuotes, cached[1] * 1e9 / numQuotes, 
+               100.0 * pricing->hits / (pricing->hits + pricing->misses));
+    }
+    printf("------------------------------------------------------------------------------\n");
+    printf("(checksum %lld)\n", (long long)checksum);
+    
+    for (int i = 0; i < numSellers; i++) sellers[i]->tariff = NULL;
+    free(sellers);
+    free(pricing);
+    free(tariffs);
+    free(timestamps);
+    free(energies);
+    free(sellerIds);
+}
+
+// processTransaction throughput with the seller, buyer and pair lookups done
+// by tree descents and through the hash indexes
+void benchmarkLookupIndex(int numTransactions) 
+{
+    static const char* const populations[] = { "1K sellers, 10K buyers", "100K sellers, 1M buyers" };
+    static const int numSellers[] = { 1000, 100000 };
+    static const int numBuyers[] = { 10000, 1000000 };
+    Transaction* txs = (Transaction*)malloc((size_t)numTransactions * sizeof(Transaction));
+    if (!txs) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    printf("\n===== PROCESS TRANSACTION, %d TRANSACTIONS =====\n", numTransactions);
+    printf("%-24s | %-8s | %-10s | %-8s | %-14s | %-8s\n", "POPULATION", "LOOKUPS", "TX/S", "NS/TX", "LOOKUP NS/TX", "PAIRS");
+    printf("-------------------------------------------------------------------------------------\n");
+    
+    for (int p = 0; p < 2; p++) 
+    {
+        WorkloadConfig config = { numTransactions, numSellers[p], numBuyers[p], 0.8, TIMESTAMPS_UNIFORM, 365, 42 };
+        WorkloadGenerator gen;
+        initWorkloadGenerator(&gen, &config);
+        for (int i = 0; i < numTransactions; i++) 
+        {
+            int buyer_id, seller_id;
+            double energy_kwh, price_per_kwh;
+            time_t timestamp;
+            generateTransaction(&gen, i + 1, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp);
+            Transaction tx = { i + 1, buyer_id, seller_id, toEnergyWh(energy_kwh), 
+                               toPriceMicro(price_per_kwh), toTimeOffset(timestamp) };
+            txs[i] = tx;
+        }
+        freeWorkloadGenerator(&gen);
+        
+        int64_t revenue[2];
+        for (int indexed = 0; indexed < 2; indexed++) 
+        {
+            BTree* sellerTree = createBTree(ORDER/2, 'S');
+            BTree* buyerTree = createBTree(ORDER/2, 'B');
+            PairTree* pairTree = PairTreeCreate();
+            if (indexed) 
+            {
+                // Directly rather than through enableLookupIndexes, so -DLOOKUP_INDEX=0 builds compare too
+                enableHashIndex(sellerTree);
+                enableHashIndex(buyerTree);
+                PairTreeEnableIndex(pairTree);
+            }
+            
+            double start = nowSeconds();
+            for (int i = 0; i < numTransactions; i++) processTransaction(&txs[i], sellerTree, buyerTree, pairTree);
+            double seconds = nowSeconds() - start;
+            
+            // The three point lookups alone, replayed over the loaded trees
+            revenue[indexed] = 0;
+            start = nowSeconds();
+            for (int i = 0; i < numTransactions; i++) 
+            {
+                Seller* seller = searchSeller(sellerTree, txs[i].seller_id);
+                Buyer* buyer = searchBuyer(buyerTree, txs[i].buyer_id);
+                SellerBuyerPair* pair = searchSellerBuyerPair(pairTree, txs[i].seller_id, txs[i].buyer_id);
+                revenue[indexed] += seller->total_revenue + buyer->total_energy_purchased + pair->number_of_transactions;
+            }
+            double lookups = nowSeconds() - start;
+            
+            printf("%-24s | %-8s | %-10.0f | %-8.1f | %-14.1f | %ld\n", populations[p], indexed ? "Hash" : "Descent", 
+                   numTransactions / seconds, seconds * 1e9 / numTransactions, lookups * 1e9 / numTransactions, 
+                   pairTree->count);
+        }
+        if (revenue[0] != revenue[1]) printf("(lookup results differ between the two runs)\n");
+    }
+    printf("-------------------------------------------------------------------------------------\n");
+    
+    free(txs);
+}
+
+// Creating entities that do not exist yet, as importing fresh data does: a
+// failing search followed by a separate insert, against one reused descent
+void benchmarkEntityCreation(int numEntities) 
+{
+    static const char* const methods[] = { "Search, then insert", "Search for insert" };
+    int* ids = (int*)malloc(numEntities * sizeof(int));
+    if (!ids) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // IDs 1..n in random order
+    srand(42);
+    for (int i = 0; i < numEntities; i++) ids[i] = i + 1;
+    for (int i = numEntities - 1; i > 0; i--) 
+    {
+        int j = (int)(((uint64_t)rand() * (RAND_MAX + 1ULL) + rand()) % (uint64_t)(i + 1));
+        int swap = ids[i];
+        ids[i] = ids[j];
+        ids[j] = swap;
+    }
+    
+    printf("\n===== FIND OR CREATE, %d NEW ENTITIES =====\n", numEntities);
+    printf("%-8s | %-20s | %-14s | %-14s\n", "LOOKUPS", "METHOD", "NEW NS/ID", "EXISTING NS/ID");
+    printf("--------------------------------------------------------------------\n");
+    
+    long found = 0;
+    for (int indexed = 0; indexed < 2; indexed++) 
+    {
+        for (int method = 0; method < 2; method++) 
+        {
+            BTree* tree = createBTree(ORDER/2, 'S');
+            if (indexed) enableHashIndex(tree);
+            
+            // First pass creates every ID, the second finds them all
+            double seconds[2];
+            for (int pass = 0; pass < 2; pass++) 
+            {
+                double start = nowSeconds();
+                for (int i = 0; i < numEntities; i++) 
+                {
+                    void* record;
+                    if (method == 0) 
+                    {
+                        record = lookup(tree, ids[i]);
+                        if (!record) insert(tree, ids[i], &ids[i]);
+                    } 
+                    else 
+                    {
+                        TreePath path;
+                        record = searchForInsert(tree, ids[i], &path);
+                        if (!record) insertAtPath(tree, &path, ids[i], &ids[i]);
+                    }
+                    found += record != NULL;
+                }
+                seconds[pass] = nowSeconds() - start;
+            }
+            
+            printf("%-8s | %-20s | %-14.1f | %-14.1f\n", indexed ? "Hash" : "Descent", methods[method], 
+                   seconds[0] * 1e9 / numEntities, seconds[1] * 1e9 / numEntities);
+        }
+    }
+    printf("--------------------------------------------------------------------\n");
+    if (found != 4L * numEntities) printf("(found %ld existing IDs, expected %ld)\n", found, 4L * numEntities);
+    
+    free(ids);
+}
+
+// Anonymous memory of this process backed by transparent huge pages, in bytes (-1 if unknown)
+static long long anonHugePageBytes(void) 
+{
+    FILE* file = fopen("/proc/self/smaps_rollup", "r");
+    if (!file) return -1;
+    
+    char line[256];
+    long long kb = -1;
+    while (kb < 0 && fgets(line, sizeof(line), file)) 
+    {
+        if (sscanf(line, "AnonHugePages: %lld kB", &kb) != 1) kb = -1;
+    }
+    fclose(file);
+    return kb < 0 ? -1 : kb * 1024;
+}
+
+// Random transaction lookups over a tree whose nodes and records come from
+// malloc, from arenas with 4 KB pages and from arenas with huge pages
+void benchmarkArenas(int numTransactions) 
+{
+    static const char* const modes[] = { "malloc", "Arena, 4 KB pages", "Arena, huge pages" };
+    int* ids = (int*)malloc(numTransactions * sizeof(int));
+    int* probes = (int*)malloc(numTransactions * sizeof(int));
+    if (!ids || !probes) 
+    {
+        printf("Memory allocation failed.\n");
+        free(ids);
+        free(probes);
+        return;
+    }
+    
+    // Insert IDs 1..n in random order and look them up in another
+    srand(42);
+    for (int i = 0; i < numTransactions; i++) ids[i] = i + 1;
+    for (int i = numTransactions - 1; i > 0; i--) 
+    {
+        int j = (int)(((uint64_t)rand() * (RAND_MAX + 1ULL) + rand()) % (uint64_t)(i + 1));
+        int swap = ids[i];
+        ids[i] = ids[j];
+        ids[j] = swap;
+    }
+    for (int i = 0; i < numTransactions; i++) 
+    {
+        probes[i] = 1 + (int)(((uint64_t)rand() * (RAND_MAX + 1ULL) + rand()) % (uint64_t)numTransactions);
+    }
+    
+    if (numaNodeCount < 0) probeNumaNodes();
+    printf("\n===== TRANSACTION LOOKUPS, %d TRANSACTIONS, %d NUMA NODE(S) =====\n", numTransactions, 
+           numaNodeCount > 0 ? numaNodeCount : 1);
+    printf("%-20s | %-12s | %-12s | %-14s\n", "ALLOCATION", "INSERT NS/TX", "LOOKUP NS", "HUGE PAGES MB");
+    printf("--------------------------------------------------------------------\n");
+    
+    ArenaSettings saved = arenaSettings;
+    int64_t energy[3];
+    for (int mode = 0; mode < 3; mode++) 
+    {
+        arenaSettings.enabled = mode > 0;
+        arenaSettings.huge_pages = mode == 2;
+        long long hugeBefore = anonHugePageBytes();
+        
+        // Each run keeps its tree, so the next one starts on fresh chunks
+        BTree* tree = createBTree(ORDER/2, 'T');
+        double start = nowSeconds();
+        for (int i = 0; i < numTransactions; i++) 
+        {
+            insert(tree, ids[i], createTransaction(ids[i], ids[i] % 1000, ids[i] % 100, 1.0 + ids[i] % 50, 
+                                                   0.25, 1700000000));
+        }
+        double inserts = nowSeconds() - start;
+        long long hugeAfter = anonHugePageBytes();
+        
+        energy[mode] = 0;
+        start = nowSeconds();
+        for (int i = 0; i < numTransactions; i++) energy[mode] += searchTransaction(tree, probes[i])->energy_wh;
+        double lookups = nowSeconds() - start;
+        
+        if (hugeBefore >= 0 && hugeAfter >= 0) 
+        {
+            printf("%-20s | %-12.1f | %-12.1f | %-14.1f\n", modes[mode], inserts * 1e9 / numTransactions, 
+                   lookups * 1e9 / numTransactions, (hugeAfter - hugeBefore) / 1048576.0);
+        } 
+        else 
+        {
+            printf("%-20s | %-12.1f | %-12.1f | %-14s\n", modes[mode], inserts * 1e9 / numTransactions, 
+                   lookups * 1e9 / numTransactions, "n/a");
+        }
+    }
+    printf("--------------------------------------------------------------------\n");
+    if (energy[0] != energy[1] || energy[0] != energy[2]) printf("(lookup results differ between the runs)\n");
+    arenaSettings = saved;
+    
+    free(probes);
+    free(ids);
+}
+
+// Load the suite's default workload and compare the accounted bytes per
+// transaction with a budget. Returns the exit status: 1 if over budget.
+int checkFootprint(int numTransactions, double budget) 
+{
+    WorkloadConfig config = { numTransactions, 500, 50000, 1.1, TIMESTAMPS_DIURNAL, 365, 42 };
+    BTree* transactionTree = createBTree(ORDER/2, 'T');
+    BTree* sellerTree = createBTree(ORDER/2, 'S');
+    BTree* buyerTree = createBTree(ORDER/2, 'B');
+    PairTree* pairTree = PairTreeCreate();
+    enableLookupIndexes(sellerTree, buyerTree, pairTree);
+    
+    WorkloadGenerator gen;
+    initWorkloadGenerator(&gen, &config);
+    for (int id = 1; id <= numTransactions; id++) 
+    {
+        int buyer_id, seller_id;
+        double energy_kwh, price_per_kwh;
+        time_t timestamp;
+        generateTransaction(&gen, id, &buyer_id, &seller_id, &energy_kwh, &price_per_kwh, &timestamp);
+        Transaction* tx = createTransaction(id, buyer_id, seller_id, energy_kwh, price_per_kwh, timestamp);
+        upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree);
+    }
+    freeWorkloadGenerator(&gen);
+    
+    displayMemoryFootprint(transactionTree, sellerTree, buyerTree, pairTree);
+    
+    MemoryFootprint footprint;
+    collectMemoryFootprint(&footprint, transactionTree, sellerTree, buyerTree, pairTree);
+    double perTransaction = footprintPerTransaction(&footprint, footprint.totalBytes);
+    bool ok = perTransaction <= budget;
+    printf("%s: %.1f bytes per transaction, budget %.1f\n", ok ? "PASS" : "FAIL", perTransaction, budget);
+    return ok ? 0 : 1;
+}
+
+// Transactions with IDs 1..n (indexed by ID) and a random insert order for
+// them. Random order touches paths all over a tree, the worst case for copying.
+static Transaction* shuffledTransactions(int numTransactions, int* order) 
+{
+    Transaction* txs = (Transaction*)malloc((size_t)(numTransactions + 1) * sizeof(Transaction));
+    if (!txs) return NULL;
+    
+    srand(42);
+    for (int i = 0; i < numTransactions; i++) order[i] = i + 1;
+    for (int i = numTransactions - 1; i > 0; i--) 
+    {
+        int j = (int)(((uint64_t)rand() * (RAND_MAX + 1ULL) + rand()) % (uint64_t)(i + 1));
+        int swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+    for (int id = 1; id <= numTransactions; id++) 
+    {
+        txs[id].transaction_id = id;
+        txs[id].buyer_id = 1 + rand() % 50000;
+        txs[id].seller_id = 1 + rand() % 500;
+        txs[id].energy_wh = 1 + rand() % 100000;
+        txs[id].price_micro = (10 + rand() % 90) * 10000;
+        txs[id].time_offset = toTimeOffset(SUITE_START_TIMESTAMP + (time_t)id * 60);
+    }
+    return txs;
+}
+
+// Exporter side of the snapshot benchmark
+typedef struct SnapshotBench 
+{
+    BTree* tree;
+    const int* rank;              // Position of each transaction ID in the insert order
+    const char* path;
+    bool done;                    // Set by the inserting thread, read atomically
+    long snapshots;
+    long rows;
+    bool consistent;
+} SnapshotBench;
+
+typedef struct SnapshotCheck 
+{
+    const int* rank;
+    int previous;                 // Last ID visited, IDs must ascend
+    int maxRank;
+    bool ordered;
+} SnapshotCheck;
+
+static void checkSnapshotRecord(void* record, void* ctx) 
+{
+    SnapshotCheck* check = (SnapshotCheck*)ctx;
+    int id = ((Transaction*)record)->transaction_id;
+    if (id <= check->previous) check->ordered = false;
+    if (check->rank[id] > check->maxRank) check->maxRank = check->rank[id];
+    check->previous = id;
+}
+
+// Export and check snapshots back to back until the inserts finish. A
+// consistent snapshot holds exactly the first k inserted IDs for some k.
+static void* snapshotExporter(void* arg) 
+{
+    SnapshotBench* bench = (SnapshotBench*)arg;
+    while (!__atomic_load_n(&bench->done, __ATOMIC_ACQUIRE)) 
+    {
+        TreeSnapshot* snapshot = takeSnapshot(bench->tree);
+        long count = exportSnapshotTo(snapshot, bench->path, false);
+        SnapshotCheck check = { bench->rank, 0, -1, true };
+        long visited = forEachInSnapshot(snapshot, checkSnapshotRecord, &check);
+        releaseSnapshot(snapshot);
+        
+        if (count != visited || !check.ordered || check.maxRank != visited - 1) bench->consistent = false;
+        bench->snapshots++;
+        bench->rows += count;
+    }
+    return NULL;
+}
+
+static double threadCpuSeconds(void) 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Insert latency with snapshots off, enabled but unused, and exported continuously
+void benchmarkSnapshots(int numTransactions) 
+{
+    static const char* const phases[] = { "Snapshots disabled", "Enabled, none taken", "Exporting continuously" };
+    const char* path = "bench_snapshot.txt";
+    int* order = (int*)malloc(numTransactions * sizeof(int));
+    int* rank = (int*)malloc((size_t)(numTransactions + 1) * sizeof(int));
+    LatencyHistogram* latency = (LatencyHistogram*)malloc(sizeof(LatencyHistogram));
+    Transaction* txs = order ? shuffledTransactions(numTransactions, order) : NULL;
+    if (!txs || !rank || !latency) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    for (int i = 0; i < numTransactions; i++) rank[order[i]] = i;
+    
+    printf("\n===== INSERTS DURING SNAPSHOT EXPORTS, %d TRANSACTIONS, %ld CPUS =====\n", 
+           numTransactions, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-24s | %-10s | %-12s | %-8s | %-8s | %-8s | %-10s\n", 
+           "PHASE", "INSERTS/S", "CPU NS/INS", "P50 NS", "P99 NS", "P99.9 NS", "MAX NS");
+    printf("----------------------------------------------------------------------------------------------------\n");
+    
+    SnapshotBench bench = { NULL, rank, path, false, 0, 0, true };
+    long copiedNodes = 0;
+    for (int phase = 0; phase < 3; phase++) 
+    {
+        BTree* tree = createBTree(ORDER / 2, 'T');
+        if (phase > 0) enableSnapshots(tree);
+        memset(latency, 0, sizeof(LatencyHistogram));
+        
+        pthread_t exporter;
+        bench.tree = tree;
+        if (phase == 2) pthread_create(&exporter, NULL, snapshotExporter, &bench);
+        
+        double cpuStart = threadCpuSeconds();
+        double start = nowSeconds();
+        for (int i = 0; i < numTransactions; i++) 
+        {
+            uint64_t insertStart = monotonicNanos();
+            insert(tree, order[i], &txs[order[i]]);
+            histogramRecord(latency, monotonicNanos() - insertStart);
+        }
+        double seconds = nowSeconds() - start;
+        double cpuSeconds = threadCpuSeconds() - cpuStart;
+        
+        if (phase == 2) 
+        {
+            __atomic_store_n(&bench.done, true, __ATOMIC_RELEASE);
+            pthread_join(exporter, NULL);
+            copiedNodes = tree->cow->copiedNodes;
+        }
+        
+        printf("%-24s | %-10.0f | %-12.1f | %-8llu | %-8llu | %-8llu | %-10llu\n", phases[phase], 
+               numTransactions / seconds, cpuSeconds * 1e9 / numTransactions, 
+               (unsigned long long)histogramPercentile(latency, 0.50), 
+               (unsigned long long)histogramPercentile(latency, 0.99), 
+               (unsigned long long)histogramPercentile(latency, 0.999), 
+               (unsigned long long)latency->max);
+    }
+    printf("----------------------------------------------------------------------------------------------------\n");
+    printf("Snapshots exported: %ld (%ld rows, %s)\n", bench.snapshots, bench.rows, 
+           bench.consistent ? "all consistent" : "INCONSISTENT");
+    printf("Nodes copied for snapshots: %ld (%.2f per insert)\n", copiedNodes, (double)copiedNodes / numTransactions);
+    unlink(path);
+    
+    free(latency);
+    free(rank);
+    free(order);
+    free(txs);
+}
+
+// Update latency as the query server sees it (one logged update at a time):
+// unlogged, logged without checkpoints, and checkpointed in the background
+void benchmarkCheckpoints(int numTransactions) 
+{
+    static const char* const phases[] = { "No log", "Logged, no checkpoints", "Checkpoint every 0.1 s" };
+    static const double intervals[] = { 0.0, 1e9, 0.1 };
+    const char* path = "bench_checkpoint.txt";
+    int* order = (int*)malloc(numTransactions * sizeof(int));
+    LatencyHistogram* latency = (LatencyHistogram*)malloc(sizeof(LatencyHistogram));
+    Transaction* txs = order ? shuffledTransactions(numTransactions, order) : NULL;
+    if (!txs || !latency) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    printf("\n===== UPDATES DURING BACKGROUND CHECKPOINTS, %d TRANSACTIONS =====\n", numTransactions);
+    printf("%-24s | %-10s | %-8s | %-8s | %-8s | %-10s | %-11s | %-9s\n", 
+           "PHASE", "UPDATES/S", "P50 NS", "P99 NS", "P99.9 NS", "MAX NS", "CHECKPOINTS", "MAX CUT US");
+    printf("-----------------------------------------------------------------------------------------------------------\n");
+    
+    for (int phase = 0; phase < 3; phase++) 
+    {
+        BTree* transactionTree = createBTree(ORDER/2, 'T');
+        BTree* sellerTree = createBTree(ORDER/2, 'S');
+        BTree* buyerTree = createBTree(ORDER/2, 'B');
+        PairTree* pairTree = PairTreeCreate();
+        enableLookupIndexes(sellerTree, buyerTree, pairTree);
+        memset(latency, 0, sizeof(LatencyHistogram));
+        
+        // Start from nothing, so no log of an earlier run is recovered
+        Checkpointer* checkpoint = NULL;
+        if (intervals[phase] > 0) 
+        {
+            char* logPath = pathWithSuffix(path, ".wal");
+            char* oldLogPath = pathWithSuffix(path, ".wal.old");
+            unlink(logPath);
+            unlink(oldLogPath);
+            free(logPath);
+            free(oldLogPath);
+            checkpoint = openCheckpointer(path, intervals[phase], transactionTree, sellerTree, buyerTree, pairTree);
+        }
+        
+        double start = nowSeconds();
+        for (int i = 0; i < numTransactions; i++) 
+        {
+            Transaction* tx = &txs[order[i]];
+            uint64_t updateStart = monotonicNanos();
+            beginLoggedUpdate(checkpoint);
+            logUpsert(checkpoint, tx);
+            upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree);
+            endLoggedUpdate(checkpoint);
+            histogramRecord(latency, monotonicNanos() - updateStart);
+        }
+        double seconds = nowSeconds() - start;
+        
+        long checkpoints = 0;
+        double maxCut = 0.0;
+        if (checkpoint) 
+        {
+            pthread_mutex_lock(&checkpoint->lock);
+            checkpoints = checkpoint->checkpoints;
+            maxCut = checkpoint->maxCutNanos / 1e3;
+            pthread_mutex_unlock(&checkpoint->lock);
+            
+            // Not measured: the final checkpoint writes everything still in the log
+            int saved = silenceStdout();
+            closeCheckpointer(checkpoint);
+            restoreStdout(saved);
+        }
+        
+        printf("%-24s | %-10.0f | %-8llu | %-8llu | %-8llu | %-10llu | %-11ld | %-9.1f\n", phases[phase], 
+               numTransactions / seconds, 
+               (unsigned long long)histogramPercentile(latency, 0.50), 
+               (unsigned long long)histogramPercentile(latency, 0.99), 
+               (unsigned long long)histogramPercentile(latency, 0.999), 
+               (unsigned long long)latency->max, checkpoints, maxCut);
+    }
+    printf("-----------------------------------------------------------------------------------------------------------\n");
+    unlink(path);
+    
+    free(latency);
+    free(order);
+    free(txs);
+}
+
+// Full-tree scans on 1-16 threads: seller revenue and a 1% energy range
+void benchmarkParallelScan(int numTransactions) 
+{
+    static const int threadCounts[] = { 1, 2, 4, 8, 16 };
+    const int repeats = 3;
+    Transaction* txs = (Transaction*)malloc((size_t)numTransactions * sizeof(Transaction));
+    if (!txs) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    srand(42);
+    BTree* tree = createBTree(ORDER / 2, 'T');
+    for (int i = 0; i < numTransactions; i++) 
+    {
+        txs[i].transaction_id = i + 1;
+        txs[i].buyer_id = 1 + rand() % 50000;
+        txs[i].seller_id = 1 + rand() % 500;
+        txs[i].energy_wh = 1 + rand() % 100000;
+        txs[i].price_micro = (10 + rand() % 90) * 10000;
+        txs[i].time_offset = toTimeOffset(SUITE_START_TIMESTAMP + (time_t)i * 60);
+        insert(tree, txs[i].transaction_id, &txs[i]);
+    }
+    
+    printf("\n===== PARALLEL SCANS, %d TRANSACTIONS, %ld CPUS =====\n", numTransactions, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-8s | %-10s | %-14s | %-8s | %-14s | %-8s\n", "THREADS", "PARTITIONS", "REVENUE (ms)", "SPEEDUP", "ENERGY (ms)", "SPEEDUP");
+    printf("-------------------------------------------------------------------------------\n");
+    
+    double baseRevenue = 0, baseEnergy = 0;
+    int count = 0;
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) 
+    {
+        ScanPool* pool = createScanPool(threadCounts[t]);
+        Node* starts[SCAN_MAX_PARTITIONS + 1];
+        int numPartitions = partitionLeaves(tree, scanPartitionTarget(pool), starts);
+        
+        // Best of a few runs, so one page-fault-heavy run doesn't skew the scaling
+        double revenueSeconds = 1e30, energySeconds = 1e30;
+        for (int r = 0; r < repeats; r++) 
+        {
+            double start = nowSeconds();
+            sumSellerTransactions(pool, tree, 1 + r);
+            double elapsed = nowSeconds() - start;
+            if (elapsed < revenueSeconds) revenueSeconds = elapsed;
+            
+            long scanned = 0;
+            start = nowSeconds();
+            Transaction** matches = collectTransactionsByEnergy(pool, tree, 50000, 50999, &count, &scanned);
+            elapsed = nowSeconds() - start;
+            if (elapsed < energySeconds) energySeconds = elapsed;
+            free(matches);
+        }
+        if (t == 0) 
+        {
+            baseRevenue = revenueSeconds;
+            baseEnergy = energySeconds;
+        }
+        
+        printf("%-8d | %-10d | %-14.1f | %-8.2f | %-14.1f | %-8.2f\n", threadCounts[t], numPartitions, 
+               revenueSeconds * 1e3, baseRevenue / revenueSeconds, energySeconds * 1e3, baseEnergy / energySeconds);
+        destroyScanPool(pool);
+    }
+    printf("-------------------------------------------------------------------------------\n");
+    printf("Energy range matched %d transactions\n", count);
+    
+    free(txs);
+}
+
+static int compareSortEntries(const void* a, const void* b) 
+{
+    const SortEntry* x = (const SortEntry*)a;
+    const SortEntry* y = (const SortEntry*)b;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Report orderings from 10K to 10M entries: insertion sort, qsort and the
+// shared sort on 1, 4 and 16 threads
+void benchmarkSort(void) 
+{
+    static const int sizes[] = { 10000, 100000, 1000000, 10000000 };
+    static const int threadCounts[] = { 1, 4, 16 };
+    const int maxSize = 10000000;
+    const int insertionMax = 100000;  // Quadratic beyond this
+    SortEntry* input = (SortEntry*)malloc(maxSize * sizeof(SortEntry));
+    SortEntry* entries = (SortEntry*)malloc(maxSize * sizeof(SortEntry));
+    if (!input || !entries) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Buyer energy totals: up to 100 MWh in Wh, many buyers sharing small totals
+    srand(42);
+    for (int i = 0; i < maxSize; i++) 
+    {
+        int64_t wh = (int64_t)(rand() % 100000) * (1 + rand() % 1000);
+        input[i].key = signedSortKey(wh);
+        input[i].item = NULL;
+    }
+    
+    ScanPool* pools[3];
+    for (int t = 0; t < 3; t++) pools[t] = createScanPool(threadCounts[t]);
+    
+    printf("\n===== SORTING REPORT ORDERINGS (ms), %ld CPUS =====\n", sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-10s | %-10s | %-10s | %-10s | %-10s | %-10s\n", "ENTRIES", "INSERTION", "QSORT", "1 THREAD", "4 THREADS", "16 THREADS");
+    printf("-------------------------------------------------------------------------------\n");
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) 
+    {
+        int n = sizes[s];
+        double times[5] = { -1, 0, 0, 0, 0 };
+        
+        if (n <= insertionMax) 
+        {
+            memcpy(entries, input, n * sizeof(SortEntry));
+            double start = nowSeconds();
+            insertionSortEntries(entries, n);
+            times[0] = nowSeconds() - start;
+        }
+        
+        memcpy(entries, input, n * sizeof(SortEntry));
+        double start = nowSeconds();
+        qsort(entries, n, sizeof(SortEntry), compareSortEntries);
+        times[1] = nowSeconds() - start;
+        
+        for (int t = 0; t < 3; t++) 
+        {
+            memcpy(entries, input, n * sizeof(SortEntry));
+            start = nowSeconds();
+            sortEntries(entries, n, pools[t]);
+            times[2 + t] = nowSeconds() - start;
+            for (int i = 1; i < n; i++) 
+            {
+                if (entries[i - 1].key > entries[i].key) 
+                {
+                    printf("Warning: %d entries not sorted on %d threads\n", n, threadCounts[t]);
+                    break;
+                }
+            }
+        }
+        
+        printf("%-10d | ", n);
+        if (times[0] < 0) printf("%-10s | ", "-");
+        else printf("%-10.2f | ", times[0] * 1e3);
+        printf("%-10.2f | %-10.2f | %-10.2f | %-10.2f\n", times[1] * 1e3, times[2] * 1e3, times[3] * 1e3, times[4] * 1e3);
+    }
+    printf("-------------------------------------------------------------------------------\n");
+    
+    for (int t = 0; t < 3; t++) destroyScanPool(pools[t]);
+    free(entries);
+    free(input);
+}
+
+// Listing a million transactions with per-row printf/localtime/strftime vs the report writer
+void benchmarkReportWriter(const char* path) 
+{
+    const int count = 1000000;
+    Transaction* txs = (Transaction*)malloc(count * sizeof(Transaction));
+    ReportWriter* writer = (ReportWriter*)malloc(sizeof(ReportWriter));
+    if (!txs || !writer) 
+    {
+        printf("Memory allocation failed.\n");
+        return;
+    }
+    
+    // Time-ordered, a few minutes apart, as in a listing of a busy period
+    srand(42);
+    for (int i = 0; i < count; i++) 
+    {
+        txs[i].transaction_id = i + 1;
+        txs[i].buyer_id = 1 + rand() % 50000;
+        txs[i].seller_id = 1 + rand() % 500;
+        txs[i].energy_wh = (1 + rand() % 60000) * 10;
+        txs[i].price_micro = (10 + rand() % 90) * 10000;
+        txs[i].time_offset = toTimeOffset(SUITE_START_TIMESTAMP + (time_t)i * 180);
+    }
+    
+    FILE* out = fopen(path, "w");
+    if (!out) 
+    {
+        printf("Error opening file %s for writing\n", path);
+        return;
+    }
+    
+    double start = nowSeconds();
+    for (int i = 0; i < count; i++) 
+    {
+        const Transaction* tx = &txs[i];
+        char time_str[30];
+        time_t timestamp = txTimestamp(tx);
+        strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
+        fprintf(out, "%-6d | %-8d | %-8d | %-15.2f | %-15.2f | %-15.2f | %-20s\n", 
+                tx->transaction_id, tx->buyer_id, tx->seller_id, 
+                whToKwh(tx->energy_wh), microToUnits(tx->price_micro), microToUnits(txTotalMicro(tx)), time_str);
+    }
+    fflush(out);
+    double printfSeconds = nowSeconds() - start;
+    long printfBytes = ftell(out);
+    
+    rewind(out);
+    start = nowSeconds();
+    initReportWriter(writer, out);
+    for (int i = 0; i < count; i++) reportTransactionRow(writer, &txs[i]);
+    flushReportWriter(writer);
+    fflush(out);
+    double writerSeconds = nowSeconds() - start;
+    long writerBytes = ftell(out);
+    fclose(out);
+    unlink(path);
+    
+    printf("\n===== TRANSACTION LISTING, %d ROWS =====\n", count);
+    printf("%-28s | %-10s | %-10s | %-14s\n", "WRITER", "SECONDS", "NS/ROW", "BYTES");
+    printf("------------------------------------------------------------------\n");
+    printf("%-28s | %-10.3f | %-10.1f | %-14ld\n", "printf + localtime/strftime", printfSeconds, printfSeconds * 1e9 / count, printfBytes);
+    printf("%-28s | %-10.3f | %-10.1f | %-14ld\n", "Report writer", writerSeconds, writerSeconds * 1e9 / count, writerBytes);
+    printf("------------------------------------------------------------------\n");
+    
+    free(writer);
+    free(txs);
+}
+
+// Print one transaction looked up in a paged tree
+void printPagedTransaction(Transaction* tx, void* ctx) 
+{
+    (void)ctx;
+    char time_str[30];
+    time_t timestamp = txTimestamp(tx);
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&timestamp));
+    printf("%-6d | %-8d | %-8d | %-15.2f | %-15.2f | %-15.2f | %-20s\n", 
+           tx->transaction_id, tx->buyer_id, tx->seller_id, 
+           whToKwh(tx->energy_wh), microToUnits(tx->price_micro), microToUnits(txTotalMicro(tx)), time_str);
+}
+
+// Main function to demonstrate usage
+int main(int argc, char* argv[]) 
+{
+    // Non-interactive commands
+    if (argc > 1) 
+    {
+        if (strcmp(argv[1], "--bench-node-search") == 0) 
+        {
+            benchmarkNodeSearch();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-descent") == 0) 
+        {
+            benchmarkDescent();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-tree-layout") == 0) 
+        {
+            benchmarkTreeLayout();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-txset") == 0) 
+        {
+            benchmarkTransactionSets();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-typed-trees") == 0) 
+        {
+            benchmarkTypedTrees();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-fixed-point") == 0) 
+        {
+            benchmarkFixedPoint();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-suite") == 0) 
+        {
+            WorkloadConfig config = { 100000, 200, 10000, 1.1, TIMESTAMPS_DIURNAL, 365, 42 };
+            for (int i = 2; i < argc; i++) 
+            {
+                if (!parseWorkloadOption(&config, argv[i])) 
+                {
+                    printf("Unknown benchmark option: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            if (config.transactions <= 0 || config.sellers <= 0 || config.buyers <= 0 || config.days <= 0) 
+            {
+                printf("transactions, sellers, buyers and days must be positive\n");
+                return 1;
+            }
+            runBenchmarkSuite(&config);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-pricing") == 0) 
+        {
+            benchmarkPricing();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-lookup") == 0) 
+        {
+            benchmarkLookupIndex(argc > 2 ? atoi(argv[2]) : 1000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-new-entities") == 0) 
+        {
+            benchmarkEntityCreation(argc > 2 ? atoi(argv[2]) : 1000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-arenas") == 0) 
+        {
+            benchmarkArenas(argc > 2 ? atoi(argv[2]) : 4000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--check-footprint") == 0) 
+        {
+            // --check-footprint [transactions] [bytes_per_transaction]
+            return checkFootprint(argc > 2 ? atoi(argv[2]) : 1000000, argc > 3 ? atof(argv[3]) : FOOTPRINT_BUDGET);
+        }
+        if (strcmp(argv[1], "--bench-checkpoint") == 0) 
+        {
+            benchmarkCheckpoints(argc > 2 ? atoi(argv[2]) : 1000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-snapshot") == 0) 
+        {
+            benchmarkSnapshots(argc > 2 ? atoi(argv[2]) : 1000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-parallel-scan") == 0) 
+        {
+            benchmarkParallelScan(argc > 2 ? atoi(argv[2]) : 50000000);
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-sort") == 0) 
+        {
+            benchmarkSort();
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-report") == 0) 
+        {
+            benchmarkReportWriter(argc > 2 ? argv[2] : "bench_report.txt");
+            return 0;
+        }
+        if (strcmp(argv[1], "--bench-paged") == 0) 
+        {
+            benchmarkPagedTree(argc > 2 ? argv[2] : "bench_paged.db");
+            return 0;
+        }
+        if (strcmp(argv[1], "--paged-export") == 0 && argc > 2) 
+        {
+            // Load transactions.txt and copy it into a paged tree file
+            BTree* transactionTree = createBTree(ORDER/2, 'T');
+            BTree* sellerTree = createBTree(ORDER/2, 'S');
+            BTree* buyerTree = createBTree(ORDER/2, 'B');
+            PairTree* pairTree = PairTreeCreate();
+            enableLookupIndexes(sellerTree, buyerTree, pairTree);
+            importTransactions(transactionTree, sellerTree, buyerTree, pairTree);
+            
+            long inserted = exportToPagedTree(transactionTree, argv[2], argc > 3 ? atoi(argv[3]) : 256);
+            if (inserted < 0) return 1;
+            printf("Added %ld transactions to %s\n", inserted, argv[2]);
+            return 0;
+        }
+        if (strcmp(argv[1], "--batch") == 0) 
+        {
+            return runBatch(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "--serve") == 0) 
+        {
+            // --serve [socket] [workers] [input] [checkpoint_seconds]
+            return runServer(argc > 2 ? argv[2] : SERVER_SOCKET, argc > 4 ? argv[4] : "transactions.txt", 
+                             argc > 3 ? atoi(argv[3]) : SERVER_WORKERS, argc > 5 ? atof(argv[5]) : 0.0);
+        }
+        if (strcmp(argv[1], "--ingest") == 0) 
+        {
+            return runIngest(argc - 2, argv + 2);
+        }
+        if (strcmp(argv[1], "--stats") == 0) 
+        {
+            // Load transactions.txt, then report tree shapes and the metrics of the load
+            BatchContext data;
+            openDataset(&data, "transactions.txt");
+            
+            displayTreeStatistics(data.transactionTree, data.sellerTree, data.buyerTree, data.pairTree);
+            displayMemoryFootprint(data.transactionTree, data.sellerTree, data.buyerTree, data.pairTree);
+            displayMetrics();
+            return 0;
+        }
+        if (strcmp(argv[1], "--paged-list") == 0 && argc > 2) 
+        {
+            PagedBTree* paged = pagedTreeOpen(argv[2], 64);
+            if (!paged) return 1;
+            
+            long count = pagedTreeScan(paged, printPagedTransaction, NULL);
+            printf("Total transactions: %ld\n", count);
+            pagedTreeClose(paged);
+            return count < 0 ? 1 : 0;
+        }
+        if (strcmp(argv[1], "--paged-search") == 0 && argc > 3) 
+        {
+            PagedBTree* paged = pagedTreeOpen(argv[2], 64);
+            if (!paged) return 1;
+            
+            int found = 0;
+            for (int i = 3; i < argc; i++) 
+            {
+                Transaction tx;
+                if (pagedTreeSearch(paged, atoi(argv[i]), &tx)) 
+                {
+                    printPagedTransaction(&tx, NULL);
+                    found++;
+                } 
+                else 
+                {
+                    printf("Transaction %s not found\n", argv[i]);
+                }
+            }
+            printf("Page reads: %ld (tree height %u)\n", paged->pool->reads, paged->meta.height);
+            pagedTreeClose(paged);
+            return found == argc - 3 ? 0 : 1;
+        }
+        printf("Unknown option: %s\n", argv[1]);
+        return 1;
+    }
+    
+    // Create B+ trees for different entity types and load transactions.txt.
+    // Archived transactions still count towards seller/buyer/pair aggregates.
+    BatchContext data;
+    ImportSummary imported = openDataset(&data, "transactions.txt");
+    BTree* transactionTree = data.transactionTree;
+    BTree* sellerTree = data.sellerTree;
+    BTree* buyerTree = data.buyerTree;
+    PairTree* pairTree = data.pairTree;
+    
+    // Duplicate or invalid lines mean the file no longer matches the trees
+    bool modified = imported.updated > 0 || imported.unchanged > 0 || imported.skipped > 0;
+    
+    // New transactions are priced by seller tariffs or learned rates
+    loadTariffs(TARIFF_FILE, sellerTree);
+    PricingTable pricing;
+    initPricingTable(&pricing, sellerTree);
+    
+    // Apply the retention policy
+    if (RETENTION_DAYS > 0) 
+    {
+        int moved = archiveTransactionsBefore(data.archivePath, time(NULL) - (time_t)RETENTION_DAYS * 86400, 
+                                              transactionTree, sellerTree, buyerTree);
+        if (moved > 0) printf("Archived %d transactions older than %d days\n", moved, RETENTION_DAYS);
+        if (moved > 0) modified = true;
+    }
+    
+    int choice = 0,flag=1;
+    
+    
+    while (flag)
+    {
+        // Display menu
+        printf("\n===== ENERGY TRADING SYSTEM =====\n");
+        printf("Operations Menu:\n");
+        printf("1. Add New Transactions\n");
+        printf("2. Display All Transactions\n");
+        printf("3. Create a set of Transactions for Every Seller\n");
+        printf("4. Create a set of Transactions for Every Buyer\n");
+        printf("5. Find all transactions in a Given Time Period\n");
+        printf("6. Calculate Total Revenue by Seller\n");
+        printf("7. Find and Display transactions with Energy Amounts in range\n");
+        printf("8. Sort the set of Buyers Based on Energy Bought\n");
+        printf("9. Sort Seller/Buyer Pairs by Number of Transactions\n");
+        printf("10. Delete a Transaction\n");
+        printf("11. Update a Transaction\n");
+        printf("12. Archive Transactions Before a Date\n");
+        printf("13. Show Tree Statistics and Metrics\n");
+        printf("0. Exit\n");
+        printf("Enter your choice: ");
+        
+        if (scanf("%d", &choice) != 1) 
+        {
+            // Clear input buffer on failed read
+            while (getchar() != '\n');
+            printf("Invalid input. Please enter a number.\n");
+            continue;
+        }
+        
+        // Process choice
+        switch (choice) 
+        {
+            case 0:
+                printf("Exiting system. Goodbye!\n");
+                flag=0;
+                break;
+                
+            case 1: 
+            { // Add New Transactions
+                int txn_id,buyer_id, seller_id;
+                double energy_kwh, price_per_kwh;
+                
+                printf("\n----- Add New Transaction -----\n");
+                printf("Enter Transaction ID: ");
+                scanf("%d", &txn_id);
+                if (searchTransaction(transactionTree, txn_id) != NULL) 
+                {
+                    printf("Transaction ID %d already exists, use option 11 to update it\n", txn_id);
+                    break;
+                }
+                if (isArchivedTransaction(txn_id)) 
+                {
+                    printf("Transaction ID %d is archived and cannot be reused\n", txn_id);
+                    break;
+                }
+                printf("Enter Buyer ID: ");
+                scanf("%d", &buyer_id);
+                printf("Enter Seller ID: ");
+                scanf("%d", &seller_id);
+                printf("Enter Energy (kWh): ");
+                scanf("%lf", &energy_kwh);
+                time_t now = time(NULL);
+                int32_t quoted;
+                if (quotePrice(&pricing, seller_id, toEnergyWh(energy_kwh), now, &quoted)) 
+                {
+                    price_per_kwh=microToUnits(quoted);
+                    printf("Price=%f (Auto Renew)\n", price_per_kwh);
+                } 
+                else 
+                {
+                    printf("Enter Price per kWh: ");
+                    scanf("%lf", &price_per_kwh);
+                }
+                
+                Transaction* tx = createTransaction(txn_id, buyer_id, seller_id, energy_kwh, price_per_kwh,now);
+                upsertTransaction(transactionTree, tx, sellerTree, buyerTree, pairTree);
+                modified = true;
+                
+                printf("Transaction added successfully with ID: %d\n", tx->transaction_id);
+                break;
+            }
+                
+            case 2: // Display All Transactions
+                displayAllTransactions(transactionTree);
+                break;
+                
+            case 3: 
+            { 
+                displayAllSellers(sellerTree);
+                break;
+            }
+                
+            case 4: 
+            { 
+                displayAllBuyers(buyerTree);
+                break;
+            }
+                
+            case 5: 
+            { // Display transactions in a given time period
+                printf("\n----- Transactions in Time Period -----\n");
+            
+                char start_date[11], end_date[11];
+                struct tm start_tm = {0}, end_tm = {0};
+            
+                printf("Enter start date (YYYY-MM-DD): ");
+                scanf("%10s", start_date);
+            
+                printf("Enter end date (YYYY-MM-DD): ");
+                scanf("%10s", end_date);
+            
+                if (!my_strptime(start_date, "%Y-%m-%d", &start_tm)) 
+                {
+                    printf("Invalid start date format.\n");
+                    break;
+                }
+            
+                if (!my_strptime(end_date, "%Y-%m-%d", &end_tm)) 
+                {
+                    printf("Invalid end date format.\n");
+                    break;
+                }
+            
+                // Set time to cover the full range for the dates
+                start_tm.tm_hour = 0; start_tm.tm_min = 0; start_tm.tm_sec = 0;
+                end_tm.tm_hour = 23;  end_tm.tm_min = 59;  end_tm.tm_sec = 59;
+            
+                time_t start_time = mktime(&start_tm);
+                time_t end_time = mktime(&end_tm);
+            
+                if (start_time == -1 || end_time == -1) 
+                {
+                    printf("Error converting date to time.\n");
+                    break;
+                }
+            
+                displayTransactionsInTimeRange(transactionTree, data.archivePath, start_time, end_time);
+                break;
+            }
+            
+                
+            case 6: 
+            { // Calculate Total Revenue by Seller
+                printf("\n----- Revenue by Seller -----\n");
+                printf("Enter Seller ID (0 to see all sellers first): ");
+                int seller_id;
+                scanf("%d", &seller_id);
+                
+                if (seller_id == 0) 
+                {
+                    displayAllSellers(sellerTree);
+                    printf("Enter Seller ID: ");
+                    scanf("%d", &seller_id);
+                }
+                
+                calculateSellerRevenue(transactionTree, seller_id);
+                break;
+            }
+                
+            case 7: 
+            { // Find and Display transactions with Energy Amounts in range
+                printf("\n----- Transactions by Energy Range -----\n");
+                printf("Enter minimum energy amount (kWh): ");
+                double min_energy, max_energy;
+                scanf("%lf", &min_energy);
+                printf("Enter maximum energy amount (kWh): ");
+                scanf("%lf", &max_energy);
+                
+                displayTransactionsByEnergyRange(transactionTree, min_energy, max_energy);
+                break;
+            }
+                
+            case 8: // Sort Buyers Based on Energy Bought
+                displayBuyersByEnergyBought(buyerTree);
+                break;
+                
+            case 9: // Sort Seller/Buyer Pairs by Number of Transactions
+                displayPairsByTransactionCount(pairTree);
+                break;
+                
+            case 10: 
+            { // Delete a Transaction
+                printf("\n----- Delete Transaction -----\n");
+                printf("Enter Transaction ID: ");
+                int txn_id;
+                scanf("%d", &txn_id);
+                
+                if (deleteTransaction(transactionTree, txn_id, sellerTree, buyerTree, pairTree)) 
+                {
+                    modified = true;
+                    printf("Transaction %d deleted successfully\n", txn_id);
+                } 
+                else 
+                {
+                    printf("Transaction %d not found\n", txn_id);
+                }
+                break;
+            }
+                
+            case 11: 
+            { // Update a Transaction
+                printf("\n----- Update Transaction -----\n");
+                printf("Enter Transaction ID: ");
+                int txn_id, buyer_id, seller_id;
+                double energy_kwh, price_per_kwh;
+                scanf("%d", &txn_id);
+                
+                Transaction* tx = searchTransaction(transactionTree, txn_id);
+                if (!tx) 
+                {
+                    printf("Transaction %d not found\n", txn_id);
+                    break;
+                }
+                
+                printf("Enter Buyer ID: ");
+                scanf("%d", &buyer_id);
+                printf("Enter Seller ID: ");
+                scanf("%d", &seller_id);
+                printf("Enter Energy (kWh): ");
+                scanf("%lf", &energy_kwh);
+                printf("Enter Price per kWh: ");
+                scanf("%lf", &price_per_kwh);
+                
+                updateTransaction(transactionTree, txn_id, buyer_id, seller_id, energy_kwh, price_per_kwh, 
+                                  txTimestamp(tx), sellerTree, buyerTree, pairTree);
+                modified = true;
+                printf("Transaction %d updated successfully\n", txn_id);
+                break;
+            }
+                
+            case 12: 
+            { // Archive Transactions Before a Date
+                printf("\n----- Archive Old Transactions -----\n");
+                char cutoff_date[11];
+                struct tm cutoff_tm = {0};
+                
+                printf("Archive transactions before (YYYY-MM-DD): ");
+                scanf("%10s", cutoff_date);
+                
+                if (!my_strptime(cutoff_date, "%Y-%m-%d", &cutoff_tm)) 
+                {
+                    printf("Invalid date format.\n");
+                    break;
+                }
+                
+                time_t cutoff = mktime(&cutoff_tm);
+                if (cutoff == -1) 
+                {
+                    printf("Error converting date to time.\n");
+                    break;
+                }
+                
+                int moved = archiveTransactionsBefore(data.archivePath, cutoff, transactionTree, sellerTree, buyerTree);
+                if (moved >= 0) printf("Archived %d transactions to %s\n", moved, data.archivePath);
+                if (moved > 0) modified = true;
+                break;
+            }
+                
+            case 13: 
+            { // Show Tree Statistics and Metrics
+                displayTreeStatistics(transactionTree, sellerTree, buyerTree, pairTree);
+                displayMemoryFootprint(transactionTree, sellerTree, buyerTree, pairTree);
+                displayMetrics();
+                break;
+            }
+                
+            default:
+                printf("Invalid choice. Please try again.\n");
+        }
+    }
+    if (modified) exportTransactions(transactionTree);
+    else printf("No changes, transactions.txt left as is\n");
+    return 0;
+}
+